@@ -729,6 +729,100 @@ FUNC_API_SINCE(1)
     return src_id;
 }
 
+/// Adds a list of highlights to a buffer in a single call.
+///
+/// Same as calling nvim_buf_add_highlight() for every item of "highlights",
+/// without a round trip per highlight. Each item is an array of the form
+/// [hl_group, line, col_start, col_end], where the values have the same
+/// meaning as the parameters of nvim_buf_add_highlight(). The whole list is
+/// validated first, on error no highlight is added.
+///
+/// @param buffer     Buffer handle
+/// @param src_id     Source group to use or 0 to use a new group,
+///                   or -1 for ungrouped highlights
+/// @param highlights List of [hl_group, line, col_start, col_end] items
+/// @param[out] err   Error details, if any
+/// @return The src_id that was used
+Integer nvim_buf_add_highlights(Buffer buffer,
+                                Integer src_id,
+                                Array highlights,
+                                error_st *err)
+FUNC_API_SINCE(4)
+{
+    filebuf_st *buf = find_buffer_by_handle(buffer, err);
+
+    if(!buf)
+    {
+        return 0;
+    }
+
+    for(size_t i = 0; i < highlights.size; i++)
+    {
+        if(highlights.items[i].type != kObjectTypeArray
+           || highlights.items[i].data.array.size != 4)
+        {
+            api_set_error(err, kErrorTypeValidation,
+                          "Highlight %zu must be an array of size 4", i);
+            return 0;
+        }
+
+        Array hl = highlights.items[i].data.array;
+
+        if(hl.items[0].type != kObjectTypeString
+           || hl.items[1].type != kObjectTypeInteger
+           || hl.items[2].type != kObjectTypeInteger
+           || hl.items[3].type != kObjectTypeInteger)
+        {
+            api_set_error(err, kErrorTypeValidation,
+                          "Highlight %zu must be [String, Integer, "
+                          "Integer, Integer]", i);
+            return 0;
+        }
+
+        Integer line = hl.items[1].data.integer;
+        Integer col_start = hl.items[2].data.integer;
+
+        if(line < 0 || line >= MAXLNUM)
+        {
+            api_set_error(err, kErrorTypeValidation,
+                          "Highlight %zu: line number outside range", i);
+            return 0;
+        }
+
+        if(col_start < 0 || col_start > MAXCOL)
+        {
+            api_set_error(err, kErrorTypeValidation,
+                          "Highlight %zu: column value outside range", i);
+            return 0;
+        }
+    }
+
+    bufhl_add_st *hls = xmalloc(MAX(highlights.size, 1) * sizeof(*hls));
+
+    for(size_t i = 0; i < highlights.size; i++)
+    {
+        Array hl = highlights.items[i].data.array;
+        String hl_group = hl.items[0].data.string;
+        Integer col_end = hl.items[3].data.integer;
+
+        if(col_end < 0 || col_end > MAXCOL)
+        {
+            col_end = MAXCOL;
+        }
+
+        hls[i].lnum = (linenum_kt)hl.items[1].data.integer+1;
+        hls[i].item.hl_id =
+            syn_name2id((uchar_kt *)(hl_group.data ? hl_group.data : ""));
+        hls[i].item.start = (columnum_kt)hl.items[2].data.integer+1;
+        hls[i].item.stop = (columnum_kt)col_end;
+    }
+
+    src_id = bufhl_add_hls(buf, (int)src_id, hls, highlights.size);
+    xfree(hls);
+
+    return src_id;
+}
+
 /// Clears highlights from a given source group and a range of lines
 ///
 /// To clear a source group in the entire buffer, pass in 1 and -1 to
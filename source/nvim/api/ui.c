@@ -4,12 +4,27 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <msgpack.h>
 
 #include "nvim/nvim.h"
 #include "nvim/ui.h"
+#include "nvim/ugrid.h"
+#include "nvim/mbyte.h"
+#include "nvim/shmgrid_defs.h"
 #include "nvim/memory.h"
 #include "nvim/map.h"
+#include "nvim/main.h"
+#include "nvim/lib/kvec.h"
+#include "nvim/os/os.h"
+#include "nvim/os/time.h"
+#include "nvim/os/input.h"
+#include "nvim/event/time.h"
 #include "nvim/msgpack/channel.h"
+#include "nvim/msgpack/helpers.h"
 #include "nvim/api/ui.h"
 #include "nvim/api/private/defs.h"
 #include "nvim/api/private/helpers.h"
@@ -21,10 +36,115 @@
     #include "ui_events_remote.generated.h"
 #endif
 
+/// msgpack types with a 32 bit value that the encoder fills in later.
+enum
+{
+    kPackUint32 = 0xce,
+    kPackStr32 = 0xdb,
+    kPackArray32 = 0xdd,
+};
+
+/// Milliseconds between the tries to start a frame for a UI with the
+/// "ext_shmgrid" option that still reads the frame before last.
+#define SHMGRID_RETRY_MS    4
+
+/// Size of the names of shared memory objects.
+#define SHMGRID_NAME_SIZE   64
+
+/// A call of the "redraw" notification: ["name", [args], [args], ...]
+typedef struct callrec_s
+{
+    size_t pos;         ///< offset of the header
+    size_t nargs;       ///< argument arrays
+    size_t nsuperseded; ///< argument arrays of superseded "line" events
+} callrec_st;
+
+/// The arguments of a "line" event in the "redraw" notification.
+typedef struct linerec_s
+{
+    size_t start;       ///< offset of the arguments
+    size_t stop;        ///< offset after the arguments
+    size_t call;        ///< index of the call
+    Integer row;        ///< row of the cells
+    Integer col;        ///< column of the first cell
+    Integer end;        ///< column after the last cell
+    bool superseded;    ///< a later "line" draws over all the cells
+} linerec_st;
+
 typedef struct ui_data_s
 {
     uint64_t channel_id;
-    Array buffer;
+
+    // The "redraw" notification is packed as the events come in. The
+    // sizes of the arrays and strings still growing are filled in later.
+    msgpack_sbuffer sbuf;   ///< packed "redraw" notification
+    msgpack_packer pac;     ///< packs into "sbuf"
+    size_t calls_pos;       ///< offset of the header of the calls array
+    kvec_t(callrec_st) calls; ///< calls packed so far
+    const char *call_name;  ///< name of the last call, NULL for none
+    size_t args_pos;        ///< offset of the last arguments
+    size_t put_pos;         ///< offset of the header of the open "put"
+                            ///< string, 0 for none
+    size_t put_size;        ///< size of the open "put" string
+
+    // With the "ext_lineruns" option, puts are sent as "line" events and
+    // highlights by the ids of "hl_define" events.
+    bool line_runs;
+    kvec_t(uihl_attr_st) hl_attrs; ///< attributes of highlight ids 1 .. n
+    Integer hl_id;      ///< current highlight id, 0 for none yet
+    Integer ui_hl_id;   ///< highlight id the UI last got
+    Integer row;        ///< row of the cursor
+    Integer col;        ///< column of the cursor
+    bool goto_pending;  ///< the UI didn't get the cursor position yet
+    size_t cells_pos;   ///< offset of the header of the cells of the open
+                        ///< "line", 0 for none
+    size_t ncells;      ///< number of cells of the open "line"
+    Integer line_row;   ///< row of the open "line"
+    Integer line_end;   ///< column after the last cell of the open "line"
+    Integer line_hl_id; ///< highlight id of the last cell
+    size_t text_pos;    ///< offset of the text of the last cell
+    size_t text_size;   ///< size of the text of the last cell
+    size_t repeat_pos;  ///< offset of the repeat count of the last cell
+    size_t repeat;      ///< repeat count of the last cell
+    size_t line_pos;    ///< offset of the arguments of the open "line"
+    Integer line_col;   ///< column of the open "line"
+    kvec_t(linerec_st) lines; ///< "line" events packed so far
+    size_t lines_barrier;   ///< index of the first "line" a later one can
+                            ///< supersede, the ones before were scrolled
+    size_t nsuperseded;     ///< superseded "line" events
+    msgpack_sbuffer spare;  ///< notification without the superseded events
+
+    // With the "flush_rate" option, a flush that comes too soon after the
+    // last notification is held back and goes out with the next one.
+    Integer flush_rate;     ///< notifications per second, 0 for no limit
+    uint64_t last_send;     ///< os_hrtime() of the last drawing sent
+    bool draws;             ///< the notification does more than move the
+                            ///< cursor
+    bool held;              ///< "timer" sends the notification
+    time_watcher_st timer;  ///< sends held notifications
+    multiqueue_st *events;  ///< where "timer" sends them outside a prompt
+
+    // With the "ext_shmgrid" option, the cells are published in shared
+    // memory, see shmgrid_defs.h, and "grid_flush" events tell which rows
+    // changed.
+    bool shm;
+    ugrid_st grid;          ///< the cells of the UI
+    shmgrid_header_st *shm_hdr; ///< mapping of the object, NULL for none
+    size_t shm_size;        ///< size of the mapping
+    char shm_name[SHMGRID_NAME_SIZE];     ///< name of the object
+    char shm_old_name[SHMGRID_NAME_SIZE]; ///< name of the object before,
+                                          ///< the UI may still open it
+    uint32_t shm_count;     ///< objects made so far
+    kvec_t(uihl_attr_st) shm_attrs; ///< the attribute table
+    size_t shm_attr_last;   ///< index of the attributes found last
+    bool shm_attrs_full;    ///< attributes were left out of the table
+    uint8_t *shm_dirty;     ///< per row, bit 0 and 1 set when buffer 0 and
+                            ///< 1 miss changes of the row
+    int shm_top;            ///< first row changed since the last frame
+    int shm_bot;            ///< last row changed since the last frame,
+                            ///< -1 for none
+    int shm_row;            ///< cursor position the UI got
+    int shm_col;
 } ui_data_st;
 
 static PMap(uint64_t) *connected_uis = NULL;
@@ -35,6 +155,27 @@ FUNC_API_NOEXPORT
     connected_uis = pmap_new(uint64_t)();
 }
 
+/// Send the notifications held back by the "flush_rate" option now, and
+/// try again to publish the shared memory frames a UI wasn't ready for:
+/// Nvim is about to block for input with the events disabled, a prompt
+/// mustn't wait for the next key to show up.
+void remote_ui_flush_held(void)
+FUNC_API_NOEXPORT
+{
+    ui_st *ui;
+
+    map_foreach_value(connected_uis, ui, {
+        ui_data_st *data = ui->data;
+
+        if(data->held)
+        {
+            time_watcher_stop(&data->timer);
+            data->held = false;
+            remote_ui_flush_now(ui, true);
+        }
+    });
+}
+
 void remote_ui_disconnect(uint64_t channel_id)
 FUNC_API_NOEXPORT
 {
@@ -46,14 +187,44 @@ FUNC_API_NOEXPORT
     }
 
     ui_data_st *data = ui->data;
+
+    if(data->shm)
+    {
+        shm_close(data);
+    }
+
     // destroy pending screen updates
-    api_free_array(data->buffer);
+    msgpack_sbuffer_destroy(&data->sbuf);
+    msgpack_sbuffer_destroy(&data->spare);
+    kv_destroy(data->calls);
+    kv_destroy(data->lines);
+    kv_destroy(data->hl_attrs);
     pmap_del(uint64_t)(connected_uis, channel_id);
-    xfree(ui->data);
+
+    // The timer is closed asynchronously, it frees the data when done.
+    // A time event queued before the timer stopped can still run.
+    time_watcher_stop(&data->timer);
+    multiqueue_free(data->events);
+    data->timer.cb = remote_ui_timer_stale_cb;
+    data->timer.data = data;
+    time_watcher_close(&data->timer, remote_ui_timer_close_cb);
+
     ui_detach_impl(ui);
     xfree(ui);
 }
 
+static void remote_ui_timer_close_cb(time_watcher_st *FUNC_ARGS_UNUSED_MATCH(watcher),
+                                     void *data)
+{
+    xfree(data);
+}
+
+static void remote_ui_timer_stale_cb(time_watcher_st *FUNC_ARGS_UNUSED_MATCH(watcher),
+                                     void *FUNC_ARGS_UNUSED_MATCH(data))
+{
+    // The UI is gone.
+}
+
 void nvim_ui_attach(uint64_t channel_id,
                     Integer width,
                     Integer height,
@@ -95,6 +266,7 @@ FUNC_API_REMOTE_ONLY
     ui->scroll = remote_ui_scroll;
     ui->highlight_set = remote_ui_highlight_set;
     ui->put = remote_ui_put;
+    ui->put_run = remote_ui_put_run;
     ui->bell = remote_ui_bell;
     ui->visual_bell = remote_ui_visual_bell;
     ui->update_fg = remote_ui_update_fg;
@@ -108,6 +280,16 @@ FUNC_API_REMOTE_ONLY
 
     memset(ui->ui_ext, 0, sizeof(ui->ui_ext));
 
+    ui_data_st *data = xcalloc(1, sizeof(ui_data_st));
+    data->channel_id = channel_id;
+    msgpack_sbuffer_init(&data->sbuf);
+    msgpack_packer_init(&data->pac, &data->sbuf, msgpack_sbuffer_write);
+    msgpack_sbuffer_init(&data->spare);
+    kv_init(data->calls);
+    kv_init(data->lines);
+    kv_init(data->hl_attrs);
+    ui->data = data;
+
     for(size_t i = 0; i < options.size; i++)
     {
         ui_set_option(ui, options.items[i].key,
@@ -115,15 +297,24 @@ FUNC_API_REMOTE_ONLY
 
         if(ERROR_SET(err))
         {
+            if(data->shm)
+            {
+                shm_close(data);
+            }
+
+            msgpack_sbuffer_destroy(&data->sbuf);
+            msgpack_sbuffer_destroy(&data->spare);
+            kv_destroy(data->calls);
+            kv_destroy(data->lines);
+            kv_destroy(data->hl_attrs);
+            xfree(data);
             xfree(ui);
             return;
         }
     }
 
-    ui_data_st *data = xmalloc(sizeof(ui_data_st));
-    data->channel_id = channel_id;
-    data->buffer = (Array)ARRAY_DICT_INIT;
-    ui->data = data;
+    time_watcher_init(&main_loop, &data->timer, ui);
+    data->events = multiqueue_new_child(main_loop.events);
 
     pmap_put(uint64_t)(connected_uis, channel_id, ui);
     ui_attach_impl(ui);
@@ -233,6 +424,50 @@ static void ui_set_option(ui_st *ui,
     UI_EXT_OPTION(ext_tabline, kUITabline);
     UI_EXT_OPTION(ext_wildmenu, kUIWildmenu);
 
+    if(xstrequal(name.data, "ext_lineruns"))
+    {
+        if(value.type != kObjectTypeBoolean)
+        {
+            api_set_error(error, kErrorTypeValidation,
+                          "ext_lineruns must be a Boolean");
+            return;
+        }
+
+        remote_ui_set_line_runs(ui, value.data.boolean);
+        return;
+    }
+
+    if(xstrequal(name.data, "ext_shmgrid"))
+    {
+        if(value.type != kObjectTypeBoolean)
+        {
+            api_set_error(error, kErrorTypeValidation,
+                          "ext_shmgrid must be a Boolean");
+            return;
+        }
+
+        if(!remote_ui_set_shm(ui, value.data.boolean))
+        {
+            api_set_error(error, kErrorTypeException,
+                          "ext_shmgrid is not supported");
+        }
+
+        return;
+    }
+
+    if(xstrequal(name.data, "flush_rate"))
+    {
+        if(value.type != kObjectTypeInteger || value.data.integer < 0)
+        {
+            api_set_error(error, kErrorTypeValidation,
+                          "flush_rate must be a non-negative Integer");
+            return;
+        }
+
+        ((ui_data_st *)ui->data)->flush_rate = value.data.integer;
+        return;
+    }
+
     if(xstrequal(name.data, "popupmenu_external"))
     {
         // LEGACY: Deprecated option, use `ui_ext` instead.
@@ -251,111 +486,1009 @@ static void ui_set_option(ui_st *ui,
 #undef UI_EXT_OPTION
 }
 
-static void push_call(ui_st *ui, char *name, Array args)
+/// Switch the "ext_lineruns" option of remote UI @b ui. The UI gets new
+/// highlight ids, ui_refresh() redraws everything after this.
+static void remote_ui_set_line_runs(ui_st *ui, bool line_runs)
+{
+    ui_data_st *data = ui->data;
+
+    if(data->line_runs)
+    {
+        line_runs_sync(ui);
+    }
+
+    data->line_runs = line_runs;
+    kv_size(data->hl_attrs) = 0;
+    data->hl_id = 0;
+    data->ui_hl_id = 0;
+    data->row = 0;
+    data->col = 0;
+    data->goto_pending = false;
+
+    remote_ui_set_draw_callbacks(ui);
+}
+
+/// Point the drawing callbacks of remote UI @b ui to the ones of its
+/// options, "ext_shmgrid" goes before "ext_lineruns".
+static void remote_ui_set_draw_callbacks(ui_st *ui)
+{
+    ui_data_st *data = ui->data;
+
+    if(data->shm)
+    {
+        ui->put = remote_ui_shm_put;
+        ui->cursor_goto = remote_ui_shm_goto;
+        ui->resize = remote_ui_shm_resize;
+        ui->clear = remote_ui_shm_clear;
+        ui->eol_clear = remote_ui_shm_eol_clear;
+        ui->set_scroll_region = remote_ui_shm_set_scroll_region;
+        ui->scroll = remote_ui_shm_scroll;
+        ui->highlight_set = remote_ui_shm_highlight_set;
+        return;
+    }
+
+    ui->put = data->line_runs ? remote_ui_line_put : remote_ui_put;
+    ui->cursor_goto = data->line_runs ? remote_ui_line_goto
+                                      : remote_ui_cursor_goto;
+    ui->resize = data->line_runs ? remote_ui_line_resize : remote_ui_resize;
+    ui->clear = remote_ui_clear;
+    ui->eol_clear = remote_ui_eol_clear;
+    ui->set_scroll_region = remote_ui_set_scroll_region;
+    ui->scroll = remote_ui_scroll;
+    ui->highlight_set = remote_ui_highlight_set;
+}
+
+/// Switch the "ext_shmgrid" option of remote UI @b ui, ui_refresh()
+/// redraws everything after this.
+///
+/// @return false when no shared memory object can be created.
+static bool remote_ui_set_shm(ui_st *ui, bool shm)
+{
+    ui_data_st *data = ui->data;
+
+    if(shm == data->shm)
+    {
+        return true;
+    }
+
+    if(data->line_runs)
+    {
+        line_runs_sync(ui);
+    }
+
+    close_args(data);
+
+    if(shm)
+    {
+        ugrid_init(&data->grid);
+        ugrid_resize(&data->grid, ui->width, ui->height);
+        ugrid_clear(&data->grid);
+        kv_init(data->shm_attrs);
+        data->shm_row = 0;
+        data->shm_col = 0;
+        data->shm = true;
+
+        if(!shm_new_object(ui))
+        {
+            shm_close(data);
+            return false;
+        }
+    }
+    else
+    {
+        shm_close(data);
+
+        // The UI drops its mapping.
+        msgpack_packer *pac = push_call(ui, "grid_shm", 3);
+        rpc_from_string(STATIC_CSTR_AS_STRING(""), pac);
+        rpc_from_integer(0, pac);
+        rpc_from_integer(0, pac);
+    }
+
+    remote_ui_set_draw_callbacks(ui);
+    return true;
+}
+
+/// Replace the shared memory object of remote UI @b ui by a new one the
+/// size of its grid, announced by a "grid_shm" event. The next frame has
+/// all the rows.
+static bool shm_new_object(ui_st *ui)
+{
+    ui_data_st *data = ui->data;
+    int rows = data->grid.height;
+    int cols = data->grid.width;
+    size_t size = SHMGRID_SIZE(rows, cols);
+    char name[SHMGRID_NAME_SIZE];
+
+    snprintf(name, sizeof(name), "/nvim-grid-%" PRId64 "-%" PRIu64 "-%" PRIu32,
+             os_get_pid(), data->channel_id, data->shm_count++);
+
+    shmgrid_header_st *hdr = os_shm_create(name, size);
+
+    if(hdr == NULL)
+    {
+        return false;
+    }
+
+    if(data->shm_old_name[0] != NUL)
+    {
+        os_shm_unlink(data->shm_old_name);
+    }
+
+    memcpy(data->shm_old_name, data->shm_name, sizeof(data->shm_name));
+    memcpy(data->shm_name, name, sizeof(name));
+
+    if(data->shm_hdr != NULL)
+    {
+        os_munmap(data->shm_hdr, data->shm_size);
+    }
+
+    data->shm_hdr = hdr;
+    data->shm_size = size;
+
+    hdr->magic = SHMGRID_MAGIC;
+    hdr->version = SHMGRID_VERSION;
+    hdr->rows = (uint32_t)rows;
+    hdr->cols = (uint32_t)cols;
+    hdr->attrs_max = SHMGRID_ATTRS_MAX;
+
+    kv_size(data->shm_attrs) = 0;
+    data->shm_attr_last = 0;
+    data->shm_attrs_full = false;
+    (void)shm_attr_id(data, EMPTY_ATTRS);
+
+    xfree(data->shm_dirty);
+    data->shm_dirty = xmalloc((size_t)rows);
+    memset(data->shm_dirty, 0x03, (size_t)rows);
+    data->shm_top = 0;
+    data->shm_bot = rows - 1;
+
+    msgpack_packer *pac = push_call(ui, "grid_shm", 3);
+    rpc_from_string(cstr_as_string(name), pac);
+    rpc_from_integer(rows, pac);
+    rpc_from_integer(cols, pac);
+    return true;
+}
+
+/// Drop the shared memory objects and the grid of @b data.
+static void shm_close(ui_data_st *data)
+{
+    if(data->shm_hdr != NULL)
+    {
+        os_munmap(data->shm_hdr, data->shm_size);
+        data->shm_hdr = NULL;
+    }
+
+    if(data->shm_name[0] != NUL)
+    {
+        os_shm_unlink(data->shm_name);
+        data->shm_name[0] = NUL;
+    }
+
+    if(data->shm_old_name[0] != NUL)
+    {
+        os_shm_unlink(data->shm_old_name);
+        data->shm_old_name[0] = NUL;
+    }
+
+    xfree(data->shm_dirty);
+    data->shm_dirty = NULL;
+    kv_destroy(data->shm_attrs);
+    ugrid_free(&data->grid);
+    data->shm = false;
+}
+
+/// Return the index of @b attrs in the attribute table of @b data, adding
+/// them if needed. A full table gives the default attributes, shm_frame()
+/// then starts over with a new object.
+static uint32_t shm_attr_id(ui_data_st *data, uihl_attr_st attrs)
+{
+    size_t n = kv_size(data->shm_attrs);
+
+    if(data->shm_attr_last < n
+       && hl_attrs_equal(kv_A(data->shm_attrs, data->shm_attr_last), attrs))
+    {
+        return (uint32_t)data->shm_attr_last;
+    }
+
+    for(size_t i = 0; i < n; i++)
+    {
+        if(hl_attrs_equal(kv_A(data->shm_attrs, i), attrs))
+        {
+            data->shm_attr_last = i;
+            return (uint32_t)i;
+        }
+    }
+
+    if(n >= SHMGRID_ATTRS_MAX)
+    {
+        data->shm_attrs_full = true;
+        return 0;
+    }
+
+    shmgrid_attr_st *entry = SHMGRID_ATTRS(data->shm_hdr) + n;
+    entry->foreground = (int32_t)attrs.foreground;
+    entry->background = (int32_t)attrs.background;
+    entry->special = (int32_t)attrs.special;
+    entry->flags = (attrs.bold ? kShmgridBold : 0)
+                   | (attrs.italic ? kShmgridItalic : 0)
+                   | (attrs.underline ? kShmgridUnderline : 0)
+                   | (attrs.undercurl ? kShmgridUndercurl : 0)
+                   | (attrs.reverse ? kShmgridReverse : 0);
+
+    kv_push(data->shm_attrs, attrs);
+    __atomic_store_n(&data->shm_hdr->attrs_size, (uint32_t)n + 1,
+                     __ATOMIC_RELEASE);
+    data->shm_attr_last = n;
+    return (uint32_t)n;
+}
+
+/// Rows @b top to @b bot of the grid of @b data changed.
+static void shm_mark_rows(ui_data_st *data, int top, int bot)
+{
+    for(int row = top; row <= bot; row++)
+    {
+        data->shm_dirty[row] = 0x03;
+    }
+
+    data->shm_top = MIN(data->shm_top, top);
+    data->shm_bot = MAX(data->shm_bot, bot);
+}
+
+/// Publish the rows of remote UI @b ui changed since the last frame with
+/// a "grid_flush" event, and the position of the cursor.
+///
+/// @return false when the UI still reads the frame before last, the rows
+///         wait for a later try.
+static bool shm_frame(ui_st *ui, bool retry)
+{
+    ui_data_st *data = ui->data;
+    shmgrid_header_st *hdr = data->shm_hdr;
+    ugrid_st *grid = &data->grid;
+
+    if(data->shm_bot >= 0)
+    {
+        uint32_t seq = hdr->seq;
+        uint32_t ack = __atomic_load_n(&hdr->ack, __ATOMIC_ACQUIRE);
+
+        if(seq - ack > 1)
+        {
+            return false;
+        }
+
+        uint32_t buf = 1 - hdr->front;
+        shmgrid_cell_st *cells = SHMGRID_CELLS(hdr, buf);
+
+        for(int row = 0; row < grid->height; row++)
+        {
+            if(!(data->shm_dirty[row] & (1 << buf)))
+            {
+                continue;
+            }
+
+            ucell_st *in = grid->cells[row];
+            shmgrid_cell_st *out = cells + (size_t)row * (size_t)grid->width;
+
+            for(int col = 0; col < grid->width; col++)
+            {
+                const char *text = in[col].data;
+                // An empty cell is the right half of a double-width char.
+                out[col].chr = text[0] == NUL
+                               ? 0 : (uint32_t)utf_ptr2char((uchar_kt *)text);
+                out[col].attr = shm_attr_id(data, in[col].attrs);
+            }
+
+            data->shm_dirty[row] &= (uint8_t)~(1 << buf);
+        }
+
+        if(data->shm_attrs_full && !retry && shm_new_object(ui))
+        {
+            // Only the attributes on the screen go in the new table.
+            return shm_frame(ui, true);
+        }
+
+        __atomic_store_n(&hdr->front, buf, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELEASE);
+
+        msgpack_packer *pac = push_call(ui, "grid_flush", 3);
+        rpc_from_integer(seq + 1, pac);
+        rpc_from_integer(data->shm_top, pac);
+        rpc_from_integer(data->shm_bot, pac);
+
+        data->shm_top = grid->height;
+        data->shm_bot = -1;
+    }
+
+    if(grid->row != data->shm_row || grid->col != data->shm_col)
+    {
+        msgpack_packer *pac = push_call(ui, "cursor_goto", 2);
+        rpc_from_integer(grid->row, pac);
+        rpc_from_integer(grid->col, pac);
+        data->shm_row = grid->row;
+        data->shm_col = grid->col;
+    }
+
+    return true;
+}
+
+static void remote_ui_shm_put(ui_st *ui, String str)
+{
+    ui_data_st *data = ui->data;
+    shm_mark_rows(data, data->grid.row, data->grid.row);
+    ugrid_put(&data->grid, (uint8_t *)str.data, str.size);
+}
+
+static void remote_ui_shm_goto(ui_st *ui, Integer row, Integer col)
+{
+    ui_data_st *data = ui->data;
+    ugrid_goto(&data->grid, (int)row, (int)col);
+}
+
+static void remote_ui_shm_resize(ui_st *ui, Integer rows, Integer columns)
+{
+    ui_data_st *data = ui->data;
+    bool same = rows == data->grid.height && columns == data->grid.width;
+    remote_ui_resize(ui, rows, columns);
+
+    ugrid_resize(&data->grid, (int)columns, (int)rows);
+    ugrid_clear(&data->grid);
+
+    // A resize puts the cursor of the UI at the top left.
+    data->shm_row = 0;
+    data->shm_col = 0;
+
+    if(same)
+    {
+        // ui_refresh() of an unchanged size keeps the object.
+        shm_mark_rows(data, 0, data->grid.height - 1);
+        return;
+    }
+
+    if(!shm_new_object(ui))
+    {
+        // The cells go in "redraw" again, the resize redraws them all.
+        (void)remote_ui_set_shm(ui, false);
+    }
+}
+
+static void remote_ui_shm_clear(ui_st *ui)
+{
+    ui_data_st *data = ui->data;
+    shm_mark_rows(data, data->grid.top, data->grid.bot);
+    ugrid_clear(&data->grid);
+}
+
+static void remote_ui_shm_eol_clear(ui_st *ui)
+{
+    ui_data_st *data = ui->data;
+    shm_mark_rows(data, data->grid.row, data->grid.row);
+    ugrid_eol_clear(&data->grid);
+}
+
+static void remote_ui_shm_set_scroll_region(ui_st *ui,
+                                            Integer top,
+                                            Integer bot,
+                                            Integer left,
+                                            Integer right)
 {
-    Array call = ARRAY_DICT_INIT;
     ui_data_st *data = ui->data;
+    ugrid_set_scroll_region(&data->grid, (int)top, (int)bot,
+                            (int)left, (int)right);
+}
+
+/// The UI gets the moved rows as changed ones.
+static void remote_ui_shm_scroll(ui_st *ui, Integer count)
+{
+    ui_data_st *data = ui->data;
+    int clear_top, clear_bot;
+
+    shm_mark_rows(data, data->grid.top, data->grid.bot);
+    ugrid_scroll(&data->grid, (int)count, &clear_top, &clear_bot);
+}
+
+static void remote_ui_shm_highlight_set(ui_st *ui, uihl_attr_st attrs)
+{
+    ((ui_data_st *)ui->data)->grid.attrs = attrs;
+}
+
+/// Pack a msgpack header of @b type with a 32 bit @b value for the
+/// notification of @b data, to be changed by repack_u32() later.
+///
+/// @return the offset of the header
+static size_t pack_u32(ui_data_st *data, uint8_t type, size_t value)
+{
+    size_t pos = data->sbuf.size;
+    char hdr[5] = { (char)type };
+
+    (void)msgpack_sbuffer_write(&data->sbuf, hdr, sizeof(hdr));
+    repack_u32(data, pos, value);
+    return pos;
+}
 
-    // To optimize data transfer(especially for "put"), we bundle adjacent
-    // calls to same method together, so only add a new call entry if the last
-    // method call is different from "name"
-    if(kv_size(data->buffer))
+/// Change the value of the header at @b pos written by pack_u32().
+static void repack_u32(ui_data_st *data, size_t pos, size_t value)
+{
+    put_u32(data->sbuf.data + pos, value);
+}
+
+/// Set the 32 bit @b value of the msgpack header at @b hdr.
+static void put_u32(char *hdr, size_t value)
+{
+    assert(value <= UINT32_MAX);
+    uint8_t *p = (uint8_t *)hdr + 1;
+
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+/// Finish the "put" string or "line" cells that events could still be
+/// merged into.
+static void close_args(ui_data_st *data)
+{
+    if(data->put_pos != 0)
     {
-        call = kv_A(data->buffer, kv_size(data->buffer) - 1).data.array;
+        repack_u32(data, data->put_pos, data->put_size);
+        data->put_pos = 0;
     }
 
-    if(!kv_size(call) || strcmp(kv_A(call, 0).data.string.data, name))
+    if(data->cells_pos != 0)
     {
-        call = (Array)ARRAY_DICT_INIT;
-        ADD(data->buffer, ARRAY_OBJ(call));
-        ADD(call, STRING_OBJ(cstr_to_string(name)));
+        line_runs_close(data);
     }
+}
+
+/// Finish the open "line" of @b data. It is superseded when a later
+/// "line" draws over all its cells, see drop_superseded().
+static void line_runs_close(ui_data_st *data)
+{
+    linerec_st line = {
+        .start = data->line_pos,
+        .stop = data->sbuf.size,
+        .call = kv_size(data->calls) - 1,
+        .row = data->line_row,
+        .col = data->line_col,
+        .end = data->line_end,
+        .superseded = false,
+    };
+
+    repack_u32(data, data->cells_pos, data->ncells);
+    data->cells_pos = 0;
+
+    for(size_t i = kv_size(data->lines); i > data->lines_barrier; i--)
+    {
+        linerec_st *prev = &kv_A(data->lines, i - 1);
 
-    ADD(call, ARRAY_OBJ(args));
-    kv_A(data->buffer, kv_size(data->buffer) - 1).data.array = call;
+        if(!prev->superseded
+           && prev->row == line.row
+           && prev->col >= line.col
+           && prev->end <= line.end)
+        {
+            prev->superseded = true;
+            kv_A(data->calls, prev->call).nsuperseded++;
+            data->nsuperseded++;
+        }
+    }
+
+    kv_push(data->lines, line);
+
+    // The "line" may be dropped, so the cursor position and highlight it
+    // leaves the UI with can't be relied on.
+    data->goto_pending = true;
+    data->ui_hl_id = 0;
+}
+
+/// Start the arguments of a call to "name" in the "redraw" notification of
+/// remote UI @b ui. Calls of the same method next to each other are
+/// bundled: ["put", [a], [b]] instead of ["put", [a]], ["put", [b]].
+///
+/// @return the packer to pack the @b nargs arguments with.
+static msgpack_packer *pack_call(ui_st *ui, const char *name, size_t nargs)
+{
+    ui_data_st *data = ui->data;
+
+    close_args(data);
+
+    if(data->sbuf.size == 0)
+    {
+        msgpack_pack_array(&data->pac, 3);
+        msgpack_pack_int(&data->pac, 2);
+        rpc_from_string(cstr_as_string("redraw"), &data->pac);
+        data->calls_pos = pack_u32(data, kPackArray32, 0);
+    }
+
+    if(data->call_name == NULL || strcmp(data->call_name, name) != 0)
+    {
+        if(data->call_name != NULL)
+        {
+            callrec_st *call = &kv_last(data->calls);
+            repack_u32(data, call->pos, call->nargs + 1);
+        }
+
+        callrec_st call = { .pos = pack_u32(data, kPackArray32, 0) };
+        kv_push(data->calls, call);
+        rpc_from_string(cstr_as_string((char *)name), &data->pac);
+        data->call_name = name;
+
+        if(!moves_cursor_only(name))
+        {
+            data->draws = true;
+        }
+    }
+
+    kv_last(data->calls).nargs++;
+    data->args_pos = data->sbuf.size;
+    msgpack_pack_array(&data->pac, nargs);
+    return &data->pac;
+}
+
+/// Calls that can't wait for the next frame, see remote_ui_flush().
+static bool moves_cursor_only(const char *name)
+{
+    return strcmp(name, "cursor_goto") == 0
+           || strcmp(name, "highlight_set") == 0
+           || strcmp(name, "mode_change") == 0;
+}
+
+/// Like pack_call(), after bringing a UI with "ext_lineruns" up to date.
+static msgpack_packer *push_call(ui_st *ui, const char *name, size_t nargs)
+{
+    ui_data_st *data = ui->data;
+
+    // Anything but cells needs the UI to know where the cursor is and
+    // which highlight is current.
+    if(data->line_runs)
+    {
+        line_runs_sync(ui);
+
+        // Cells drawn after a scroll don't supersede the ones it moved.
+        if(strcmp(name, "scroll") == 0)
+        {
+            data->lines_barrier = kv_size(data->lines);
+        }
+    }
+
+    return pack_call(ui, name, nargs);
 }
 
 static void remote_ui_highlight_set(ui_st *ui, uihl_attr_st attrs)
 {
-    Array args = ARRAY_DICT_INIT;
-    Dictionary hl = ARRAY_DICT_INIT;
+    ui_data_st *data = ui->data;
 
-    if(attrs.bold)
+    if(data->line_runs)
     {
-        PUT(hl, "bold", BOOLEAN_OBJ(true));
+        data->hl_id = line_runs_hl_id(ui, attrs);
+        return;
     }
 
-    if(attrs.underline)
+    pack_hl_attrs(push_call(ui, "highlight_set", 1), attrs);
+}
+
+static bool hl_attrs_equal(uihl_attr_st a, uihl_attr_st b)
+{
+    return a.bold == b.bold
+           && a.underline == b.underline
+           && a.undercurl == b.undercurl
+           && a.italic == b.italic
+           && a.reverse == b.reverse
+           && a.foreground == b.foreground
+           && a.background == b.background
+           && a.special == b.special;
+}
+
+/// Pack @b attrs as the dictionary of "highlight_set".
+static void pack_hl_attrs(msgpack_packer *pac, uihl_attr_st attrs)
+{
+    size_t n = (size_t)attrs.bold
+               + (size_t)attrs.underline
+               + (size_t)attrs.undercurl
+               + (size_t)attrs.italic
+               + (size_t)attrs.reverse
+               + (size_t)(attrs.foreground != -1)
+               + (size_t)(attrs.background != -1)
+               + (size_t)(attrs.special != -1);
+
+    msgpack_pack_map(pac, n);
+
+#define PACK_HL_FLAG(name)                                  \
+    if(attrs.name)                                          \
+    {                                                       \
+        rpc_from_string(cstr_as_string(#name), pac);        \
+        msgpack_pack_true(pac);                             \
+    }
+
+#define PACK_HL_COLOR(name)                                 \
+    if(attrs.name != -1)                                    \
+    {                                                       \
+        rpc_from_string(cstr_as_string(#name), pac);        \
+        rpc_from_integer(attrs.name, pac);                  \
+    }
+
+    PACK_HL_FLAG(bold);
+    PACK_HL_FLAG(underline);
+    PACK_HL_FLAG(undercurl);
+    PACK_HL_FLAG(italic);
+    PACK_HL_FLAG(reverse);
+    PACK_HL_COLOR(foreground);
+    PACK_HL_COLOR(background);
+    PACK_HL_COLOR(special);
+
+#undef PACK_HL_FLAG
+#undef PACK_HL_COLOR
+}
+
+/// Return the highlight id of @b attrs for remote UI @b ui, sending a
+/// "hl_define" event the first time @b attrs are used.
+static Integer line_runs_hl_id(ui_st *ui, uihl_attr_st attrs)
+{
+    ui_data_st *data = ui->data;
+
+    if(data->hl_id > 0
+       && hl_attrs_equal(kv_A(data->hl_attrs, data->hl_id - 1), attrs))
     {
-        PUT(hl, "underline", BOOLEAN_OBJ(true));
+        return data->hl_id;
     }
 
-    if(attrs.undercurl)
+    for(size_t i = 0; i < kv_size(data->hl_attrs); i++)
     {
-        PUT(hl, "undercurl", BOOLEAN_OBJ(true));
+        if(hl_attrs_equal(kv_A(data->hl_attrs, i), attrs))
+        {
+            return (Integer)i + 1;
+        }
     }
 
-    if(attrs.italic)
+    kv_push(data->hl_attrs, attrs);
+
+    // This ends the open "line", the next cell starts a new one.
+    Integer id = (Integer)kv_size(data->hl_attrs);
+    msgpack_packer *pac = pack_call(ui, "hl_define", 2);
+    rpc_from_integer(id, pac);
+    pack_hl_attrs(pac, attrs);
+    return id;
+}
+
+/// Add the cell @b text at the cursor to the open "line" of remote UI
+/// @b ui, or to a new one when the cursor isn't at its end. An empty
+/// @b text is the right half of a double-width character, it is packed
+/// as an empty cell: the UI places the cells by count, not by the width
+/// it gives the characters.
+static void line_runs_put(ui_st *ui, String text)
+{
+    ui_data_st *data = ui->data;
+    msgpack_packer *pac = &data->pac;
+
+    if(data->cells_pos == 0
+       || data->row != data->line_row
+       || data->col != data->line_end)
     {
-        PUT(hl, "italic", BOOLEAN_OBJ(true));
+        if(text.size == 0)
+        {
+            // Nothing to draw, the UI needs to know where the cursor went.
+            data->col++;
+            data->goto_pending = true;
+            return;
+        }
+
+        pac = pack_call(ui, "line", 3);
+        rpc_from_integer(data->row, pac);
+        rpc_from_integer(data->col, pac);
+        data->cells_pos = pack_u32(data, kPackArray32, 0);
+        data->ncells = 0;
+        data->line_pos = data->args_pos;
+        data->line_row = data->row;
+        data->line_col = data->col;
     }
 
-    if(attrs.reverse)
+    // "line" moves the cursor like the puts it replaces.
+    data->goto_pending = false;
+    data->col++;
+    data->line_end = data->col;
+
+    if(data->ncells > 0
+       && data->line_hl_id == data->hl_id
+       && data->text_size == text.size
+       && memcmp(data->sbuf.data + data->text_pos, text.data, text.size) == 0)
     {
-        PUT(hl, "reverse", BOOLEAN_OBJ(true));
+        repack_u32(data, data->repeat_pos, ++data->repeat);
+        return;
     }
 
-    if(attrs.foreground != -1)
+    msgpack_pack_array(pac, 3);
+    msgpack_pack_str(pac, text.size);
+    data->text_pos = data->sbuf.size;
+    data->text_size = text.size;
+    msgpack_pack_str_body(pac, text.data, text.size);
+    rpc_from_integer(data->hl_id, pac);
+    data->repeat = 1;
+    data->repeat_pos = pack_u32(data, kPackUint32, data->repeat);
+    data->ncells++;
+    data->line_hl_id = data->hl_id;
+}
+
+/// Bring remote UI @b ui up to date before an event that isn't a cell:
+/// end the open "line", send the cursor position and the highlight.
+static void line_runs_sync(ui_st *ui)
+{
+    ui_data_st *data = ui->data;
+
+    close_args(data);
+
+    if(data->goto_pending)
     {
-        PUT(hl, "foreground", INTEGER_OBJ(attrs.foreground));
+        msgpack_packer *pac = pack_call(ui, "cursor_goto", 2);
+        rpc_from_integer(data->row, pac);
+        rpc_from_integer(data->col, pac);
+        data->goto_pending = false;
     }
 
-    if(attrs.background != -1)
+    if(data->hl_id > 0 && data->hl_id != data->ui_hl_id)
     {
-        PUT(hl, "background", INTEGER_OBJ(attrs.background));
+        uihl_attr_st attrs = kv_A(data->hl_attrs, data->hl_id - 1);
+        pack_hl_attrs(pack_call(ui, "highlight_set", 1), attrs);
+        data->ui_hl_id = data->hl_id;
     }
+}
 
-    if(attrs.special != -1)
+static void remote_ui_line_put(ui_st *ui, String str)
+{
+    line_runs_put(ui, str);
+}
+
+static void remote_ui_line_goto(ui_st *ui, Integer row, Integer col)
+{
+    ui_data_st *data = ui->data;
+
+    // Also a move to the end of the open "line" ends it: ui_puts() moves
+    // there after an ambiguous width character, the next "line" gives the
+    // UI the column again in case its width differs.
+    close_args(data);
+
+    data->row = row;
+    data->col = col;
+    data->goto_pending = true;
+}
+
+static void remote_ui_line_resize(ui_st *ui, Integer rows, Integer columns)
+{
+    ui_data_st *data = ui->data;
+    remote_ui_resize(ui, rows, columns);
+
+    // A resize puts the cursor of the UI at the top left.
+    data->row = 0;
+    data->col = 0;
+    data->goto_pending = false;
+}
+
+/// Consecutive puts are merged into one string.
+static void remote_ui_put(ui_st *ui, String str)
+{
+    ui_data_st *data = ui->data;
+
+    if(data->put_pos == 0)
     {
-        PUT(hl, "special", INTEGER_OBJ(attrs.special));
+        (void)push_call(ui, "put", 1);
+        data->put_pos = pack_u32(data, kPackStr32, 0);
+        data->put_size = 0;
     }
 
-    ADD(args, DICTIONARY_OBJ(hl));
-    push_call(ui, "highlight_set", args);
+    if(str.size > 0)
+    {
+        (void)msgpack_sbuffer_write(&data->sbuf, str.data, str.size);
+        data->put_size += str.size;
+    }
 }
 
+/// With the "flush_rate" option, a flush that comes sooner than
+/// 1/flush_rate seconds after the last drawing was sent is held back: the
+/// next events are added to the same notification, and it is sent by the
+/// first flush after the interval or by the timer, at the latest when Nvim
+/// blocks for input, see remote_ui_flush_held(). Notifications that only
+/// move the cursor are sent right away, typing mustn't wait for a frame.
+///
+/// With the "ext_shmgrid" option the flush publishes a frame first. While
+/// the UI is too far behind to take one, the timer tries again, also while
+/// Nvim waits for input at a prompt.
 static void remote_ui_flush(ui_st *ui)
+{
+    remote_ui_flush_now(ui, false);
+}
+
+/// Flush remote UI @b ui, with @b force a held notification is sent
+/// without waiting for the "flush_rate" interval.
+static void remote_ui_flush_now(ui_st *ui, bool force)
 {
     ui_data_st *data = ui->data;
+    bool blocked = data->shm && !shm_frame(ui, false);
+
+    if(data->line_runs)
+    {
+        line_runs_sync(ui);
+    }
+
+    close_args(data);
+
+    if(data->sbuf.size > 0)
+    {
+        uint64_t now = os_hrtime();
+        uint64_t interval = data->flush_rate > 0
+                            ? 1000000000 / (uint64_t)data->flush_rate : 0;
 
-    if(data->buffer.size > 0)
+        if(!force && data->draws && now - data->last_send < interval)
+        {
+            if(!data->held)
+            {
+                uint64_t wait = (interval - (now - data->last_send)) / 1000000;
+                time_watcher_start(&data->timer, remote_ui_timer_cb, wait + 1, 0);
+                data->held = true;
+            }
+
+            return;
+        }
+
+        remote_ui_send(data, now);
+    }
+
+    if(blocked && !data->held)
     {
-        channel_send_event(data->channel_id, "redraw", data->buffer);
-        data->buffer = (Array)ARRAY_DICT_INIT;
+        time_watcher_start(&data->timer, remote_ui_timer_cb,
+                           SHMGRID_RETRY_MS, 0);
+        data->held = true;
     }
 }
 
-static void remote_ui_event(ui_st *ui,
-                            char *name,
-                            Array args,
-                            bool *args_consumed)
+/// Runs as a fast event. Sending is only safe while Nvim waits for input,
+/// otherwise a frame that is being drawn could be split: then the flush
+/// goes to the main queue.
+static void remote_ui_timer_cb(time_watcher_st *FUNC_ARGS_UNUSED_MATCH(watcher),
+                               void *data)
+{
+    ui_st *ui = data;
+
+    if(input_blocking())
+    {
+        remote_ui_timer_event((void **)&ui);
+        return;
+    }
+
+    multiqueue_put(((ui_data_st *)ui->data)->events,
+                   remote_ui_timer_event, 1, ui);
+}
+
+static void remote_ui_timer_event(void **argv)
+{
+    ui_st *ui = argv[0];
+    ((ui_data_st *)ui->data)->held = false;
+    remote_ui_flush(ui);
+}
+
+/// Send the "redraw" notification of @b data at time @b now.
+static void remote_ui_send(ui_data_st *data, uint64_t now)
 {
-    Array my_args = ARRAY_DICT_INIT;
+    callrec_st *call = &kv_last(data->calls);
+    repack_u32(data, call->pos, call->nargs + 1);
+    repack_u32(data, data->calls_pos, kv_size(data->calls));
 
-    // Objects are currently single-reference
-    // make a copy, but only if necessary
-    if(*args_consumed)
+    if(data->nsuperseded > 0)
     {
-        for(size_t i = 0; i < args.size; i++)
+        drop_superseded(data);
+    }
+
+    channel_send_packed(data->channel_id, &data->sbuf);
+
+    if(data->draws)
+    {
+        data->last_send = now;
+    }
+
+    if(data->held)
+    {
+        time_watcher_stop(&data->timer);
+        data->held = false;
+    }
+
+    // Keep the memory of the buffer for the next notification.
+    msgpack_sbuffer_clear(&data->sbuf);
+    kv_size(data->calls) = 0;
+    kv_size(data->lines) = 0;
+    data->call_name = NULL;
+    data->lines_barrier = 0;
+    data->nsuperseded = 0;
+    data->draws = false;
+}
+
+/// Replace the notification of @b data by a copy without the superseded
+/// "line" events, the calls left without arguments are left out too.
+static void drop_superseded(ui_data_st *data)
+{
+    msgpack_sbuffer *out = &data->spare;
+    const char *in = data->sbuf.data;
+    size_t ncalls = 0;
+    size_t l = 0;
+
+    msgpack_sbuffer_clear(out);
+    (void)msgpack_sbuffer_write(out, in, data->calls_pos + 5);
+
+    for(size_t i = 0; i < kv_size(data->calls); i++)
+    {
+        callrec_st *call = &kv_A(data->calls, i);
+        bool live = call->nargs > call->nsuperseded;
+        size_t call_pos = out->size;
+        size_t from = call->pos;
+        size_t to = i + 1 < kv_size(data->calls)
+                    ? kv_A(data->calls, i + 1).pos : data->sbuf.size;
+
+        for(; l < kv_size(data->lines) && kv_A(data->lines, l).call == i; l++)
         {
-            ADD(my_args, copy_object(args.items[i]));
+            linerec_st *line = &kv_A(data->lines, l);
+
+            if(line->superseded)
+            {
+                if(live)
+                {
+                    (void)msgpack_sbuffer_write(out, in + from,
+                                                line->start - from);
+                }
+
+                from = line->stop;
+            }
+        }
+
+        if(live)
+        {
+            (void)msgpack_sbuffer_write(out, in + from, to - from);
+            put_u32(out->data + call_pos, call->nargs - call->nsuperseded + 1);
+            ncalls++;
         }
     }
-    else
+
+    put_u32(out->data + data->calls_pos, ncalls);
+
+    msgpack_sbuffer tmp = data->sbuf;
+    data->sbuf = data->spare;
+    data->spare = tmp;
+}
+
+/// Remote UIs get the cells of the run as one "put" string, or they are
+/// added to a "line" event with "ext_lineruns", or to the grid with
+/// "ext_shmgrid".
+static void remote_ui_put_run(ui_st *ui, String cells)
+{
+    ui_data_st *data = ui->data;
+    size_t i = 0;
+
+    while(i < cells.size)
     {
-        my_args = args;
-        *args_consumed = true;
+        size_t len = strlen(cells.data + i);
+        String cell = { .data = cells.data + i, .size = len };
+
+        if(data->shm)
+        {
+            remote_ui_shm_put(ui, cell);
+        }
+        else if(data->line_runs)
+        {
+            line_runs_put(ui, cell);
+        }
+        else
+        {
+            remote_ui_put(ui, cell);
+        }
+
+        i += len + 1;
     }
+}
 
-    push_call(ui, name, my_args);
+/// Events only remote UIs get, their arguments are packed as they are.
+static void remote_ui_event(ui_st *ui,
+                            char *name,
+                            Array args,
+                            bool *FUNC_ARGS_UNUSED_MATCH(args_consumed))
+{
+    msgpack_packer *pac = push_call(ui, name, args.size);
+
+    for(size_t i = 0; i < args.size; i++)
+    {
+        rpc_from_object(args.items[i], pac);
+    }
 }
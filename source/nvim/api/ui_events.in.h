@@ -55,7 +55,14 @@ FUNC_API_REMOTE_IMPL
 FUNC_API_BRIDGE_IMPL;
 
 void put(String str)
-FUNC_API_SINCE(3);
+FUNC_API_SINCE(3)
+FUNC_API_REMOTE_IMPL;
+
+// Like put, for consecutive cells with the same attributes: each cell is
+// NUL terminated, the right halve of a double-width character is empty.
+void put_run(String cells)
+FUNC_API_SINCE(4)
+FUNC_API_REMOTE_IMPL;
 
 void bell(void)
 FUNC_API_SINCE(3);
@@ -65,7 +72,8 @@ FUNC_API_SINCE(3);
 
 void flush(void)
 FUNC_API_SINCE(3)
-FUNC_API_REMOTE_IMPL;
+FUNC_API_REMOTE_IMPL
+FUNC_API_BRIDGE_IMPL;
 
 void update_fg(Integer fg)
 FUNC_API_SINCE(3);
@@ -102,4 +110,37 @@ void tabline_update(Tabpage current, Array tabs)
 FUNC_API_SINCE(3)
 FUNC_API_REMOTE_ONLY;
 
+// With the "ext_lineruns" UI option: highlight "id" has "attrs", the keys
+// of highlight_set, for the "line" events that refer to it. Ids start at 1
+// and are defined once, before the first "line" that uses them, they stay
+// valid until the UI detaches.
+void hl_define(Integer id, Dictionary attrs)
+FUNC_API_SINCE(4)
+FUNC_API_REMOTE_ONLY;
+
+// With the "ext_lineruns" UI option, instead of cursor_goto, highlight_set
+// and put: the cells from "row", "col" on, as [text, hl_id, repeat] items,
+// each is "repeat" cells with "text" and the highlight "hl_id". A cell
+// takes one column: the right half of a double-width character is a cell
+// with an empty text, columns don't depend on the width the UI gives the
+// characters. Moves the cursor after the last cell, like the puts. Events
+// other than "line" and "hl_define" still get the cursor_goto and
+// highlight_set they need first.
+void line(Integer row, Integer col, Array cells)
+FUNC_API_SINCE(4)
+FUNC_API_REMOTE_ONLY;
+
+// With the "ext_shmgrid" UI option: the cells are in the shared memory
+// object "name" of "rows" by "cols" cells from now on, see shmgrid_defs.h.
+// An empty "name" drops it, the cells come in "redraw" again.
+void grid_shm(String name, Integer rows, Integer cols)
+FUNC_API_SINCE(4)
+FUNC_API_REMOTE_ONLY;
+
+// With the "ext_shmgrid" UI option, instead of the drawing events: frame
+// "seq" is in the front buffer, rows "top" to "bot" changed.
+void grid_flush(Integer seq, Integer top, Integer bot)
+FUNC_API_SINCE(4)
+FUNC_API_REMOTE_ONLY;
+
 #endif // NVIM_API_UI_EVENTS_IN_H
@@ -833,6 +833,8 @@ static void free_buffer_stuff(filebuf_st *buf, int free_options)
         ga_clear(&buf->b_s.b_langp);
     }
 
+    spell_cache_free(&buf->b_s);
+
     // Avoid loosing b:changedtick when deleting buffer:
     // clearing variables implies using clear_tv() on
     // b:changedtick and that sets changedtick to zero.
@@ -2878,7 +2880,7 @@ FUNC_ATTR_NONNULL_ALL
         // Save the window-specific option values.
         copy_winopt(&win->w_o_curbuf, &wip->wi_opt);
         wip->wi_fold_manual = win->w_fold_manual;
-        cloneFoldGrowArray(&win->w_folds, &wip->wi_folds);
+        cloneFoldGrowArray(foldTopFolds(win), &wip->wi_folds);
         wip->wi_optset = true;
     }
 
@@ -2977,7 +2979,7 @@ void get_winopts(filebuf_st *buf)
         copy_winopt(&wip->wi_opt, &curwin->w_o_curbuf);
         curwin->w_fold_manual = wip->wi_fold_manual;
         curwin->w_foldinvalid = true;
-        cloneFoldGrowArray(&wip->wi_folds, &curwin->w_folds);
+        cloneFoldGrowArray(&wip->wi_folds, foldTopFolds(curwin));
     }
     else
     {
@@ -6581,6 +6583,302 @@ void sign_mark_adjust(linenum_kt line1,
 }
 
 // bufhl: plugin highlights associated with a buffer
+//
+// The highlights are stored per line in a treap ordered by line number,
+// see bufhl_node_st. Finding the highlights of a line, adding a highlight
+// and shifting lines for inserted/deleted text are all O(log n), clearing
+// a range of lines is O(log n + k) for k highlighted lines in the range.
+
+/// Get a pseudo random heap priority for a new tree node.
+static uint32_t bufhl_node_prio(void)
+{
+    static uint32_t seed = 2463534242U;
+
+    // xorshift32, good enough to keep the treap balanced
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    return seed;
+}
+
+/// Apply the pending shift of a node and hand it over to its children.
+static void bufhl_node_push(bufhl_node_st *node)
+{
+    if(node->shift == 0)
+    {
+        return;
+    }
+
+    node->lnum += node->shift;
+
+    if(node->left)
+    {
+        node->left->shift += node->shift;
+    }
+
+    if(node->right)
+    {
+        node->right->shift += node->shift;
+    }
+
+    node->shift = 0;
+}
+
+/// Split a tree into the lines before @b lnum and the lines from @b lnum on.
+///
+/// @param node         The tree to split
+/// @param lnum         First line that goes into @b after
+/// @param[out] before  Lines less than @b lnum
+/// @param[out] after   Lines greater than or equal to @b lnum
+static void bufhl_tree_split(bufhl_node_st *node,
+                             linenum_kt lnum,
+                             bufhl_node_st **before,
+                             bufhl_node_st **after)
+{
+    if(node == NULL)
+    {
+        *before = NULL;
+        *after = NULL;
+        return;
+    }
+
+    bufhl_node_push(node);
+
+    if(node->lnum < lnum)
+    {
+        bufhl_tree_split(node->right, lnum, &node->right, after);
+        *before = node;
+    }
+    else
+    {
+        bufhl_tree_split(node->left, lnum, before, &node->left);
+        *after = node;
+    }
+}
+
+/// Join two trees, every line in @b before must be less than
+/// any line in @b after.
+///
+/// @return the root of the joined tree
+static bufhl_node_st *bufhl_tree_merge(bufhl_node_st *before,
+                                       bufhl_node_st *after)
+{
+    if(before == NULL)
+    {
+        return after;
+    }
+
+    if(after == NULL)
+    {
+        return before;
+    }
+
+    if(before->prio > after->prio)
+    {
+        bufhl_node_push(before);
+        before->right = bufhl_tree_merge(before->right, after);
+        return before;
+    }
+
+    bufhl_node_push(after);
+    after->left = bufhl_tree_merge(before, after->left);
+    return after;
+}
+
+/// Find the node of a given line, the tree is not modified.
+///
+/// @return the node, or NULL if the line has no highlights
+static bufhl_node_st *bufhl_tree_find(bufhl_node_st *node, linenum_kt lnum)
+{
+    linenum_kt shift = 0;
+
+    while(node != NULL)
+    {
+        shift += node->shift;
+        linenum_kt line = node->lnum + shift;
+
+        if(lnum == line)
+        {
+            return node;
+        }
+
+        node = lnum < line ? node->left : node->right;
+    }
+
+    return NULL;
+}
+
+/// Get the first (@b last is false) or last line of a non-empty tree.
+static linenum_kt bufhl_tree_edge(bufhl_node_st *node, bool last)
+{
+    linenum_kt shift = 0;
+
+    for(;;)
+    {
+        shift += node->shift;
+        bufhl_node_st *next = last ? node->right : node->left;
+
+        if(next == NULL)
+        {
+            return node->lnum + shift;
+        }
+
+        node = next;
+    }
+}
+
+/// Put a single node, which must have no children, into the tree.
+///
+/// If the line of @b node is already in the tree, its highlights are moved
+/// over to the existing node and @b node is freed.
+static void bufhl_tree_insert(bufhl_tree_st *tree,
+                              bufhl_node_st **root,
+                              bufhl_node_st *node)
+{
+    bufhl_node_st *same = bufhl_tree_find(*root, node->lnum);
+
+    if(same != NULL)
+    {
+        for(size_t i = 0; i < kv_size(node->items); i++)
+        {
+            kv_push(same->items, kv_A(node->items, i));
+        }
+
+        kv_destroy(node->items);
+        xfree(node);
+        tree->lines--;
+        return;
+    }
+
+    bufhl_node_st *before;
+    bufhl_node_st *after;
+
+    bufhl_tree_split(*root, node->lnum, &before, &after);
+    *root = bufhl_tree_merge(bufhl_tree_merge(before, node), after);
+}
+
+/// Move every node of the tree @b node into @b root, one by one.
+static void bufhl_tree_insert_all(bufhl_tree_st *tree,
+                                  bufhl_node_st **root,
+                                  bufhl_node_st *node)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+
+    bufhl_node_push(node);
+
+    bufhl_node_st *left = node->left;
+    bufhl_node_st *right = node->right;
+
+    node->left = NULL;
+    node->right = NULL;
+
+    bufhl_tree_insert_all(tree, root, left);
+    bufhl_tree_insert_all(tree, root, right);
+    bufhl_tree_insert(tree, root, node);
+}
+
+/// Join two trees whose lines may interleave.
+///
+/// When the lines do not overlap, which is the case for anything but moving
+/// lines around, this is a plain O(log n) merge.
+///
+/// @return the root of the joined tree
+static bufhl_node_st *bufhl_tree_union(bufhl_tree_st *tree,
+                                       bufhl_node_st *a,
+                                       bufhl_node_st *b)
+{
+    if(a == NULL)
+    {
+        return b;
+    }
+
+    if(b == NULL)
+    {
+        return a;
+    }
+
+    if(bufhl_tree_edge(a, true) < bufhl_tree_edge(b, false))
+    {
+        return bufhl_tree_merge(a, b);
+    }
+
+    if(bufhl_tree_edge(b, true) < bufhl_tree_edge(a, false))
+    {
+        return bufhl_tree_merge(b, a);
+    }
+
+    bufhl_tree_insert_all(tree, &a, b);
+    return a;
+}
+
+/// Free a tree and all the highlights in it.
+///
+/// @return the number of freed lines
+static size_t bufhl_tree_free(bufhl_node_st *node)
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+
+    size_t count = 1
+                   + bufhl_tree_free(node->left)
+                   + bufhl_tree_free(node->right);
+
+    kv_destroy(node->items);
+    xfree(node);
+
+    return count;
+}
+
+/// Get the highlights of a line, creating an empty list if there are none.
+static bufhl_vec_st *bufhl_tree_ref(bufhl_tree_st *tree, linenum_kt lnum)
+{
+    bufhl_node_st *node = bufhl_tree_find(tree->root, lnum);
+
+    if(node == NULL)
+    {
+        node = xcalloc(1, sizeof(bufhl_node_st));
+        node->lnum = lnum;
+        node->prio = bufhl_node_prio();
+
+        bufhl_tree_insert(tree, &tree->root, node);
+        tree->lines++;
+    }
+
+    return &node->items;
+}
+
+/// Cut the lines @b line_start to @b line_end out of the buffer highlights.
+///
+/// The tree root is set to the lines before the range, the lines after
+/// the range are returned in @b after.
+///
+/// @return the lines in the range
+static bufhl_node_st *bufhl_tree_cut(bufhl_tree_st *tree,
+                                     linenum_kt line_start,
+                                     linenum_kt line_end,
+                                     bufhl_node_st **after)
+{
+    bufhl_node_st *range;
+
+    bufhl_tree_split(tree->root, line_start, &tree->root, &range);
+
+    if(line_end < MAXLNUM)
+    {
+        bufhl_tree_split(range, line_end + 1, &range, after);
+    }
+    else
+    {
+        *after = NULL;
+    }
+
+    return range;
+}
 
 /// Adds a highlight to buffer.
 ///
@@ -6636,14 +6934,7 @@ int bufhl_add_hl(filebuf_st *buf,
         return src_id;
     }
 
-    if(!buf->b_bufhl_info)
-    {
-        buf->b_bufhl_info = map_new(linenum_kt, bufhl_vec_st)();
-    }
-
-    bufhl_vec_st *lineinfo =
-        map_ref(linenum_kt, bufhl_vec_st)(buf->b_bufhl_info, lnum, true);
-
+    bufhl_vec_st *lineinfo = bufhl_tree_ref(&buf->b_bufhl_info, lnum);
     bufhl_item_st *hlentry = kv_pushp(*lineinfo);
 
     hlentry->src_id = src_id;
@@ -6660,8 +6951,72 @@ int bufhl_add_hl(filebuf_st *buf,
     return src_id;
 }
 
+/// Adds a batch of highlights to a buffer.
+///
+/// The highlights are put in a tree of their own, which is joined with
+/// the buffer highlights in one go, and the changed lines are redrawn once
+/// for the whole batch.
+///
+/// @param buf
+/// The buffer to add highlights to
+///
+/// @param src_id
+/// src_id to use or 0 to use a new src_id group, or -1 for ungrouped highlight.
+///
+/// @param hls
+/// The highlights, items without a highlight group are skipped
+///
+/// @param count
+/// Number of items in @b hls
+///
+/// @return The src_id that was used
+int bufhl_add_hls(filebuf_st *buf,
+                  int src_id,
+                  const bufhl_add_st *hls,
+                  size_t count)
+{
+    src_id = bufhl_add_hl(buf, src_id, 0, 0, 0, 0);
+
+    bufhl_tree_st batch = { .root = NULL, .lines = 0 };
+    linenum_kt first_changed = MAXLNUM, last_changed = -1;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        linenum_kt lnum = hls[i].lnum;
+
+        if(hls[i].item.hl_id <= 0)
+        {
+            continue;
+        }
+
+        bufhl_item_st *hlentry = kv_pushp(*bufhl_tree_ref(&batch, lnum));
+        *hlentry = hls[i].item;
+        hlentry->src_id = src_id;
+
+        if(0 < lnum && lnum <= buf->b_ml.ml_line_count)
+        {
+            first_changed = MIN(first_changed, lnum);
+            last_changed = MAX(last_changed, lnum);
+        }
+    }
+
+    bufhl_tree_st *tree = &buf->b_bufhl_info;
+    tree->lines += batch.lines;
+    tree->root = bufhl_tree_union(tree, tree->root, batch.root);
+
+    if(last_changed != -1)
+    {
+        changed_lines_buf(buf, first_changed, last_changed+1, 0);
+        redraw_buf_later(buf, VALID);
+    }
+
+    return src_id;
+}
+
 /// Clear bufhl highlights from a given source group and range of lines.
 ///
+/// Only the highlighted lines in the range are visited.
+///
 /// @param buf
 /// The buffer to remove highlights from
 ///
@@ -6678,38 +7033,32 @@ void bufhl_clear_line_range(filebuf_st *buf,
                             linenum_kt line_start,
                             linenum_kt line_end)
 {
-    if(!buf->b_bufhl_info)
+    bufhl_tree_st *tree = &buf->b_bufhl_info;
+
+    if(tree->root == NULL || line_start > line_end)
     {
         return;
     }
 
-    linenum_kt line;
     linenum_kt first_changed = MAXLNUM, last_changed = -1;
 
-    // In the case line_start - line_end << bufhl_info->size
-    // it might be better to reverse this, i e loop over the lines
-    // to clear on.
-    bufhl_vec_st unused;
-
-    map_foreach(buf->b_bufhl_info, line, unused, {
-        (void)unused;
+    bufhl_node_st *after;
+    bufhl_node_st *range = bufhl_tree_cut(tree, line_start, line_end, &after);
 
-        if(line_start <= line && line <= line_end)
-        {
-            if(bufhl_clear_line(buf->b_bufhl_info, src_id, line))
-            {
-                if(line > last_changed)
-                {
-                    last_changed = line;
-                }
+    if(range != NULL && src_id < 0)
+    {
+        first_changed = bufhl_tree_edge(range, false);
+        last_changed = bufhl_tree_edge(range, true);
+        tree->lines -= bufhl_tree_free(range);
+        range = NULL;
+    }
+    else
+    {
+        range = bufhl_clear_tree(tree, range, src_id,
+                                 &first_changed, &last_changed);
+    }
 
-                if(line < first_changed)
-                {
-                    first_changed = line;
-                }
-            }
-        }
-    })
+    tree->root = bufhl_tree_merge(bufhl_tree_merge(tree->root, range), after);
 
     if(last_changed != -1)
     {
@@ -6718,23 +7067,81 @@ void bufhl_clear_line_range(filebuf_st *buf,
     }
 }
 
-/// Clear bufhl highlights from a given source group and given line
+/// Clear bufhl highlights from a given source group in a tree of lines
 ///
-/// @param bufhl_info
+/// @param tree
 /// The highlight info for the buffer
 ///
+/// @param node
+/// The lines to clear, lines without highlights left are removed
+///
 /// @param src_id
 /// Highlight source group to clear, or -1 to clear all groups.
 ///
-/// @param lnum
-/// Linenr where the highlight should be cleared
-static bool bufhl_clear_line(bufhl_info_st *bufhl_info,
-                             int src_id,
-                             linenum_kt lnum)
+/// @param[in,out] first_changed
+/// @param[in,out] last_changed
+/// The range of changed lines, extended for the cleared lines
+///
+/// @return the root of the remaining tree
+static bufhl_node_st *bufhl_clear_tree(bufhl_tree_st *tree,
+                                       bufhl_node_st *node,
+                                       int src_id,
+                                       linenum_kt *first_changed,
+                                       linenum_kt *last_changed)
 {
-    bufhl_vec_st *lineinfo =
-        map_ref(linenum_kt, bufhl_vec_st)(bufhl_info, lnum, false);
+    if(node == NULL)
+    {
+        return NULL;
+    }
+
+    bufhl_node_push(node);
+
+    node->left = bufhl_clear_tree(tree, node->left, src_id,
+                                  first_changed, last_changed);
+
+    node->right = bufhl_clear_tree(tree, node->right, src_id,
+                                   first_changed, last_changed);
+
+    if(!bufhl_clear_line(&node->items, src_id))
+    {
+        return node;
+    }
+
+    if(node->lnum > *last_changed)
+    {
+        *last_changed = node->lnum;
+    }
+
+    if(node->lnum < *first_changed)
+    {
+        *first_changed = node->lnum;
+    }
+
+    if(kv_size(node->items) > 0)
+    {
+        return node;
+    }
+
+    bufhl_node_st *rest = bufhl_tree_merge(node->left, node->right);
+
+    kv_destroy(node->items);
+    xfree(node);
+    tree->lines--;
+
+    return rest;
+}
 
+/// Clear bufhl highlights from a given source group and given line
+///
+/// @param lineinfo
+/// The highlights of the line
+///
+/// @param src_id
+/// Highlight source group to clear, or -1 to clear all groups.
+///
+/// @return true if any highlight was removed
+static bool bufhl_clear_line(bufhl_vec_st *lineinfo, int src_id)
+{
     size_t oldsize = kv_size(*lineinfo);
 
     if(src_id < 0)
@@ -6761,67 +7168,66 @@ static bool bufhl_clear_line(bufhl_info_st *bufhl_info,
         kv_size(*lineinfo) = newind;
     }
 
-    if(kv_size(*lineinfo) == 0)
-    {
-        kv_destroy(*lineinfo);
-        map_del(linenum_kt, bufhl_vec_st)(bufhl_info, lnum);
-    }
-
     return kv_size(*lineinfo) != oldsize;
 }
 
 /// Remove all highlights and free the highlight data
 void bufhl_clear_all(filebuf_st *buf)
 {
-    if(!buf->b_bufhl_info)
+    if(!buf->b_bufhl_info.root)
     {
         return;
     }
 
     bufhl_clear_line_range(buf, -1, 1, MAXLNUM);
-    map_free(linenum_kt, bufhl_vec_st)(buf->b_bufhl_info);
-    buf->b_bufhl_info = NULL;
+
+    // lines outside of the buffer are not redrawn, just drop them
+    bufhl_tree_free(buf->b_bufhl_info.root);
+    buf->b_bufhl_info.root = NULL;
+    buf->b_bufhl_info.lines = 0;
 }
 
 /// Adjust a placed highlight for inserted/deleted lines.
+///
+/// Shifting lines only updates the pending shift of the subtree root, so
+/// this does not depend on the number of highlighted lines.
 void bufhl_mark_adjust(filebuf_st *buf,
                        linenum_kt line1,
                        linenum_kt line2,
                        long amount,
                        long amount_after)
 {
-    if(!buf->b_bufhl_info)
+    bufhl_tree_st *tree = &buf->b_bufhl_info;
+
+    if(tree->root == NULL || line1 > line2)
     {
         return;
     }
 
-    bufhl_info_st *newmap = map_new(linenum_kt, bufhl_vec_st)();
-    linenum_kt line;
-    bufhl_vec_st lineinfo;
+    bufhl_node_st *after;
+    bufhl_node_st *range = bufhl_tree_cut(tree, line1, line2, &after);
 
-    map_foreach(buf->b_bufhl_info, line, lineinfo, {
-        if(line >= line1 && line <= line2)
+    if(range != NULL)
+    {
+        if(amount == MAXLNUM)
         {
-            if(amount == MAXLNUM)
-            {
-                bufhl_clear_line(buf->b_bufhl_info, -1, line);
-                continue;
-            }
-            else
-            {
-                line += amount;
-            }
+            tree->lines -= bufhl_tree_free(range);
+            range = NULL;
         }
-        else if(line > line2)
+        else
         {
-            line += amount_after;
+            range->shift += (linenum_kt)amount;
         }
+    }
 
-        map_put(linenum_kt, bufhl_vec_st)(newmap, line, lineinfo);
-    });
+    if(after != NULL)
+    {
+        after->shift += (linenum_kt)amount_after;
+    }
 
-    map_free(linenum_kt, bufhl_vec_st)(buf->b_bufhl_info);
-    buf->b_bufhl_info = newmap;
+    // moved lines may end up in between other lines
+    tree->root = bufhl_tree_union(tree, tree->root, after);
+    tree->root = bufhl_tree_union(tree, tree->root, range);
 }
 
 
@@ -6834,13 +7240,15 @@ void bufhl_mark_adjust(filebuf_st *buf,
 /// @return true if there was highlights to display
 bool bufhl_start_line(filebuf_st *buf, linenum_kt lnum, bufhl_lineinfo_st *info)
 {
-    if(!buf->b_bufhl_info)
+    bufhl_node_st *node = bufhl_tree_find(buf->b_bufhl_info.root, lnum);
+
+    if(node == NULL)
     {
         return false;
     }
 
     info->valid_to = -1;
-    info->entries = map_get(linenum_kt, bufhl_vec_st)(buf->b_bufhl_info, lnum);
+    info->entries = node->items;
     return kv_size(info->entries) > 0;
 }
 
@@ -9,6 +9,10 @@
 
 typedef struct filebuf_s filebuf_st; // for undo_defs.h
 typedef struct window_s  win_st; // for regexp_defs.h
+typedef struct spellcache_s spellcache_st; // defined in spell.c
+typedef struct linecache_s linecache_st; // defined in screen.c
+typedef struct vcolindex_s vcolindex_st; // defined in charset.c
+typedef struct plinescache_s plinescache_st; // defined in misc1.c
 
 #include "nvim/garray.h"
 #include "nvim/pos.h"
@@ -310,14 +314,13 @@ typedef struct synblk_s
     uchar_kt *b_p_spf;         ///< 'spellfile'
     uchar_kt *b_p_spl;         ///< 'spelllang'
     int b_cjk;                 ///< all CJK letters as OK
+    spellcache_st *b_spell_cache; ///< checked words per line, see spell.c
     uchar_kt b_syn_chartab[32];///< syntax iskeyword option
     uchar_kt *b_syn_isk;       ///< iskeyword option
 } synblk_st;
 
 typedef TV_DICTITEM_STRUCT(sizeof("changedtick")) changedtick_st;
 
-typedef Map(linenum_kt, bufhl_vec_st) bufhl_info_st;
-
 #define BUF_HAS_QF_ENTRY   1
 #define BUF_HAS_LL_ENTRY   2
 
@@ -620,7 +623,7 @@ struct filebuf_s
     terminal_st *terminal;      ///< instance associated with the buffer
     dict_st *additional_data;   ///< Additional data from shada file if any.
     int b_mapped_ctrl_c;        ///< modes where CTRL-C is mapped
-    bufhl_info_st *b_bufhl_info;///< buffer stored highlights
+    bufhl_tree_st b_bufhl_info; ///< buffer stored highlights
 };
 
 /// Stuff for diff mode.
@@ -887,9 +890,15 @@ struct window_s
     int w_lines_valid;   ///< number of valid entries
     lineinfo_st *w_lines;
     garray_st w_folds;   ///< array of nested folds
+    int w_fold_shift_idx; ///< first toplevel fold with a pending shift
+    long w_fold_shift;    ///< lines to add to fd_top from there on
     bool w_fold_manual;  ///< when true: some folds are opened/closed  manually
     bool w_foldinvalid;  ///< when true: folding needs to be recomputed
+    garray_st w_foldlevels; ///< cached fold levels per line, see fold.c
     int w_nrwidth;       ///< width of 'number' and 'relativenumber' column being used
+    linecache_st *w_line_cache; ///< rendered lines, see screen.c
+    vcolindex_st *w_vcol_index; ///< vcol checkpoints of a long line, see charset.c
+    plinescache_st *w_plines_cache; ///< heights of lines, see misc1.c
 
     // -----------------  end of cached values -----------------
 
@@ -3,6 +3,9 @@
 #ifndef NVIM_BUFHL_DEFS_H
 #define NVIM_BUFHL_DEFS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "nvim/pos.h"
 #include "nvim/lib/kvec.h"
 
@@ -18,6 +21,39 @@ struct bufhl_s
     columnum_kt stop;  ///< last column to highlight
 };
 
+/// A highlight to add with bufhl_add_hls()
+typedef struct bufhl_add_s
+{
+    linenum_kt lnum;    ///< line to highlight
+    bufhl_item_st item; ///< the highlight, "src_id" is set by bufhl_add_hls()
+} bufhl_add_st;
+
+typedef struct bufhl_node_s bufhl_node_st;
+
+/// One line of the buffer highlight tree.
+///
+/// The tree is a treap ordered by line number. Line numbers are not stored
+/// absolutely: a node's real line is @b lnum plus the @b shift of the node
+/// itself and of every ancestor. Shifting all highlights after an edit thus
+/// only touches the root of the split off subtree, which makes inserting or
+/// deleting lines O(log n) regardless of the number of highlighted lines.
+struct bufhl_node_s
+{
+    linenum_kt lnum;       ///< line number, before pending shifts
+    linenum_kt shift;      ///< pending shift for this node and its subtree
+    uint32_t prio;         ///< treap heap priority
+    bufhl_node_st *left;   ///< lines before this one
+    bufhl_node_st *right;  ///< lines after this one
+    bufhl_vec_st items;    ///< highlights of this line
+};
+
+/// buffer highlights, see @b bufhl_node_st
+typedef struct bufhl_tree_s
+{
+    bufhl_node_st *root;
+    size_t lines; ///< number of lines with highlights
+} bufhl_tree_st;
+
 typedef struct bufhl_lineinfo_s
 {
     bufhl_vec_st entries;
@@ -27,6 +27,7 @@
 #include "nvim/state.h"
 #include "nvim/strings.h"
 #include "nvim/path.h"
+#include "nvim/screen.h"
 #include "nvim/utils.h"
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
@@ -59,6 +60,34 @@ enum CharTableVarFlags
     kCT_CharFName= 0x40,
 };
 
+/// Virtual column checkpoints of one long line in a window, so that walks
+/// over the line (getvcol(), coladvance(), drawing with 'nowrap') can start
+/// near their target instead of at the start of the line.
+///
+/// Checkpoint k is the first character that starts at or after byte
+/// k * VCOL_INDEX_STEP, they are recorded as a walk passes them. What the
+/// columns depend on is kept as the key, any mismatch drops the index.
+struct vcolindex_s
+{
+    linenum_kt lnum;        ///< line number
+    uchar_kt *line;         ///< text of the line when indexed
+    handle_kt buf_id;       ///< buffer number
+    number_kt changedtick;  ///< b:changedtick of the buffer
+    unsigned epoch;         ///< screen_decor_get() when indexed
+    long ts;                ///< 'tabstop'
+    uchar_kt *sbr;          ///< 'showbreak'
+    int lcs_tab;            ///< first char of "tab:" in 'listchars'
+    int width;              ///< window width
+    bool list;              ///< 'list'
+    bool lbr;               ///< 'linebreak'
+    bool bri;               ///< 'breakindent'
+    bool wrap;              ///< 'wrap'
+    int count;              ///< number of checkpoints
+    int size;               ///< allocated size of col[] and vcol[]
+    columnum_kt *col;       ///< byte offset of checkpoints 1 .. count
+    columnum_kt *vcol;      ///< virtual column of checkpoints 1 .. count
+};
+
 /// Table used below, see init_chartab() for an explanation
 static uchar_kt g_chartab[256];
 static bool chartab_initialized = false;
@@ -1240,6 +1269,141 @@ FUNC_ATTR_WARN_UNUSED_RESULT
     return (vcol - width1) % width2 == width2 - 1;
 }
 
+/// Check that the virtual column index @b vi is for line @b lnum with text
+/// @b line in window @b wp, as it is now.
+static bool vcol_index_valid(win_st *wp,
+                             vcolindex_st *vi,
+                             linenum_kt lnum,
+                             uchar_kt *line)
+{
+    return vi->lnum == lnum
+           && vi->line == line
+           && vi->buf_id == wp->w_buffer->b_id
+           && vi->changedtick == wp->w_buffer->b_changedtick
+           && vi->epoch == screen_decor_get()
+           && vi->ts == wp->w_buffer->b_p_ts
+           && vi->sbr == p_sbr
+           && vi->lcs_tab == lcs_tab1
+           && vi->width == wp->w_width
+           && vi->list == wp->w_o_curbuf.wo_list
+           && vi->lbr == wp->w_o_curbuf.wo_lbr
+           && vi->bri == wp->w_o_curbuf.wo_bri
+           && vi->wrap == wp->w_o_curbuf.wo_wrap;
+}
+
+/// Use the virtual column index of window @b wp in a walk over line
+/// @b lnum with text @b line, which is at @b *ptrp and virtual column
+/// @b *vcolp. The walk calls this when it gets to the byte offset returned
+/// by the previous call, VCOL_INDEX_STEP at first, so that short lines
+/// never get here.
+///
+/// Records the position when it is a new checkpoint, then moves @b *ptrp
+/// and @b *vcolp ahead to the last checkpoint that is not after byte
+/// @b maxcol and virtual column @b maxvcol. Never moves to the NUL, so
+/// that the walk always handles at least one more character.
+///
+/// @return the byte offset at which to call this again.
+columnum_kt vcol_index_walk(win_st *wp,
+                            linenum_kt lnum,
+                            uchar_kt *line,
+                            uchar_kt **ptrp,
+                            columnum_kt *vcolp,
+                            columnum_kt maxcol,
+                            columnum_kt maxvcol)
+{
+    vcolindex_st *vi = wp->w_vcol_index;
+    columnum_kt off = (columnum_kt)(*ptrp - line);
+
+    if(vi == NULL)
+    {
+        vi = wp->w_vcol_index = xcalloc(1, sizeof(vcolindex_st));
+    }
+
+    if(!vcol_index_valid(wp, vi, lnum, line))
+    {
+        vi->lnum = lnum;
+        vi->line = line;
+        vi->buf_id = wp->w_buffer->b_id;
+        vi->changedtick = wp->w_buffer->b_changedtick;
+        vi->epoch = screen_decor_get();
+        vi->ts = wp->w_buffer->b_p_ts;
+        vi->sbr = p_sbr;
+        vi->lcs_tab = lcs_tab1;
+        vi->width = wp->w_width;
+        vi->list = wp->w_o_curbuf.wo_list;
+        vi->lbr = wp->w_o_curbuf.wo_lbr;
+        vi->bri = wp->w_o_curbuf.wo_bri;
+        vi->wrap = wp->w_o_curbuf.wo_wrap;
+        vi->count = 0;
+    }
+
+    // Only a walk that is at the last checkpoint is asked to come back
+    // at the next one, thus this is the first character after it.
+    if(off >= (columnum_kt)(vi->count + 1) * VCOL_INDEX_STEP)
+    {
+        if(vi->count == vi->size)
+        {
+            vi->size = vi->size == 0 ? 64 : vi->size * 2;
+            vi->col = xrealloc(vi->col, (size_t)vi->size * sizeof(columnum_kt));
+            vi->vcol = xrealloc(vi->vcol, (size_t)vi->size * sizeof(columnum_kt));
+        }
+
+        vi->col[vi->count] = off;
+        vi->vcol[vi->count] = *vcolp;
+        vi->count++;
+    }
+
+    // Both columns increase with the checkpoints: binary search for the
+    // last one within the limits.
+    int lo = 0;
+    int hi = vi->count;
+
+    while(lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if(vi->col[mid] <= maxcol
+           && vi->vcol[mid] <= maxvcol
+           && line[vi->col[mid]] != NUL)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if(lo > 0 && vi->col[lo - 1] > off)
+    {
+        off = vi->col[lo - 1];
+        *ptrp = line + off;
+        *vcolp = vi->vcol[lo - 1];
+    }
+
+    if(vi->count > 0 && off >= vi->col[vi->count - 1])
+    {
+        return (columnum_kt)(vi->count + 1) * VCOL_INDEX_STEP;
+    }
+
+    // Before the last checkpoint the walk stops before the next one.
+    return MAXCOL;
+}
+
+/// Free the virtual column index of window @b wp.
+void vcol_index_free(win_st *wp)
+{
+    if(wp->w_vcol_index == NULL)
+    {
+        return;
+    }
+
+    xfree(wp->w_vcol_index->col);
+    xfree(wp->w_vcol_index->vcol);
+    xfree(wp->w_vcol_index);
+    wp->w_vcol_index = NULL;
+}
+
 /// Get virtual column number of pos.
 /// - start: on the first position of this character (TAB, ctrl)
 /// - cursor: where the cursor is on this character (first char, except for TAB)
@@ -1266,6 +1430,8 @@ void getvcol(win_st *wp,
     int head;
     int ts = (int)wp->w_buffer->b_p_ts;
     int c;
+    columnum_kt maxcol = MAXCOL; // last byte for the vcol index
+    columnum_kt next_cp = VCOL_INDEX_STEP; // next offset for the vcol index
     vcol = 0;
     line = ptr = ml_get_buf(wp->w_buffer, pos->lnum, false);
 
@@ -1285,6 +1451,7 @@ void getvcol(win_st *wp,
 
         posptr = ptr + pos->col;
         posptr -= utf_head_off(line, posptr);
+        maxcol = (columnum_kt)(posptr - line);
     }
 
     // This function is used very often, do some speed optimizations.
@@ -1348,6 +1515,12 @@ void getvcol(win_st *wp,
 
             vcol += incr;
             mb_ptr_adv(ptr);
+
+            if(ptr - line >= next_cp)
+            {
+                next_cp = vcol_index_walk(wp, pos->lnum, line, &ptr, &vcol,
+                                          maxcol, MAXCOL);
+            }
         }
     }
     else
@@ -1374,6 +1547,12 @@ void getvcol(win_st *wp,
 
             vcol += incr;
             mb_ptr_adv(ptr);
+
+            if(ptr - line >= next_cp)
+            {
+                next_cp = vcol_index_walk(wp, pos->lnum, line, &ptr, &vcol,
+                                          maxcol, MAXCOL);
+            }
         }
     }
 
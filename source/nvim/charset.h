@@ -15,6 +15,10 @@
 #define CH_FOLD(c) \
     utf_fold((sizeof(c) == sizeof(char)) ?((int)(uint8_t)(c)) :((int)(c)))
 
+/// Number of bytes between two checkpoints of the virtual column index,
+/// the first byte offset at which a walk calls vcol_index_walk().
+#define VCOL_INDEX_STEP  1024
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
     #include "charset.h.generated.h"
 #endif
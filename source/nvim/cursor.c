@@ -101,6 +101,7 @@ static int coladvance2(apos_st *pos, bool addspaces, bool finetune, columnum_kt
     int csize = 0;
     int one_more;
     int head = 0;
+    columnum_kt next_cp = VCOL_INDEX_STEP;
 
     one_more = (curmod & kInsertMode)
                || restart_edit != NUL
@@ -159,6 +160,13 @@ static int coladvance2(apos_st *pos, bool addspaces, bool finetune, columnum_kt
             csize = win_lbr_chartabsize(curwin, line, ptr, col, &head);
             mb_ptr_adv(ptr);
             col += csize;
+
+            if(ptr - line >= next_cp)
+            {
+                // Skip ahead in a long line, see vcol_index_walk().
+                next_cp = vcol_index_walk(curwin, pos->lnum, line, &ptr, &col,
+                                          MAXCOL, wcol);
+            }
         }
 
         idx = (int)(ptr - line);
@@ -1058,7 +1058,7 @@ int do_move(linenum_kt line1, linenum_kt line2, linenum_kt dest)
         {
             if(win->w_buffer == curbuf)
             {
-                foldMoveRange(&win->w_folds, line1, line2, dest);
+                foldMoveRange(foldTopFolds(win), line1, line2, dest);
             }
         }
 
@@ -1073,7 +1073,7 @@ int do_move(linenum_kt line1, linenum_kt line2, linenum_kt dest)
         {
             if(win->w_buffer == curbuf)
             {
-                foldMoveRange(&win->w_folds, dest + 1, line1 - 1, line2);
+                foldMoveRange(foldTopFolds(win), dest + 1, line1 - 1, line2);
             }
         }
 
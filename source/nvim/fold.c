@@ -2,6 +2,7 @@
 ///
 /// code for folding
 
+#include <limits.h>
 #include <string.h>
 #include <inttypes.h>
 
@@ -74,9 +75,31 @@ typedef struct fold_line_s
                   ///< this line (copy of "end" of prev. line)
 } fold_line_st;
 
+/// Cached result of the level getter for one line, used for the "indent"
+/// and "expr" methods. @b win_st::w_foldlevels holds one for each line of the
+/// buffer, starting at line 1, so that updating the folds after a change
+/// only evaluates 'foldexpr' for the changed lines.
+typedef struct foldlevel_cache_s
+{
+    int lvl;    ///< level, or the number of a 'foldexpr' result
+    char type;  ///< 'foldexpr' result type: 'a', 's', '>', '<', '=' or NUL
+    bool valid; ///< when false: not cached
+    bool check; ///< evaluate again, when the result differs the next line
+                ///< is checked too
+} foldlevel_cache_st;
+
+/// Lines above and below a change for which the cached levels are dropped
+/// too, 'foldexpr' often looks at the neighbouring lines. The lines below
+/// are checked one by one until a result agrees with the cached one.
+#define FOLDLEVEL_CONTEXT    2
+
 /// Flag is set when redrawing is needed.
 static int fold_changed;
 
+/// Set when fold information is requested while the folds are updated, used
+/// to detect a 'foldexpr' that depends on the fold levels of other lines.
+static bool fold_info_queried = false;
+
 // Function used by foldUpdateIEMSRecurse
 typedef void (*level_getter_ft)(fold_line_st *);
 
@@ -112,7 +135,7 @@ void copyFoldingState(win_st *wp_from, win_st *wp_to)
 {
     wp_to->w_fold_manual = wp_from->w_fold_manual;
     wp_to->w_foldinvalid = wp_from->w_foldinvalid;
-    cloneFoldGrowArray(&wp_from->w_folds, &wp_to->w_folds);
+    cloneFoldGrowArray(foldTopFolds(wp_from), foldTopFolds(wp_to));
 }
 
 /// Return TRUE if there may be folded lines in the current window.
@@ -160,6 +183,11 @@ bool hasFoldingWin(win_st *win,
     int low_level = 0;
     checkupdate(win);
 
+    if(invalid_top != (linenum_kt)0)
+    {
+        fold_info_queried = true;
+    }
+
     // Return quickly when there is no folding at all in this window.
     if(!hasAnyFolding(win))
     {
@@ -192,7 +220,8 @@ bool hasFoldingWin(win_st *win,
 
         for(;;)
         {
-            if(!foldFind(gap, lnum_rel, &fp))
+            if(!(gap == &win->w_folds ? foldFindWin(win, lnum_rel, &fp)
+                                      : foldFind(gap, lnum_rel, &fp)))
             {
                 break;
             }
@@ -275,13 +304,18 @@ int foldLevel(linenum_kt lnum)
     {
         checkupdate(curwin);
     }
-    else if(lnum == prev_lnum && prev_lnum_lvl >= 0)
-    {
-        return prev_lnum_lvl;
-    }
-    else if(lnum >= invalid_top && lnum <= invalid_bot)
+    else
     {
-        return -1;
+        fold_info_queried = true;
+
+        if(lnum == prev_lnum && prev_lnum_lvl >= 0)
+        {
+            return prev_lnum_lvl;
+        }
+        else if(lnum >= invalid_top && lnum <= invalid_bot)
+        {
+            return -1;
+        }
     }
 
     // Return quickly when there is no folding at all in this window.
@@ -481,7 +515,7 @@ static void newFoldLevelWin(win_st *wp)
         // Set all flags for the first level of folds to FD_LEVEL. Following
         // manual open/close will then change the flags to FD_OPEN or
         // FD_CLOSED for those folds that don't use 'foldlevel'.
-        fp = (fold_st *)wp->w_folds.ga_data;
+        fp = (fold_st *)foldTopFolds(wp)->ga_data;
 
         for(int i = 0; i < wp->w_folds.ga_len; ++i)
         {
@@ -501,7 +535,7 @@ void foldCheckClose(void)
     {
         checkupdate(curwin);
 
-        if(checkCloseRec(&curwin->w_folds,
+        if(checkCloseRec(foldTopFolds(curwin),
                          curwin->w_cursor.lnum,
                          (int)curwin->w_o_curbuf.wo_fdl))
         {
@@ -595,7 +629,7 @@ void foldCreate(linenum_kt start, linenum_kt end)
 
     checkupdate(curwin);
     // Find the place to insert the new fold.
-    gap = &curwin->w_folds;
+    gap = foldTopFolds(curwin);
 
     for(;;)
     {
@@ -747,7 +781,7 @@ void deleteFold(linenum_kt start,
     while(lnum <= end)
     {
         // Find the deepest fold for "start".
-        gap = &curwin->w_folds;
+        gap = foldTopFolds(curwin);
         found_ga = NULL;
         lnum_off = 0;
         use_level = FALSE;
@@ -845,7 +879,8 @@ void deleteFold(linenum_kt start,
 /// Remove all folding for window "win".
 void clearFolding(win_st *win)
 {
-    deleteFoldRecurse(&win->w_folds);
+    deleteFoldRecurse(foldTopFolds(win));
+    ga_clear(&win->w_foldlevels);
     win->w_foldinvalid = false;
 }
 
@@ -855,6 +890,9 @@ void clearFolding(win_st *win)
 /// The changes in lines from top to bot (inclusive).
 void foldUpdate(win_st *wp, linenum_kt top, linenum_kt bot)
 {
+    // Always done, also when the folds are updated later.
+    foldlevelCacheInvalidate(wp, top, bot);
+
     if(compl_busy || curmod & kInsertMode)
     {
         return;
@@ -862,13 +900,20 @@ void foldUpdate(win_st *wp, linenum_kt top, linenum_kt bot)
 
     // Mark all folds from top to bot as maybe-small.
     fold_st *fp;
-    (void)foldFind(&wp->w_folds, top, &fp);
+    (void)foldFindWin(wp, top, &fp);
 
-    while(fp < (fold_st *)wp->w_folds.ga_data + wp->w_folds.ga_len
-          && fp->fd_top < bot)
+    for(int i = (int)(fp - (fold_st *)wp->w_folds.ga_data);
+        i < wp->w_folds.ga_len;
+        ++i, ++fp)
     {
+        foldSettleTo(wp, i);
+
+        if(fp->fd_top >= bot)
+        {
+            break;
+        }
+
         fp->fd_small = MAYBE;
-        ++fp;
     }
 
     if(foldmethodIsIndent(wp)
@@ -939,7 +984,7 @@ int foldMoveTo(int updown, int dir, long count)
         // Find nested folds.  Stop when a fold is closed. The deepest fold
         // that moves the cursor is used.
         lnum_off = 0;
-        gap = &curwin->w_folds;
+        gap = foldTopFolds(curwin);
         use_level = FALSE;
         maybe_small = FALSE;
         lnum_found = curwin->w_cursor.lnum;
@@ -1083,6 +1128,9 @@ int foldMoveTo(int updown, int dir, long count)
 void foldInitWin(win_st *new_win)
 {
     ga_init(&new_win->w_folds, (int)sizeof(fold_st), 10);
+    new_win->w_fold_shift_idx = 0;
+    new_win->w_fold_shift = 0;
+    ga_init(&new_win->w_foldlevels, (int)sizeof(foldlevel_cache_st), 100);
 }
 
 /// Find an entry in the win->w_lines[] array for buffer line "lnum".
@@ -1229,6 +1277,117 @@ static int foldFind(garray_st *gap, linenum_kt lnum, fold_st **fpp)
     return FALSE;
 }
 
+/// Like foldFind() for the toplevel folds of window "wp", taking the shift
+/// that foldMarkAdjust() left pending into account.  The folds up to the
+/// one returned in *fpp get their shift applied.
+static int foldFindWin(win_st *wp, linenum_kt lnum, fold_st **fpp)
+{
+    fold_st *fp = (fold_st *)wp->w_folds.ga_data;
+    int low = 0;
+    int high = wp->w_folds.ga_len - 1;
+    int found = FALSE;
+
+    while(low <= high)
+    {
+        int i = (low + high) / 2;
+        linenum_kt top = fp[i].fd_top;
+
+        if(i >= wp->w_fold_shift_idx)
+        {
+            top += wp->w_fold_shift;
+        }
+
+        if(top > lnum)
+        {
+            high = i - 1;
+        }
+        else if(top + fp[i].fd_len <= lnum)
+        {
+            low = i + 1;
+        }
+        else
+        {
+            low = i;
+            found = TRUE;
+            break;
+        }
+    }
+
+    foldSettleTo(wp, low);
+    *fpp = fp + low;
+    return found;
+}
+
+/// Apply the pending shift of the toplevel folds of window "wp" to the
+/// folds up to and including index "idx".
+static void foldSettleTo(win_st *wp, int idx)
+{
+    fold_st *fp = (fold_st *)wp->w_folds.ga_data;
+    int end = MIN(idx + 1, wp->w_folds.ga_len);
+
+    if(wp->w_fold_shift == 0)
+    {
+        return;
+    }
+
+    for(; wp->w_fold_shift_idx < end; ++wp->w_fold_shift_idx)
+    {
+        fp[wp->w_fold_shift_idx].fd_top += wp->w_fold_shift;
+    }
+
+    if(wp->w_fold_shift_idx >= wp->w_folds.ga_len)
+    {
+        wp->w_fold_shift_idx = 0;
+        wp->w_fold_shift = 0;
+    }
+}
+
+/// Shift the toplevel folds of window "wp" from index "idx" on by "amount"
+/// lines.  Only the folds between "idx" and the previous pending shift are
+/// touched, the rest is done by foldSettleTo() when they are looked at.
+static void foldShiftWin(win_st *wp, int idx, long amount)
+{
+    fold_st *fp = (fold_st *)wp->w_folds.ga_data;
+
+    if(amount == 0 || idx >= wp->w_folds.ga_len)
+    {
+        return;
+    }
+
+    foldSettleTo(wp, idx - 1);
+
+    if(wp->w_fold_shift == 0)
+    {
+        wp->w_fold_shift_idx = wp->w_folds.ga_len;
+    }
+
+    // Folds between "idx" and the old start get the old shift taken away,
+    // so that the new shift can cover all folds from "idx" on.
+    for(int i = idx; i < wp->w_fold_shift_idx; ++i)
+    {
+        fp[i].fd_top -= wp->w_fold_shift;
+    }
+
+    wp->w_fold_shift_idx = idx;
+    wp->w_fold_shift += amount;
+
+    if(wp->w_fold_shift == 0)
+    {
+        wp->w_fold_shift_idx = 0;
+    }
+}
+
+/// Return the toplevel folds of window "wp" with any pending shift applied,
+/// for code that walks or changes the whole array.
+garray_st *foldTopFolds(win_st *wp)
+{
+    foldSettleTo(wp, wp->w_folds.ga_len - 1);
+    wp->w_fold_shift_idx = 0;
+    wp->w_fold_shift = 0;
+
+    return &wp->w_folds;
+}
+
 /// Return fold level at line number "lnum" in window "wp".
 static int foldLevelWin(win_st *wp, linenum_kt lnum)
 {
@@ -1242,7 +1401,8 @@ static int foldLevelWin(win_st *wp, linenum_kt lnum)
 
     for(;;)
     {
-        if(!foldFind(gap, lnum_rel, &fp))
+        if(!(gap == &wp->w_folds ? foldFindWin(wp, lnum_rel, &fp)
+                                 : foldFind(gap, lnum_rel, &fp)))
         {
             break;
         }
@@ -1362,7 +1522,7 @@ static linenum_kt setManualFoldWin(win_st *wp,
     checkupdate(wp);
 
     // Find the fold, open or close it.
-    gap = &wp->w_folds;
+    gap = foldTopFolds(wp);
 
     for(;;)
     {
@@ -1572,6 +1732,8 @@ void foldMarkAdjust(win_st *wp,
         line2 = line1 - amount_after - 1;
     }
 
+    foldlevelCacheAdjust(wp, line1, line2, amount, amount_after);
+
     // If appending a line in Insert mode, it should be included in the fold
     // just above the line.
     if((curmod & kInsertMode) && amount == (linenum_kt)1 && line2 == MAXLNUM)
@@ -1579,10 +1741,15 @@ void foldMarkAdjust(win_st *wp,
         --line1;
     }
 
-    foldMarkAdjustRecurse(&wp->w_folds, line1, line2, amount, amount_after);
+    foldMarkAdjustRecurse(wp, &wp->w_folds, line1, line2, amount, amount_after);
 }
 
-static void foldMarkAdjustRecurse(garray_st *gap,
+/// Adjust the folds in "gap" for lines "line1" to "line2" moved by "amount"
+/// and the lines after it by "amount_after".  When "wp" is not NULL "gap" is
+/// its toplevel folds, and the shift of the folds below the change is left
+/// pending, see foldShiftWin().
+static void foldMarkAdjustRecurse(win_st *wp,
+                                  garray_st *gap,
                                   linenum_kt line1,
                                   linenum_kt line2,
                                   long amount,
@@ -1604,11 +1771,23 @@ static void foldMarkAdjustRecurse(garray_st *gap,
     }
 
     // Find the fold containing or just below "line1".
-    (void)foldFind(gap, line1, &fp);
+    if(wp != NULL)
+    {
+        (void)foldFindWin(wp, line1, &fp);
+    }
+    else
+    {
+        (void)foldFind(gap, line1, &fp);
+    }
 
     // Adjust all folds below "line1" that are affected.
     for(int i = (int)(fp - (fold_st *)gap->ga_data); i < gap->ga_len; ++i, ++fp)
     {
+        if(wp != NULL)
+        {
+            foldSettleTo(wp, i);
+        }
+
         // Check for these situations:
         //    1  2  3
         //    1  2  3
@@ -1626,15 +1805,20 @@ static void foldMarkAdjustRecurse(garray_st *gap,
             continue;
         }
 
-        // 6. fold below line2: only adjust for amount_after
+        // 6. fold below line2: only adjust for amount_after,
+        //    this is true for all the following folds too.
         if(fp->fd_top > line2)
         {
-            if(amount_after == 0)
+            if(wp != NULL)
             {
-                break;
+                foldShiftWin(wp, i, amount_after);
+            }
+            else
+            {
+                foldShiftTail(gap, fp, amount_after);
             }
 
-            fp->fd_top += amount_after;
+            break;
         }
         else
         {
@@ -1645,9 +1829,30 @@ static void foldMarkAdjustRecurse(garray_st *gap,
                 {
                     // Deleting lines: delete the fold completely
                     deleteFoldEntry(gap, i, TRUE);
+
+                    if(wp != NULL && wp->w_fold_shift_idx > i)
+                    {
+                        --wp->w_fold_shift_idx;
+                    }
+
                     --i; // adjust index for deletion
                     --fp;
                 }
+                else if(line2 == MAXLNUM)
+                {
+                    // Inserting lines: the following folds
+                    // are all in the range and move too.
+                    if(wp != NULL)
+                    {
+                        foldShiftWin(wp, i, amount);
+                    }
+                    else
+                    {
+                        foldShiftTail(gap, fp, amount);
+                    }
+
+                    break;
+                }
                 else
                 {
                     fp->fd_top += amount;
@@ -1658,7 +1863,7 @@ static void foldMarkAdjustRecurse(garray_st *gap,
                 if(fp->fd_top < top)
                 {
                     // 2 or 3: need to correct nested folds too
-                    foldMarkAdjustRecurse(&fp->fd_nested,
+                    foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                           line1 - fp->fd_top,
                                           line2 - fp->fd_top,
                                           amount,
@@ -1688,7 +1893,7 @@ static void foldMarkAdjustRecurse(garray_st *gap,
                     // need to correct nested folds too
                     if(amount == MAXLNUM)
                     {
-                        foldMarkAdjustRecurse(&fp->fd_nested,
+                        foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                               line1 - fp->fd_top,
                                               line2 - fp->fd_top,
                                               amount,
@@ -1699,7 +1904,7 @@ static void foldMarkAdjustRecurse(garray_st *gap,
                     }
                     else
                     {
-                        foldMarkAdjustRecurse(&fp->fd_nested,
+                        foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                               line1 - fp->fd_top,
                                               line2 - fp->fd_top,
                                               amount,
@@ -1714,12 +1919,32 @@ static void foldMarkAdjustRecurse(garray_st *gap,
     }
 }
 
+/// Move fold "fp" and all the folds after it in "gap" by "amount" lines.
+///
+/// Nested folds are stored relative to the fold containing them, so they
+/// move along without being touched. That leaves a single pass over the
+/// folds at this level, without the checks done for folds in the range.
+static void foldShiftTail(garray_st *gap, fold_st *fp, long amount)
+{
+    if(amount == 0)
+    {
+        return;
+    }
+
+    fold_st *end = (fold_st *)gap->ga_data + gap->ga_len;
+
+    for(; fp < end; fp++)
+    {
+        fp->fd_top += amount;
+    }
+}
+
 /// Get the lowest 'foldlevel' value that makes the deepest
 /// nested fold in the current window open.
 int getDeepestNesting(void)
 {
     checkupdate(curwin);
-    return getDeepestNestingRecurse(&curwin->w_folds);
+    return getDeepestNestingRecurse(foldTopFolds(curwin));
 }
 
 static int getDeepestNestingRecurse(garray_st *gap)
@@ -2230,6 +2455,205 @@ void foldtext_cleanup(uchar_kt *str)
     }
 }
 
+// Cached fold levels. {{{1
+
+/// Get the cached level getter result for line "lnum" in window "wp".
+/// Returns NULL when there is none or it must be checked.
+static foldlevel_cache_st *foldlevelCacheGet(win_st *wp, linenum_kt lnum)
+{
+    garray_st *gap = &wp->w_foldlevels;
+
+    if(lnum < 1 || lnum > gap->ga_len)
+    {
+        return NULL;
+    }
+
+    foldlevel_cache_st *flc = (foldlevel_cache_st *)gap->ga_data + lnum - 1;
+    return flc->valid && !flc->check ? flc : NULL;
+}
+
+/// Return true when the cached level of line "lnum" in window "wp" must be
+/// checked, the levels below it may be out of date.
+static bool foldlevelCacheChecking(win_st *wp, linenum_kt lnum)
+{
+    garray_st *gap = &wp->w_foldlevels;
+
+    if(lnum < 1 || lnum > gap->ga_len)
+    {
+        return false;
+    }
+
+    return ((foldlevel_cache_st *)gap->ga_data)[lnum - 1].check;
+}
+
+/// Mark line "lnum" in window "wp" to be checked.
+static void foldlevelCacheSetCheck(win_st *wp, linenum_kt lnum)
+{
+    garray_st *gap = &wp->w_foldlevels;
+
+    if(lnum >= 1 && lnum <= gap->ga_len)
+    {
+        ((foldlevel_cache_st *)gap->ga_data)[lnum - 1].check = true;
+    }
+}
+
+/// Drop the cached level of line "lnum" in window "wp", for a result that
+/// can't be cached. A check moves on to the next line.
+static void foldlevelCacheSkip(win_st *wp, linenum_kt lnum)
+{
+    garray_st *gap = &wp->w_foldlevels;
+
+    if(lnum < 1 || lnum > gap->ga_len)
+    {
+        return;
+    }
+
+    foldlevel_cache_st *flc = (foldlevel_cache_st *)gap->ga_data + lnum - 1;
+
+    if(flc->check)
+    {
+        foldlevelCacheSetCheck(wp, lnum + 1);
+    }
+
+    flc->valid = false;
+    flc->check = false;
+}
+
+/// Store the level getter result for line "lnum" in window "wp".
+static void foldlevelCachePut(win_st *wp, linenum_kt lnum, int lvl, char type)
+{
+    garray_st *gap = &wp->w_foldlevels;
+
+    if(lnum < 1 || lnum > wp->w_buffer->b_ml.ml_line_count)
+    {
+        return;
+    }
+
+    if(lnum > gap->ga_len)
+    {
+        int extra = (int)lnum - gap->ga_len;
+        ga_grow(gap, extra);
+
+        // entries past ga_len may have been used before
+        memset((foldlevel_cache_st *)gap->ga_data + gap->ga_len,
+               0,
+               (size_t)extra * sizeof(foldlevel_cache_st));
+
+        gap->ga_len = (int)lnum;
+    }
+
+    foldlevel_cache_st *flc = (foldlevel_cache_st *)gap->ga_data + lnum - 1;
+
+    if(flc->check
+       && !(flc->valid && flc->lvl == lvl && flc->type == type))
+    {
+        // The result changed, the lines below may depend on it.
+        foldlevelCacheSetCheck(wp, lnum + 1);
+    }
+
+    flc->lvl = lvl;
+    flc->type = type;
+    flc->valid = true;
+    flc->check = false;
+}
+
+/// Drop the cached levels for changed lines "top" to "bot" in window "wp",
+/// and for FOLDLEVEL_CONTEXT lines above them. The FOLDLEVEL_CONTEXT lines
+/// below them are checked.
+static void foldlevelCacheInvalidate(win_st *wp, linenum_kt top, linenum_kt bot)
+{
+    garray_st *gap = &wp->w_foldlevels;
+    top = top > FOLDLEVEL_CONTEXT ? top - FOLDLEVEL_CONTEXT : 1;
+
+    if(top > gap->ga_len)
+    {
+        return;
+    }
+
+    if(bot >= gap->ga_len - FOLDLEVEL_CONTEXT)
+    {
+        // Drop everything below "top", no need to keep the memory.
+        gap->ga_len = (int)top - 1;
+        return;
+    }
+
+    for(linenum_kt lnum = top; lnum <= bot; lnum++)
+    {
+        ((foldlevel_cache_st *)gap->ga_data)[lnum - 1].valid = false;
+        ((foldlevel_cache_st *)gap->ga_data)[lnum - 1].check = false;
+    }
+
+    for(linenum_kt lnum = bot + 1; lnum <= bot + FOLDLEVEL_CONTEXT; lnum++)
+    {
+        foldlevelCacheSetCheck(wp, lnum);
+    }
+}
+
+/// Move the cached levels in window "wp" for inserted or deleted lines, the
+/// arguments are like for foldMarkAdjust().
+/// Only appending and deleting lines are done here, anything else drops
+/// the cache.
+static void foldlevelCacheAdjust(win_st *wp,
+                                 linenum_kt line1,
+                                 linenum_kt line2,
+                                 long amount,
+                                 long amount_after)
+{
+    garray_st *gap = &wp->w_foldlevels;
+    foldlevel_cache_st *data = gap->ga_data;
+
+    if(gap->ga_len == 0 || line1 > gap->ga_len)
+    {
+        return;
+    }
+
+    if(line2 == MAXLNUM && amount > 0 && amount_after == 0)
+    {
+        // "amount" lines inserted above "line1"
+        if(amount > INT_MAX - gap->ga_len)
+        {
+            ga_clear(gap);
+            return;
+        }
+
+        int count = (int)amount;
+        int moved = gap->ga_len - (int)line1 + 1;
+
+        ga_grow(gap, count);
+        data = gap->ga_data;
+
+        memmove(data + line1 - 1 + count,
+                data + line1 - 1,
+                (size_t)moved * sizeof(foldlevel_cache_st));
+
+        memset(data + line1 - 1, 0, (size_t)count * sizeof(foldlevel_cache_st));
+        gap->ga_len += count;
+    }
+    else if(amount == MAXLNUM && line2 >= line1
+            && line2 - line1 + 1 == -amount_after)
+    {
+        // lines "line1" to "line2" deleted
+        if(line2 >= gap->ga_len)
+        {
+            gap->ga_len = (int)line1 - 1;
+            return;
+        }
+
+        int count = (int)(line2 - line1 + 1);
+        int moved = gap->ga_len - (int)line2;
+
+        memmove(data + line1 - 1,
+                data + line2,
+                (size_t)moved * sizeof(foldlevel_cache_st));
+
+        gap->ga_len -= count;
+    }
+    else if(amount != 0 || amount_after != 0)
+    {
+        ga_clear(gap);
+    }
+}
+
 // Folding by indent, expr, marker and syntax. {{{1 */
 
 /// Update the folding for window "wp", at least from lines "top" to "bot".
@@ -2249,6 +2673,9 @@ static void foldUpdateIEMS(win_st *wp, linenum_kt top, linenum_kt bot)
         return;
     }
 
+    // Folds get inserted and removed below, do the pending shift first.
+    (void)foldTopFolds(wp);
+
     if(wp->w_foldinvalid)
     {
         // Need to update all folds.
@@ -2256,6 +2683,9 @@ static void foldUpdateIEMS(win_st *wp, linenum_kt top, linenum_kt bot)
         bot = wp->w_buffer->b_ml.ml_line_count;
         wp->w_foldinvalid = false;
 
+        // An option or the syntax changed, cached levels can't be used.
+        ga_clear(&wp->w_foldlevels);
+
         // Mark all folds a maybe-small.
         setSmallMaybe(&wp->w_folds);
     }
@@ -2428,6 +2858,15 @@ static void foldUpdateIEMS(win_st *wp, linenum_kt top, linenum_kt bot)
             break;
         }
 
+        if(fline.lnum > end
+           && (getlevel == foldlevelExpr || getlevel == foldlevelIndent)
+           && foldlevelCacheChecking(wp, fline.lnum + 1))
+        {
+            // The cached levels below differ from the new ones, continue
+            // until they agree again.
+            end = fline.lnum;
+        }
+
         if(fline.lnum > end)
         {
             // For "marker", "expr"  and "syntax"  methods: If a change caused
@@ -2713,7 +3152,7 @@ static linenum_kt foldUpdateIEMSRecurse(garray_st *gap,
                                 // We will move the start of this fold up,
                                 // hence we move all nested folds (with
                                 // relative line numbers) down.
-                                foldMarkAdjustRecurse(&fp->fd_nested,
+                                foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                                       (linenum_kt)0,
                                                       (linenum_kt)MAXLNUM,
                                                       (long)(fp->fd_top - firstlnum),
@@ -2723,7 +3162,7 @@ static linenum_kt foldUpdateIEMSRecurse(garray_st *gap,
                             {
                                 // Will move fold down, move
                                 // nested folds relatively up.
-                                foldMarkAdjustRecurse(&fp->fd_nested,
+                                foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                                       (linenum_kt)0,
                                                       (long)(firstlnum - fp->fd_top - 1),
                                                       (linenum_kt)MAXLNUM,
@@ -2814,7 +3253,7 @@ static linenum_kt foldUpdateIEMSRecurse(garray_st *gap,
                         // truncate it to stop just above startlnum.
                         fp->fd_len = startlnum - fp->fd_top;
 
-                        foldMarkAdjustRecurse(&fp->fd_nested,
+                        foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                               (linenum_kt)fp->fd_len,
                                               (linenum_kt)MAXLNUM,
                                               (linenum_kt)MAXLNUM,
@@ -3030,7 +3469,7 @@ static linenum_kt foldUpdateIEMSRecurse(garray_st *gap,
             if(fp2->fd_top < flp->lnum)
             {
                 // Make fold that includes lnum start at lnum.
-                foldMarkAdjustRecurse(&fp2->fd_nested,
+                foldMarkAdjustRecurse(NULL, &fp2->fd_nested,
                                       (linenum_kt)0,
                                       (long)(flp->lnum - fp2->fd_top - 1),
                                       (linenum_kt)MAXLNUM,
@@ -3193,7 +3632,7 @@ static void foldRemove(garray_st *gap, linenum_kt top, linenum_kt bot)
             if(fp->fd_top + fp->fd_len - 1 > bot)
             {
                 // 5: Make fold that includes bot start below bot.
-                foldMarkAdjustRecurse(&fp->fd_nested,
+                foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                                       (linenum_kt)0, (long)(bot - fp->fd_top),
                                       (linenum_kt)MAXLNUM,
                                       (long)(fp->fd_top - bot - 1));
@@ -3291,7 +3730,7 @@ void foldMoveRange(garray_st *gap,
             // Case 3 -- Remove nested folds between line1 and
             // line2 & reduce the length of fold by "range_len".
             // Folds after this one must be dealt with.
-            foldMarkAdjustRecurse(&fp->fd_nested, line1 - fp->fd_top,
+            foldMarkAdjustRecurse(NULL, &fp->fd_nested, line1 - fp->fd_top,
                                   line2 - fp->fd_top, MAXLNUM, -range_len);
 
             fp->fd_len -= range_len;
@@ -3334,7 +3773,7 @@ void foldMoveRange(garray_st *gap,
     else if(FOLD_END(fp) > dest)
     {
         // Case 7 -- remove nested folds and shrink
-        foldMarkAdjustRecurse(&fp->fd_nested,
+        foldMarkAdjustRecurse(NULL, &fp->fd_nested,
                               line2 + 1 - fp->fd_top,
                               dest - fp->fd_top,
                               MAXLNUM, -move_len);
@@ -3440,13 +3879,21 @@ static void foldMerge(fold_st *fp1, garray_st *gap, fold_st *fp2)
 }
 
 /// Low level function to get the foldlevel for the "indent" method.
-/// Doesn't use any caching.
+/// Uses the cached level when the line didn't change.
 /// Returns a level of -1 if the foldlevel depends on surrounding lines.
 static void foldlevelIndent(fold_line_st *flp)
 {
     uchar_kt *s;
     filebuf_st *buf;
     linenum_kt lnum = flp->lnum + flp->off;
+    foldlevel_cache_st *flc = foldlevelCacheGet(flp->wp, lnum);
+
+    if(flc != NULL)
+    {
+        flp->lvl = flc->lvl;
+        return;
+    }
+
     buf = flp->wp->w_buffer;
     s = skipwhite(ml_get_buf(buf, lnum, FALSE));
 
@@ -3473,6 +3920,8 @@ static void foldlevelIndent(fold_line_st *flp)
     {
         flp->lvl = (int) MAX(0, flp->wp->w_o_curbuf.wo_fdn);
     }
+
+    foldlevelCachePut(flp->wp, lnum, flp->lvl, NUL);
 }
 
 /// Low level function to get the foldlevel for the "diff" method.
@@ -3490,7 +3939,8 @@ static void foldlevelDiff(fold_line_st *flp)
 }
 
 /// Low level function to get the foldlevel for the "expr" method.
-/// Doesn't use any caching.
+/// The 'foldexpr' result is cached, it is only evaluated again for changed
+/// lines and their context, or after the folds were invalidated (e.g. "zx").
 /// Returns a level of -1 if the foldlevel depends on surrounding lines.
 static void foldlevelExpr(fold_line_st *flp)
 {
@@ -3499,10 +3949,10 @@ static void foldlevelExpr(fold_line_st *flp)
     int c;
     linenum_kt lnum = flp->lnum + flp->off;
     int save_keytyped;
+    foldlevel_cache_st *flc;
     win = curwin;
     curwin = flp->wp;
     curbuf = flp->wp->w_buffer;
-    set_vim_var_nr(VV_LNUM, (number_kt) lnum);
     flp->start = 0;
     flp->had_end = flp->end;
     flp->end = MAX_LEVEL + 1;
@@ -3512,11 +3962,35 @@ static void foldlevelExpr(fold_line_st *flp)
         flp->lvl = 0;
     }
 
-    // KeyTyped may be reset to 0 when calling a function which invokes
-    // do_cmdline(). To make 'foldopen' work correctly restore KeyTyped.
-    save_keytyped = KeyTyped;
-    n = eval_foldexpr(flp->wp->w_o_curbuf.wo_fde, &c);
-    KeyTyped = save_keytyped;
+    flc = foldlevelCacheGet(flp->wp, lnum);
+
+    if(flc != NULL)
+    {
+        n = flc->lvl;
+        c = flc->type;
+    }
+    else
+    {
+        set_vim_var_nr(VV_LNUM, (number_kt) lnum);
+
+        // KeyTyped may be reset to 0 when calling a function which invokes
+        // do_cmdline(). To make 'foldopen' work correctly restore KeyTyped.
+        save_keytyped = KeyTyped;
+        fold_info_queried = false;
+        n = eval_foldexpr(flp->wp->w_o_curbuf.wo_fde, &c);
+        KeyTyped = save_keytyped;
+
+        // When the expression used foldlevel() or the like, the result
+        // depends on the folds of other lines, can't cache it.
+        if(!fold_info_queried)
+        {
+            foldlevelCachePut(flp->wp, lnum, n, (char)c);
+        }
+        else
+        {
+            foldlevelCacheSkip(flp->wp, lnum);
+        }
+    }
 
     switch(c)
     {
@@ -3746,7 +4220,7 @@ int put_folds(FILE *fd, win_st *wp)
     if(foldmethodIsManual(wp))
     {
         if(put_line(fd, "silent! normal! zE") == FAIL
-           || put_folds_recurse(fd, &wp->w_folds, (linenum_kt)0) == FAIL)
+           || put_folds_recurse(fd, foldTopFolds(wp), (linenum_kt)0) == FAIL)
         {
             return FAIL;
         }
@@ -3755,7 +4229,7 @@ int put_folds(FILE *fd, win_st *wp)
     // If some folds are manually opened/closed, need to restore that.
     if(wp->w_fold_manual)
     {
-        return put_foldopen_recurse(fd, wp, &wp->w_folds, (linenum_kt)0);
+        return put_foldopen_recurse(fd, wp, foldTopFolds(wp), (linenum_kt)0);
     }
 
     return OK;
@@ -65,6 +65,25 @@ function write_arglist(output, ev, need_copy)
     end
 end
 
+-- pack the arguments straight into the "redraw" notification, see push_call()
+function write_packargs(output, ev)
+    local nargs = #ev.parameters
+
+    if nargs == 0 then
+        output:write('    (void)push_call(ui, "' .. ev.name .. '", 0);\n')
+        return
+    end
+
+    output:write('    msgpack_packer *pac = push_call(ui, "' .. ev.name .. '", '
+                 .. nargs .. ');\n')
+
+    for j = 1, nargs do
+        local param = ev.parameters[j]
+        output:write('    rpc_from_' .. string.lower(param[1])
+                     .. '(' .. param[2] .. ', pac);\n')
+    end
+end
+
 for i = 1, #ui_event_apis do
     ev = ui_event_apis[i]
     assert(ev.return_type == 'void')
@@ -86,55 +105,53 @@ for i = 1, #ui_event_apis do
             ui_func_remote_output:write('static void remote_ui_' .. ev.name)
             write_signature(ui_func_remote_output, ev, 'ui_st *ui') -- func args
             ui_func_remote_output:write('\n{\n')
-            write_arglist(ui_func_remote_output, ev, true)
-            ui_func_remote_output:write('    push_call(ui, "' .. ev.name .. '", args);\n')
+            write_packargs(ui_func_remote_output, ev)
             ui_func_remote_output:write('}\n\n')
         end
 
         if not ev.bridge_impl then
-            send, argv, recv, recv_argv, recv_cleanup = '', '', '', '', ''
-            argc = 1
+            -- The arguments go into an uicmd_st of the bridge ring
+            send, recv_argv, recv_cleanup = '', '', ''
+            nargs, ntext, narray = 0, 0, 0
 
             for j = 1, #ev.parameters do
                 local param = ev.parameters[j]
-                copy = 'copy_'..param[2]
 
                 if param[1] == 'String' then
-                    send = send .. '  String copy_' .. param[2] 
-                           .. ' = copy_string(' .. param[2] .. ');\n'
-                    argv = argv .. ', ' .. copy 
-                           .. '.data, INT2PTR(' .. copy .. '.size)'
-                    recv = (recv .. '  String ' .. param[2] 
-                           .. ' = (String){.data = argv[' .. argc .. '],' 
-                           .. '.size = (size_t)argv[' .. (argc+1) .. ']};\n')
-                    recv_argv = recv_argv .. ', ' .. param[2]
-                    recv_cleanup = recv_cleanup .. '  api_free_string(' 
-                                   .. param[2] .. ');\n'
-                    argc = argc+2
+                    send = send .. '    cmd->text = ui_bridge_text(ui, ' 
+                           .. param[2] .. ');\n'
+                    recv_argv = recv_argv 
+                                .. ', ui_bridge_string(bridge, cmd->text)'
+                    ntext = ntext+1
                 elseif param[1] == 'Array' then
-                    send = send .. '  Array copy_' .. param[2] 
-                           .. ' = copy_array(' .. param[2] .. ');\n'
-                    argv = argv .. ', ' .. copy .. '.items, INT2PTR(' .. copy .. '.size)'
-                    recv = (recv .. '  Array ' .. param[2] 
-                           .. ' = (Array){.items = argv[' .. argc .. '],'
-                           .. '.size = (size_t)argv[' .. (argc+1) .. ']};\n')
-                    recv_argv = recv_argv .. ', ' .. param[2]
-                    recv_cleanup = recv_cleanup .. '  api_free_array(' .. param[2] .. ');\n'
-                    argc = argc+2
+                    send = send .. '    cmd->array = copy_array(' 
+                           .. param[2] .. ');\n'
+                    recv_argv = recv_argv .. ', cmd->array'
+                    recv_cleanup = recv_cleanup 
+                                   .. '    api_free_array(cmd->array);\n'
+                    narray = narray+1
                 elseif param[1] == 'Integer' or param[1] == 'Boolean' then
-                    argv = argv .. ', INT2PTR(' .. param[2] .. ')'
-                    recv_argv = recv_argv .. ', PTR2INT(argv[' .. argc .. '])'
-                    argc = argc+1
+                    send = send .. '    cmd->data.args[' .. nargs .. '] = ' 
+                           .. param[2] .. ';\n'
+                    recv_argv = recv_argv .. ', cmd->data.args[' .. nargs .. ']'
+                    nargs = nargs+1
                 else
                     assert(false)
                 end
             end
 
+            assert(nargs <= 4 and ntext <= 1 and narray <= 1)
+
         ui_func_bridge_output:write('// nvim-api: ' .. ev.name .. '()\n')
-        ui_func_bridge_output:write('static void ui_bridge_' .. ev.name .. '_event(void **argv)\n') 
+        ui_func_bridge_output:write('static void ui_bridge_' .. ev.name 
+                                    .. '_cmd(ui_bridge_st *bridge, uicmd_st *cmd)\n') 
         ui_func_bridge_output:write('{\n') -- func body
-        ui_func_bridge_output:write('    ui_st *ui = UI_PTR(argv[0]);\n')
-        ui_func_bridge_output:write(recv)
+        ui_func_bridge_output:write('    ui_st *ui = bridge->ui;\n')
+
+        if send == '' then
+            ui_func_bridge_output:write('    (void)cmd;\n')
+        end
+
         ui_func_bridge_output:write('    ui->' .. ev.name .. '(ui' .. recv_argv .. ');\n')
         ui_func_bridge_output:write(recv_cleanup)
         ui_func_bridge_output:write('}\n')
@@ -142,11 +159,14 @@ for i = 1, #ui_event_apis do
         ui_func_bridge_output:write('static void ui_bridge_' .. ev.name)
         write_signature(ui_func_bridge_output, ev, 'ui_st *ui') -- func args
         ui_func_bridge_output:write('\n{\n') -- func body 
-        ui_func_bridge_output:write(send)
-        ui_func_bridge_output:write('    UI_CALL(ui, ')
-        ui_func_bridge_output:write(ev.name .. ', ')
-        ui_func_bridge_output:write(argc .. ', ui')
-        ui_func_bridge_output:write(argv .. ');\n')
+
+        if send == '' then
+            ui_func_bridge_output:write('    (void)UI_CALL(ui, ' .. ev.name .. ');\n')
+        else
+            ui_func_bridge_output:write('    uicmd_st *cmd = UI_CALL(ui, ' .. ev.name .. ');\n')
+            ui_func_bridge_output:write(send)
+        end
+
         ui_func_bridge_output:write('}\n\n')
         end
     end
@@ -35,6 +35,7 @@
 #include "nvim/option.h"
 #include "nvim/regexp.h"
 #include "nvim/screen.h"
+#include "nvim/spell.h"
 #include "nvim/state.h"
 #include "nvim/strings.h"
 #include "nvim/ui.h"
@@ -1474,6 +1475,8 @@ void before_blocking(void)
     {
         garbage_collect(false);
     }
+
+    spell_cache_prefetch(curwin);
 }
 
 /// updatescipt() is called when a character can be written into the script file
@@ -160,5 +160,4 @@ MAP_IMPL(cstr_kt,    ptr_kt,                 DEFAULT_INITIALIZER)
 MAP_IMPL(ptr_kt,     ptr_kt,                 DEFAULT_INITIALIZER)
 MAP_IMPL(uint64_t,   ptr_kt,                 DEFAULT_INITIALIZER)
 MAP_IMPL(handle_kt,  ptr_kt,                 DEFAULT_INITIALIZER)
-MAP_IMPL(linenum_kt, bufhl_vec_st,           DEFAULT_INITIALIZER)
 MAP_IMPL(String,     rpc_request_handler_st, DEFAULT_INITIALIZER)
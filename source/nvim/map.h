@@ -8,7 +8,6 @@
 #include "nvim/map_defs.h"
 #include "nvim/api/private/defs.h"
 #include "nvim/api/private/dispatch.h"
-#include "nvim/bufhl_defs.h"
 
 // key(T), value(U)
 #define MAP_DECLS(T, U)                                        \
@@ -24,7 +23,6 @@ MAP_DECLS(cstr_kt,    ptr_kt)
 MAP_DECLS(ptr_kt,     ptr_kt)
 MAP_DECLS(uint64_t,   ptr_kt)
 MAP_DECLS(handle_kt,  ptr_kt)
-MAP_DECLS(linenum_kt, bufhl_vec_st)
 MAP_DECLS(String,     rpc_request_handler_st)
 
 #define map_new(T, U)   map_##T##_##U##_new
@@ -41,6 +41,7 @@
 #include "nvim/regexp.h"
 #include "nvim/screen.h"
 #include "nvim/search.h"
+#include "nvim/spell.h"
 #include "nvim/state.h"
 #include "nvim/strings.h"
 #include "nvim/tag.h"
@@ -61,6 +62,43 @@
 /// All user names (for ~user completion as done by shell).
 static garray_st ga_users = GA_EMPTY_INIT_VALUE;
 
+/// Most buffer lines covered by the line height cache of a window.
+#define PLINES_CACHE_MAX   65536
+
+/// Lines covered above the line that the cache is started at.
+#define PLINES_CACHE_BACK  1024
+
+/// Window lines used by the buffer lines "first" to "first + size - 1" of
+/// a window, filled in as plines_win_nofold() computes them. Fenwick trees
+/// over the heights give the rows used by a range of lines and the line at
+/// a given row in logarithmic time.
+///
+/// What the heights depend on is kept as the key, any mismatch empties the
+/// cache, so that changes to the text, options or window size don't need
+/// to be tracked.
+struct plinescache_s
+{
+    handle_kt buf_id;       ///< buffer number
+    number_kt changedtick;  ///< b:changedtick of the buffer
+    unsigned epoch;         ///< screen_decor_get() when filled
+    long ts;                ///< 'tabstop'
+    uchar_kt *sbr;          ///< 'showbreak'
+    int lcs_eol;            ///< "eol:" in 'listchars'
+    int lcs_tab;            ///< first char of "tab:" in 'listchars'
+    int width;              ///< text width of the first window line
+    int width2;             ///< win_col_off2()
+    int height;             ///< window height, limit for rows[]
+    bool list;              ///< 'list'
+    bool lbr;               ///< 'linebreak'
+    bool bri;               ///< 'breakindent'
+    linenum_kt first;       ///< first buffer line covered
+    int size;               ///< number of lines covered, a power of two
+    int alloc;              ///< allocated size of the arrays
+    int *lines;             ///< height of each line, 0 when not known
+    int *rows;              ///< Fenwick tree of lines[] limited to "height"
+    int *known;             ///< Fenwick tree of the known lines
+};
+
 /// Add a new line below or above the current line.
 ///
 /// For @b kVReplaceMode mode, we only add a new line when we get to the end of
@@ -1566,9 +1604,303 @@ int plines_win_nofill(win_st *wp, linenum_kt lnum, int winheight)
     return lines;
 }
 
+/// Add @b delta to element @b i, counting from 1, of Fenwick tree @b tree
+/// with @b size elements.
+static void fenwick_add(int *tree, int size, int i, int delta)
+{
+    for(; i <= size; i += i & -i)
+    {
+        tree[i - 1] += delta;
+    }
+}
+
+/// Return the sum of elements 1 to @b i of Fenwick tree @b tree.
+static int fenwick_sum(const int *tree, int i)
+{
+    int sum = 0;
+
+    for(; i > 0; i -= i & -i)
+    {
+        sum += tree[i - 1];
+    }
+
+    return sum;
+}
+
+/// Return the largest @b i for which the sum of elements 1 to @b i of
+/// Fenwick tree @b tree with @b size elements, a power of two, is not more
+/// than @b limit. All elements must be positive or zero.
+static int fenwick_find(const int *tree, int size, int limit)
+{
+    int i = 0;
+
+    for(int step = size; step > 0; step /= 2)
+    {
+        if(i + step <= size && tree[i + step - 1] <= limit)
+        {
+            i += step;
+            limit -= tree[i - 1];
+        }
+    }
+
+    return i;
+}
+
+/// Return the line height cache of window @b wp, ready to hold line
+/// @b lnum. Empties it when its key is out of date and moves it when
+/// @b lnum is too far from the lines it covers.
+static plinescache_st *plines_cache_get(win_st *wp, linenum_kt lnum)
+{
+    plinescache_st *pc = wp->w_plines_cache;
+    int width = wp->w_width - win_col_off(wp);
+    int width2 = win_col_off2(wp);
+
+    if(pc == NULL)
+    {
+        pc = wp->w_plines_cache = xcalloc(1, sizeof(plinescache_st));
+    }
+
+    if(pc->buf_id != wp->w_buffer->b_id
+       || pc->changedtick != wp->w_buffer->b_changedtick
+       || pc->epoch != screen_decor_get()
+       || pc->ts != wp->w_buffer->b_p_ts
+       || pc->sbr != p_sbr
+       || pc->lcs_eol != lcs_eol
+       || pc->lcs_tab != lcs_tab1
+       || pc->width != width
+       || pc->width2 != width2
+       || pc->height != wp->w_height
+       || pc->list != wp->w_o_curbuf.wo_list
+       || pc->lbr != wp->w_o_curbuf.wo_lbr
+       || pc->bri != wp->w_o_curbuf.wo_bri
+       || lnum < pc->first
+       || lnum >= pc->first + PLINES_CACHE_MAX)
+    {
+        pc->buf_id = wp->w_buffer->b_id;
+        pc->changedtick = wp->w_buffer->b_changedtick;
+        pc->epoch = screen_decor_get();
+        pc->ts = wp->w_buffer->b_p_ts;
+        pc->sbr = p_sbr;
+        pc->lcs_eol = lcs_eol;
+        pc->lcs_tab = lcs_tab1;
+        pc->width = width;
+        pc->width2 = width2;
+        pc->height = wp->w_height;
+        pc->list = wp->w_o_curbuf.wo_list;
+        pc->lbr = wp->w_o_curbuf.wo_lbr;
+        pc->bri = wp->w_o_curbuf.wo_bri;
+        pc->first = lnum > PLINES_CACHE_BACK ? lnum - PLINES_CACHE_BACK : 1;
+        pc->size = 0;
+    }
+
+    if(lnum - pc->first >= pc->size)
+    {
+        int size = pc->size == 0 ? 2 * PLINES_CACHE_BACK : pc->size;
+
+        while(lnum - pc->first >= size)
+        {
+            size *= 2;
+        }
+
+        if(size > pc->alloc)
+        {
+            pc->alloc = size;
+            pc->lines = xrealloc(pc->lines, (size_t)size * sizeof(int));
+            pc->rows = xrealloc(pc->rows, (size_t)size * sizeof(int));
+            pc->known = xrealloc(pc->known, (size_t)size * sizeof(int));
+        }
+
+        // The new elements are zero, but the new tree nodes above the old
+        // size also cover old elements.
+        for(int i = pc->size + 1; i <= size; i++)
+        {
+            int low = i - (i & -i);
+            int top = MIN(i - 1, pc->size);
+
+            pc->lines[i - 1] = 0;
+            pc->rows[i - 1] = 0;
+            pc->known[i - 1] = 0;
+
+            if(low < top)
+            {
+                pc->rows[i - 1] = fenwick_sum(pc->rows, top)
+                                  - fenwick_sum(pc->rows, low);
+                pc->known[i - 1] = fenwick_sum(pc->known, top)
+                                   - fenwick_sum(pc->known, low);
+            }
+        }
+
+        pc->size = size;
+    }
+
+    return pc;
+}
+
+/// Free the line height cache of window @b wp.
+void plines_cache_free(win_st *wp)
+{
+    if(wp->w_plines_cache == NULL)
+    {
+        return;
+    }
+
+    xfree(wp->w_plines_cache->lines);
+    xfree(wp->w_plines_cache->rows);
+    xfree(wp->w_plines_cache->known);
+    xfree(wp->w_plines_cache);
+    wp->w_plines_cache = NULL;
+}
+
+/// Check that the rows used by lines in window @b wp are simply the sum
+/// of the line heights, without folds, filler lines or 'nowrap'.
+static bool plines_cache_usable(win_st *wp)
+{
+    return wp->w_o_curbuf.wo_wrap
+           && wp->w_width != 0
+           && !wp->w_o_curbuf.wo_diff
+           && !hasAnyFolding(wp);
+}
+
+/// Get the rows used by lines @b first to @b last in window @b wp, each
+/// limited to the window height, from the line height cache. Computes the
+/// heights that are not known yet.
+///
+/// @return false when the cache can't be used for this.
+static bool plines_cache_rows(win_st *wp,
+                              linenum_kt first,
+                              linenum_kt last,
+                              int *rowsp)
+{
+    if(first > last)
+    {
+        *rowsp = 0;
+        return true;
+    }
+
+    if(!plines_cache_usable(wp) || first < 1)
+    {
+        return false;
+    }
+
+    plinescache_st *pc = plines_cache_get(wp, first);
+
+    if(last >= pc->first + PLINES_CACHE_MAX)
+    {
+        return false;
+    }
+
+    pc = plines_cache_get(wp, last);
+
+    int lo = (int)(first - pc->first);
+    int hi = (int)(last - pc->first) + 1;
+
+    if(fenwick_sum(pc->known, hi) - fenwick_sum(pc->known, lo) < hi - lo)
+    {
+        for(linenum_kt lnum = first; lnum <= last; lnum++)
+        {
+            if(pc->lines[lnum - pc->first] == 0)
+            {
+                (void)plines_win_nofold(wp, lnum);
+            }
+        }
+    }
+
+    *rowsp = fenwick_sum(pc->rows, hi) - fenwick_sum(pc->rows, lo);
+    return true;
+}
+
+/// Find the lines from @b first on that fit in @b maxrows rows of window
+/// @b wp, using the line height cache when all the heights involved are
+/// known.
+///
+/// @param[out] lastp  the first line that doesn't fit, or the line after
+///                    the last one in the buffer.
+/// @param[out] usedp  the rows used by the lines that fit.
+///
+/// @return false when the cache can't be used for this.
+bool plines_win_fit(win_st *wp,
+                    linenum_kt first,
+                    int maxrows,
+                    linenum_kt *lastp,
+                    int *usedp)
+{
+    plinescache_st *pc = wp->w_plines_cache;
+    linenum_kt line_count = wp->w_buffer->b_ml.ml_line_count;
+
+    if(pc == NULL
+       || !plines_cache_usable(wp)
+       || first < pc->first
+       || first - pc->first >= pc->size
+       || first > line_count)
+    {
+        return false;
+    }
+
+    // Bring the key up to date before looking at the heights.
+    pc = plines_cache_get(wp, first);
+
+    int lo = (int)(first - pc->first);
+    int end = fenwick_find(pc->rows, pc->size,
+                           fenwick_sum(pc->rows, lo) + maxrows);
+    int last = MIN(end, (int)(line_count - pc->first) + 1);
+
+    // Unknown heights count as zero: the lines that fit and the line that
+    // doesn't must all be known.
+    if(last < lo
+       || fenwick_sum(pc->known, last) - fenwick_sum(pc->known, lo) < last - lo)
+    {
+        return false;
+    }
+
+    if(last == (int)(line_count - pc->first) + 1)
+    {
+        *lastp = line_count + 1;
+    }
+    else if(last < pc->size && pc->lines[last] > 0)
+    {
+        *lastp = pc->first + last;
+    }
+    else
+    {
+        return false;
+    }
+
+    *usedp = fenwick_sum(pc->rows, last) - fenwick_sum(pc->rows, lo);
+    return true;
+}
+
 /// Return number of window lines physical line "lnum" will occupy in window
 /// "wp". Does not care about folding, 'wrap' or 'diff'.
 int plines_win_nofold(win_st *wp, linenum_kt lnum)
+{
+    plinescache_st *pc = NULL;
+
+    if(lnum >= 1)
+    {
+        pc = plines_cache_get(wp, lnum);
+
+        if(pc->lines[lnum - pc->first] > 0)
+        {
+            return pc->lines[lnum - pc->first];
+        }
+    }
+
+    int lines = plines_win_nofold_calc(wp, lnum);
+
+    if(pc != NULL)
+    {
+        int i = (int)(lnum - pc->first) + 1;
+
+        pc->lines[i - 1] = lines;
+        fenwick_add(pc->rows, pc->size, i, MIN(lines, pc->height));
+        fenwick_add(pc->known, pc->size, i, 1);
+    }
+
+    return lines;
+}
+
+/// Compute plines_win_nofold() without the line height cache.
+static int plines_win_nofold_calc(win_st *wp, linenum_kt lnum)
 {
     uchar_kt *s;
     unsigned int col;
@@ -1671,6 +2003,16 @@ int plines_m_win(win_st *wp, linenum_kt first, linenum_kt last)
 {
     int count = 0;
 
+    if(plines_cache_rows(wp, first, last, &count))
+    {
+        if(first <= wp->w_topline && wp->w_topline <= last)
+        {
+            count += wp->w_topfill;
+        }
+
+        return count;
+    }
+
     while(first <= last)
     {
         // Check if there are any really folded lines,
@@ -2214,6 +2556,8 @@ void changed_bytes(linenum_kt lnum, columnum_kt col)
 
 static void changedOneline(filebuf_st *buf, linenum_kt lnum)
 {
+    spell_cache_changed(buf, lnum, lnum + 1, 0L);
+
     if(buf->b_mod_set)
     {
         // find the maximum area that must be redisplayed
@@ -2326,6 +2670,9 @@ void changed_lines(linenum_kt lnum, columnum_kt col, linenum_kt lnume, long xtra
 /// @param xtra  number of extra lines (negative when deleting)
 void changed_lines_buf(filebuf_st *buf, linenum_kt lnum, linenum_kt lnume, long xtra)
 {
+    spell_cache_changed(buf, lnum, lnume, xtra);
+    line_cache_invalidate_buf(buf, lnum, lnume);
+
     if(buf->b_mod_set)
     {
         // find the maximum area that must be redisplayed
@@ -64,6 +64,31 @@ static void comp_botline(win_st *wp)
         done = 0;
     }
 
+    // Without folds and filler lines the line heights are known to the
+    // line height cache, which finds the bottom line at once.
+    if(lnum == wp->w_topline
+       && wp->w_topfill == 0
+       && plines_win_fit(wp, lnum, wp->w_height, &lnum, &done))
+    {
+        linenum_kt cln = wp->w_cursor.lnum;
+
+        if(cln >= wp->w_topline
+           && cln <= lnum
+           && cln <= wp->w_buffer->b_ml.ml_line_count)
+        {
+            wp->w_cline_row = plines_m_win(wp, wp->w_topline, cln - 1);
+            wp->w_cline_height = plines_win(wp, cln, true);
+            wp->w_cline_folded = false;
+            redraw_for_cursorline(wp);
+            wp->w_valid |= (kWVF_CLRow | kWVF_CLHeight);
+        }
+
+        wp->w_botline = lnum;
+        wp->w_valid |= kWVF_BotLine | kWVF_BotLineAp;
+        set_empty_rows(wp, done);
+        return;
+    }
+
     for(; lnum <= wp->w_buffer->b_ml.ml_line_count; ++lnum)
     {
         int n;
@@ -500,6 +525,7 @@ void changed_window_setting(void)
 
 void changed_window_setting_win(win_st *wp)
 {
+    screen_decor_changed();
     wp->w_lines_valid = 0;
     changed_line_abv_curs_win(wp);
 
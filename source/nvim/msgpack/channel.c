@@ -246,6 +246,41 @@ bool channel_send_event(uint64_t id, const char *name, Array args)
     return true;
 }
 
+/// Sends a notification that is already packed to channel @b id, without
+/// serializing an Array of arguments first. The data of @b sbuffer is
+/// copied, the caller can reuse it.
+///
+/// @return True if the notification was sent, false otherwise.
+bool channel_send_packed(uint64_t id, msgpack_sbuffer *sbuffer)
+{
+    rpc_channel_st *channel = pmap_get(uint64_t)(channels, id);
+
+    if(!channel || channel->closed)
+    {
+        return false;
+    }
+
+    SERVER_MSG_LOG(id, sbuffer);
+
+    wbuffer_st *buffer = wstream_new_buffer(xmemdup(sbuffer->data,
+                                                    sbuffer->size),
+                                            sbuffer->size,
+                                            1,
+                                            xfree);
+
+    if(channel->pending_requests)
+    {
+        // Pending request, queue the notification for later sending.
+        kv_push(channel->delayed_notifications, buffer);
+    }
+    else
+    {
+        channel_write(channel, buffer);
+    }
+
+    return true;
+}
+
 /// Sends a method call to a channel
 ///
 /// @param id The channel id
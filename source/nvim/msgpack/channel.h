@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 #include <uv.h>
+#include <msgpack.h>
 
 #include "nvim/api/private/defs.h"
 #include "nvim/event/socket.h"
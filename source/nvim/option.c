@@ -4620,6 +4620,8 @@ static uchar_kt *compile_cap_prog(synblk_st *synblock)
     regprog_st *rp = synblock->b_cap_prog;
     uchar_kt *re;
 
+    spell_cache_flush();
+
     if(*synblock->b_p_spc == NUL)
     {
         synblock->b_cap_prog = NULL;
@@ -5825,6 +5827,7 @@ static void check_redraw(uint32_t flags)
 
     if(flags & kOptAttrRCurWinOnly)
     {
+        screen_decor_changed();
         redraw_later(NOT_VALID);
     }
 
@@ -13,6 +13,11 @@
     #include <sys/uio.h>
 #endif
 
+#ifndef HOST_OS_WINDOWS
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
 #include <uv.h>
 
 #include "nvim/os/os.h"
@@ -1205,6 +1210,122 @@ FUNC_ATTR_NONNULL_ALL
     && file_id->device_id == file_info->stat.st_dev;
 }
 
+/// Map file @b path into memory for reading. The pages are shared with
+/// other processes mapping the same file.
+///
+/// The file must not be truncated or written while it is mapped, replace
+/// it with a new file instead.
+///
+/// @param[in]  path  Path of the file.
+/// @param[out] lenp  Set to the size of the mapping.
+///
+/// @return the start of the mapping, NULL when the file is empty, can't be
+///         opened or mapping files is not supported.
+void *os_mmap_file(const char *FUNC_ARGS_UNUSED_MAYBE(path),
+                   size_t *FUNC_ARGS_UNUSED_MAYBE(lenp))
+FUNC_ATTR_NONNULL_ALL
+{
+#ifdef HOST_OS_WINDOWS
+    return NULL;
+#else
+    fileinfo_st info;
+    void *addr = NULL;
+    int fd = os_open(path, O_RDONLY, 0);
+
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    if(os_fileinfo_fd(fd, &info))
+    {
+        uint64_t size = os_fileinfo_size(&info);
+
+        if(size > 0 && size <= SIZE_MAX)
+        {
+            addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+
+            if(addr == MAP_FAILED)
+            {
+                addr = NULL;
+            }
+            else
+            {
+                *lenp = (size_t)size;
+            }
+        }
+    }
+
+    // The mapping stays valid after closing the file.
+    os_close(fd);
+
+    return addr;
+#endif
+}
+
+/// Remove a mapping made with os_mmap_file().
+void os_munmap(void *FUNC_ARGS_UNUSED_MAYBE(addr),
+               size_t FUNC_ARGS_UNUSED_MAYBE(len))
+FUNC_ATTR_NONNULL_ALL
+{
+#ifndef HOST_OS_WINDOWS
+    munmap(addr, len);
+#endif
+}
+
+/// Create the shared memory object @b name of @b size zeroed bytes and map
+/// it for reading and writing. Other processes open it by @b name until
+/// os_shm_unlink().
+///
+/// @return the start of the mapping, NULL when the object exists, can't be
+///         created or shared memory is not supported.
+void *os_shm_create(const char *FUNC_ARGS_UNUSED_MAYBE(name),
+                    size_t FUNC_ARGS_UNUSED_MAYBE(size))
+FUNC_ATTR_NONNULL_ALL
+{
+#ifdef HOST_OS_WINDOWS
+    return NULL;
+#else
+    void *addr = NULL;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    if(ftruncate(fd, (off_t)size) == 0)
+    {
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if(addr == MAP_FAILED)
+        {
+            addr = NULL;
+        }
+    }
+
+    // The mapping stays valid after closing the object.
+    os_close(fd);
+
+    if(addr == NULL)
+    {
+        shm_unlink(name);
+    }
+
+    return addr;
+#endif
+}
+
+/// Remove the name of a shared memory object made with os_shm_create(),
+/// its mappings stay valid.
+void os_shm_unlink(const char *FUNC_ARGS_UNUSED_MAYBE(name))
+FUNC_ATTR_NONNULL_ALL
+{
+#ifndef HOST_OS_WINDOWS
+    shm_unlink(name);
+#endif
+}
+
 #ifdef HOST_OS_WINDOWS
 # include <shlobj.h>
 /// When "fname" is the name of a shortcut (*.lnk) resolve the file it points
@@ -24,6 +24,7 @@
 #include "nvim/misc1.h"
 #include "nvim/state.h"
 #include "nvim/msgpack/channel.h"
+#include "nvim/api/ui.h"
 
 #define READ_BUFFER_SIZE    0xfff
 #define INPUT_BUFFER_SIZE   (READ_BUFFER_SIZE * 4)
@@ -420,6 +421,7 @@ static bool input_poll(int ms)
         // The pending input provoked a blocking wait.
         // Do special events now. #6247
         blocking = true;
+        remote_ui_flush_held();
         multiqueue_process_events(ch_before_blocking_events);
     }
 
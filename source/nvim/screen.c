@@ -139,6 +139,9 @@
 #define MB_FILLER_CHAR   '<'
 #define W_ENDCOL(wp)     (wp->w_wincol + wp->w_width)
 
+/// number of cells screen_line() compares at once
+#define SCREEN_CMP_BLOCK  64
+
 /// The attributes that are actually active for writing to the screen.
 static int screen_attr = 0;
 
@@ -154,7 +157,56 @@ static schar_T *current_ScreenLine;
 long tab_page_click_defs_size = 0;
 stl_clickdef_st *tab_page_click_defs = NULL;
 
-#define SCREEN_LINE(r, o, e, c, rl)  screen_line((r), (o), (e), (c), (rl))
+/// number of lines in the rendered line cache of a window
+#define LINE_CACHE_SIZE      128
+/// lines taking more screen rows than this are not cached
+#define LINE_CACHE_MAXROWS   4
+
+/// One buffer line as win_line() drew it, so that it can be put on the
+/// screen again without going through win_line(), see line_cache_draw().
+typedef struct
+{
+    linenum_kt lnum;        ///< line number, zero when not valid
+    handle_kt buf_id;       ///< b_id of the buffer
+    number_kt changedtick;  ///< b:changedtick when drawn
+    unsigned epoch;         ///< screen_decor_epoch when drawn
+    columnum_kt leftcol;    ///< w_leftcol when drawn
+    int width;              ///< w_width when drawn
+    int hl_attr;            ///< w_hl_attr when drawn
+    int mco;                ///< Screen_mco when drawn
+    bool hlsearch;          ///< 'hlsearch' highlighting was shown
+    int rows;               ///< number of screen rows
+    int endcol[LINE_CACHE_MAXROWS];      ///< "endcol" for screen_line()
+    int clear_width[LINE_CACHE_MAXROWS]; ///< "clear_width" for screen_line()
+    size_t cells;           ///< number of cells allocated below
+    schar_T *lines;         ///< ScreenLines[] of the rows
+    utf8char_kt *lines_uc;  ///< ScreenLinesUC[] of the rows
+    utf8char_kt *lines_c;   ///< ScreenLinesC[] of the rows, "mco" blocks
+    sattr_T *attrs;         ///< ScreenAttrs[] of the rows
+} linecache_entry_st;
+
+struct linecache_s
+{
+    linecache_entry_st entries[LINE_CACHE_SIZE]; ///< indexed by lnum
+};
+
+/// Incremented when lines may be drawn differently, see
+/// screen_decor_changed().
+static unsigned screen_decor_epoch = 0;
+
+/// The line cache entry win_line() is drawing into, or NULL.
+static linecache_entry_st *line_cache_rec = NULL;
+
+#define SCREEN_LINE(r, o, e, c, rl)            \
+    do                                         \
+    {                                          \
+        if(line_cache_rec != NULL)             \
+        {                                      \
+            line_cache_record((e), (c));       \
+        }                                      \
+                                               \
+        screen_line((r), (o), (e), (c), (rl)); \
+    } while(0)
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
     #include "screen.c.generated.h"
@@ -172,6 +224,14 @@ void redraw_later(int type)
 
 void redraw_win_later(win_st *wp, int type)
 {
+    if(type >= NOT_VALID)
+    {
+        // The lines may be drawn differently, e.g. after ":syntax
+        // iskeyword" or a fold update, without the decoration epoch
+        // changing.
+        line_cache_invalidate(wp, 0, LINE_CACHE_SIZE - 1);
+    }
+
     if(wp->w_redr_type < type)
     {
         wp->w_redr_type = type;
@@ -202,6 +262,11 @@ void redraw_later_clear(void)
 /// Mark all windows to be redrawn later.
 void redraw_all_later(int type)
 {
+    if(type >= SOME_VALID)
+    {
+        screen_decor_changed();
+    }
+
     FOR_ALL_WINDOWS_IN_TAB(wp, curtab)
     {
         redraw_win_later(wp, type);
@@ -217,6 +282,11 @@ void redraw_curbuf_later(int type)
 
 void redraw_buf_later(filebuf_st *buf, int type)
 {
+    if(type >= SOME_VALID)
+    {
+        screen_decor_changed();
+    }
+
     FOR_ALL_WINDOWS_IN_TAB(wp, curtab)
     {
         if(wp->w_buffer == buf)
@@ -1811,21 +1881,31 @@ static void win_update(win_st *wp)
             }
             else
             {
-                prepare_search_hl(wp, lnum);
+                // Display one line. When nothing changed in the buffer
+                // it may come from the line cache.
+                row = mod_top == 0 ? line_cache_draw(wp, lnum, srow) : -1;
 
-                // Let the syntax stuff know we skipped a few lines.
-                if(syntax_last_parsed != 0 && syntax_last_parsed + 1 < lnum
-                   && syntax_present(wp))
+                if(row < 0)
                 {
-                    syntax_end_parsing(syntax_last_parsed + 1);
+                    prepare_search_hl(wp, lnum);
+
+                    // Let the syntax stuff know we skipped a few lines.
+                    if(syntax_last_parsed != 0
+                       && syntax_last_parsed + 1 < lnum
+                       && syntax_present(wp))
+                    {
+                        syntax_end_parsing(syntax_last_parsed + 1);
+                    }
+
+                    line_cache_start(wp, lnum);
+                    row = win_line(wp, lnum, srow, wp->w_height, mod_top == 0);
+                    line_cache_finish(wp, lnum, srow, row);
+                    syntax_last_parsed = lnum;
                 }
 
-                // Display one line.
-                row = win_line(wp, lnum, srow, wp->w_height, mod_top == 0);
                 wp->w_lines[idx].wl_folded = FALSE;
                 wp->w_lines[idx].wl_lastlnum = lnum;
                 did_update = DID_LINE;
-                syntax_last_parsed = lnum;
             }
 
             wp->w_lines[idx].wl_lnum = lnum;
@@ -2674,6 +2754,280 @@ static void fill_foldcolumn(uchar_kt *p, win_st *wp, int closed, linenum_kt lnum
     }
 }
 
+/// Invalidate the rendered lines of all windows. Called when something
+/// changes how lines are drawn that b:changedtick, the window size and
+/// the key of the cache don't cover, e.g. highlighting, signs and matches.
+void screen_decor_changed(void)
+{
+    screen_decor_epoch++;
+}
+
+/// Return the current decoration epoch, see screen_decor_changed().
+unsigned screen_decor_get(void)
+FUNC_ATTR_PURE
+FUNC_ATTR_WARN_UNUSED_RESULT
+{
+    return screen_decor_epoch;
+}
+
+/// Free the rendered line cache of window @b wp.
+void line_cache_free(win_st *wp)
+{
+    if(wp->w_line_cache == NULL)
+    {
+        return;
+    }
+
+    for(int i = 0; i < LINE_CACHE_SIZE; i++)
+    {
+        linecache_entry_st *lce = &wp->w_line_cache->entries[i];
+
+        xfree(lce->lines);
+        xfree(lce->lines_uc);
+        xfree(lce->lines_c);
+        xfree(lce->attrs);
+    }
+
+    xfree(wp->w_line_cache);
+    wp->w_line_cache = NULL;
+}
+
+/// Forget the rendered lines @b top to @b bot of window @b wp.
+void line_cache_invalidate(win_st *wp, linenum_kt top, linenum_kt bot)
+{
+    if(wp->w_line_cache == NULL)
+    {
+        return;
+    }
+
+    if(bot - top >= LINE_CACHE_SIZE)
+    {
+        top = 0;
+        bot = LINE_CACHE_SIZE - 1;
+    }
+
+    for(linenum_kt lnum = top; lnum <= bot; lnum++)
+    {
+        wp->w_line_cache->entries[lnum % LINE_CACHE_SIZE].lnum = 0;
+    }
+}
+
+/// Forget the rendered lines @b top to @b bot of buffer @b buf in all
+/// windows, for changes that don't increment b:changedtick.
+void line_cache_invalidate_buf(filebuf_st *buf,
+                               linenum_kt top,
+                               linenum_kt bot)
+{
+    FOR_ALL_TAB_WINDOWS(tp, wp)
+    {
+        if(wp->w_buffer == buf)
+        {
+            line_cache_invalidate(wp, top, bot);
+        }
+    }
+}
+
+/// Return true if line @b lnum of window @b wp can be drawn from the line
+/// cache. The cursor line, Visual and 'incsearch' highlighting depend on the
+/// cursor, spell checking, 'relativenumber', 'cursorcolumn' and diff mode
+/// on more than the line itself.
+static bool line_cache_usable(win_st *wp, linenum_kt lnum)
+{
+    return lnum != wp->w_cursor.lnum
+           && !(lnum == wp->w_topline && wp->w_skipcol != 0)
+           && !wp->w_o_curbuf.wo_spell
+           && !wp->w_o_curbuf.wo_rnu
+           && !wp->w_o_curbuf.wo_cuc
+           && !wp->w_o_curbuf.wo_diff
+           && wp->w_buffer->terminal == NULL
+           && !bt_quickfix(wp->w_buffer)
+           && !(VIsual_active && wp->w_buffer == curwin->w_buffer)
+           && !(highlight_match && wp == curwin)
+           && dollar_vcol < 0
+           && wp->w_width > 0;
+}
+
+/// Set the key of @b lce to the current state of window @b wp.
+static void line_cache_set_key(win_st *wp, linecache_entry_st *lce)
+{
+    lce->buf_id = wp->w_buffer->b_id;
+    lce->changedtick = wp->w_buffer->b_changedtick;
+    lce->epoch = screen_decor_epoch;
+    lce->leftcol = wp->w_leftcol;
+    lce->width = wp->w_width;
+    lce->hl_attr = wp->w_hl_attr;
+    lce->mco = Screen_mco;
+    lce->hlsearch = p_hls && !no_hlsearch;
+}
+
+/// Return true if @b lce holds line @b lnum as window @b wp would draw it now.
+static bool line_cache_valid(win_st *wp,
+                             linecache_entry_st *lce,
+                             linenum_kt lnum)
+{
+    return lce->lnum == lnum
+           && lce->buf_id == wp->w_buffer->b_id
+           && lce->changedtick == wp->w_buffer->b_changedtick
+           && lce->epoch == screen_decor_epoch
+           && lce->leftcol == wp->w_leftcol
+           && lce->width == wp->w_width
+           && lce->hl_attr == wp->w_hl_attr
+           && lce->mco == Screen_mco
+           && lce->hlsearch == (p_hls && !no_hlsearch);
+}
+
+/// Draw line @b lnum of window @b wp at row @b startrow from the line cache.
+///
+/// @return the row below the line, like win_line(),
+///         or -1 when the line is not in the cache.
+static int line_cache_draw(win_st *wp, linenum_kt lnum, int startrow)
+{
+    if(wp->w_line_cache == NULL || !line_cache_usable(wp, lnum))
+    {
+        return -1;
+    }
+
+    linecache_entry_st *lce =
+        &wp->w_line_cache->entries[lnum % LINE_CACHE_SIZE];
+
+    if(!line_cache_valid(wp, lce, lnum)
+       || startrow + lce->rows >= wp->w_height)
+    {
+        return -1;
+    }
+
+    unsigned off = (unsigned)(current_ScreenLine - ScreenLines);
+    size_t width = (size_t)lce->width;
+
+    for(int i = 0; i < lce->rows; i++)
+    {
+        size_t from = (size_t)i * width;
+        int screen_row = startrow + i + wp->w_winrow;
+
+        memcpy(ScreenLines + off, lce->lines + from,
+               width * sizeof(*ScreenLines));
+        memcpy(ScreenLinesUC + off, lce->lines_uc + from,
+               width * sizeof(*ScreenLinesUC));
+        memcpy(ScreenAttrs + off, lce->attrs + from,
+               width * sizeof(*ScreenAttrs));
+
+        for(int k = 0; k < Screen_mco; k++)
+        {
+            memcpy(ScreenLinesC[k] + off,
+                   lce->lines_c + (size_t)k * lce->cells + from,
+                   width * sizeof(*ScreenLinesC[k]));
+        }
+
+        screen_line(screen_row, wp->w_wincol, lce->endcol[i],
+                    lce->clear_width[i], wp->w_o_curbuf.wo_rl);
+
+        // Remember that the line wraps, used for modeless copy.
+        if(i + 1 < lce->rows && wp->w_width == Columns)
+        {
+            LineWraps[screen_row] = TRUE;
+        }
+    }
+
+    return startrow + lce->rows;
+}
+
+/// Start recording the screen rows win_line() draws for line @b lnum of
+/// window @b wp, if that line can be cached.
+static void line_cache_start(win_st *wp, linenum_kt lnum)
+{
+    line_cache_rec = NULL;
+
+    if(!line_cache_usable(wp, lnum))
+    {
+        return;
+    }
+
+    if(wp->w_line_cache == NULL)
+    {
+        wp->w_line_cache = xcalloc(1, sizeof(linecache_st));
+    }
+
+    linecache_entry_st *lce =
+        &wp->w_line_cache->entries[lnum % LINE_CACHE_SIZE];
+
+    size_t cells = (size_t)wp->w_width * LINE_CACHE_MAXROWS;
+
+    if(lce->cells != cells || lce->mco != Screen_mco)
+    {
+        lce->lines = xrealloc(lce->lines, cells * sizeof(*lce->lines));
+        lce->lines_uc = xrealloc(lce->lines_uc,
+                                 cells * sizeof(*lce->lines_uc));
+        lce->attrs = xrealloc(lce->attrs, cells * sizeof(*lce->attrs));
+        xfree(lce->lines_c);
+        lce->lines_c = Screen_mco > 0
+                       ? xmalloc(cells * (size_t)Screen_mco
+                                 * sizeof(*lce->lines_c))
+                       : NULL;
+        lce->cells = cells;
+    }
+
+    // Not valid until line_cache_finish() found the line complete.
+    lce->lnum = 0;
+    lce->rows = 0;
+    line_cache_set_key(wp, lce);
+    line_cache_rec = lce;
+}
+
+/// Called from SCREEN_LINE() to store the row of current_ScreenLine[] that
+/// is about to be drawn into the entry being recorded.
+static void line_cache_record(int endcol, int clear_width)
+{
+    linecache_entry_st *lce = line_cache_rec;
+
+    if(lce->rows >= LINE_CACHE_MAXROWS)
+    {
+        // Too many rows, line_cache_finish() will drop the entry.
+        lce->rows++;
+        return;
+    }
+
+    unsigned off = (unsigned)(current_ScreenLine - ScreenLines);
+    size_t width = (size_t)lce->width;
+    size_t to = (size_t)lce->rows * width;
+
+    memcpy(lce->lines + to, ScreenLines + off, width * sizeof(*ScreenLines));
+    memcpy(lce->lines_uc + to, ScreenLinesUC + off,
+           width * sizeof(*ScreenLinesUC));
+    memcpy(lce->attrs + to, ScreenAttrs + off, width * sizeof(*ScreenAttrs));
+
+    for(int k = 0; k < lce->mco; k++)
+    {
+        memcpy(lce->lines_c + (size_t)k * lce->cells + to,
+               ScreenLinesC[k] + off, width * sizeof(*ScreenLinesC[k]));
+    }
+
+    lce->endcol[lce->rows] = endcol;
+    lce->clear_width[lce->rows] = clear_width;
+    lce->rows++;
+}
+
+/// Stop recording for line @b lnum of window @b wp, which win_line() drew
+/// from @b startrow up to @b row. The entry is only kept when all of the
+/// line was drawn and it fits in the window.
+static void line_cache_finish(win_st *wp,
+                              linenum_kt lnum,
+                              int startrow,
+                              int row)
+{
+    linecache_entry_st *lce = line_cache_rec;
+
+    line_cache_rec = NULL;
+
+    if(lce != NULL
+       && lce->rows > 0
+       && lce->rows <= LINE_CACHE_MAXROWS
+       && row == startrow + lce->rows
+       && row < wp->w_height)
+    {
+        lce->lnum = lnum;
+    }
+}
+
 /// Display line @b lnum of window @b wp on the screen.
 /// Start at row @b startrow, stop when @b endrow is reached.
 /// wp->w_virtcol needs to be valid.
@@ -2751,7 +3105,6 @@ static int win_line(win_st *wp,
     int  *color_cols = NULL; // pointer to according columns array
     bool has_spell = false; // this buffer has spell checking
 
-    #define SPWORDLEN    150
     uchar_kt nextline[SPWORDLEN * 2]; // text with start of the next line
     int nextlinecol = 0; // column where nextline[] starts
     int nextline_idx = 0; // index in nextline[] where next line starts
@@ -3118,6 +3471,9 @@ static int win_line(win_st *wp,
 
     if(has_spell)
     {
+        // Use the words checked when the line was drawn before.
+        spell_cache_start_line(wp, lnum, line);
+
         // For checking first word with a capital skip white space.
         if(cap_col == 0)
         {
@@ -3191,6 +3547,7 @@ static int win_line(win_st *wp,
     if(v > 0)
     {
         uchar_kt  *prev_ptr = ptr;
+        columnum_kt next_cp = VCOL_INDEX_STEP;
 
         while(vcol < v && *ptr != NUL)
         {
@@ -3198,6 +3555,16 @@ static int win_line(win_st *wp,
             vcol += c;
             prev_ptr = ptr;
             mb_ptr_adv(ptr);
+
+            if(ptr - line >= next_cp)
+            {
+                // Skip ahead in a long line, see vcol_index_walk().
+                columnum_kt vc = (columnum_kt)vcol;
+
+                next_cp = vcol_index_walk(wp, lnum, line, &ptr, &vc,
+                                          MAXCOL, (columnum_kt)v - 1);
+                vcol = vc;
+            }
         }
 
         // When:
@@ -4315,8 +4682,11 @@ static int win_line(win_st *wp,
 
                         cap_col -= (int)(prev_ptr - line);
 
-                        size_t tmplen = spell_check(wp, p, &spell_hlf,
-                                                    &cap_col, nochange);
+                        size_t tmplen =
+                            spell_check_cached(wp, lnum,
+                                               (columnum_kt)(prev_ptr - line),
+                                               p, &spell_hlf,
+                                               &cap_col, nochange);
 
                         assert(tmplen <= INT_MAX);
                         len = (int)tmplen;
@@ -5693,6 +6063,79 @@ static int char_needs_redraw(int off_from, int off_to, int cols)
     return false;
 }
 
+/// Return true if the "cols" cells at @b off_from and @b off_to are the same
+/// in all the screen arrays, comparing them with memcmp().
+static bool screen_cells_same(unsigned off_from, unsigned off_to, int cols)
+{
+    size_t n = (size_t)cols;
+
+    if(memcmp(ScreenLines + off_from,
+              ScreenLines + off_to, n * sizeof(*ScreenLines)) != 0
+       || memcmp(ScreenAttrs + off_from,
+                 ScreenAttrs + off_to, n * sizeof(*ScreenAttrs)) != 0
+       || memcmp(ScreenLinesUC + off_from,
+                 ScreenLinesUC + off_to, n * sizeof(*ScreenLinesUC)) != 0)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < Screen_mco; i++)
+    {
+        if(memcmp(ScreenLinesC[i] + off_from, ScreenLinesC[i] + off_to,
+                  n * sizeof(*ScreenLinesC[i])) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// Return the number of cells from @b off_from that don't need to be redrawn
+/// at @b off_to, looking at no more than "cols" cells. Blocks of cells are
+/// compared as a whole, only a block that differs is checked per character.
+static int screen_cells_skip(unsigned off_from,
+                             unsigned off_to,
+                             int cols,
+                             unsigned max_off_from)
+{
+    int n = 0;
+
+    while(n < cols)
+    {
+        int block = MIN(SCREEN_CMP_BLOCK, cols - n);
+
+        if(screen_cells_same(off_from + n, off_to + n, block))
+        {
+            n += block;
+            continue;
+        }
+
+        int end = n + block;
+
+        // The left halve of a double-wide character in front of the block
+        // has not been compared with its right halve yet.
+        if(n > 0 && ScreenLines[off_from + n] == 0)
+        {
+            n--;
+        }
+
+        while(n < end
+              && !char_needs_redraw(off_from + n, off_to + n, cols - n))
+        {
+            n += (n + 1 < cols)
+                 ? (*mb_off2cells)(off_from + n, max_off_from) : 1;
+        }
+
+        if(n < end)
+        {
+            return n;
+        }
+    }
+
+    return n;
+}
+
 /// Move one "cooked" screen line to the screen, but only the characters that
 /// have actually changed. Handle insert/delete character.
 /// "coloff" gives the first column on the screen for this line.
@@ -5714,14 +6157,11 @@ static void screen_line(int row,
     unsigned max_off_to;
     int col = 0;
     int hl;
-    int force = FALSE; // force update rest of the line
-    int redraw_this; // bool: does character need redraw ?
-    int redraw_next; // redraw_this for next character
     int clear_next = FALSE;
-    int char_cells; // 1: normal char
-
-    // 2: occupies two display cells
-    #define CHAR_CELLS    char_cells
+    int char_cells; // 1: normal char, 2: occupies two display cells
+    unsigned run_off = 0; // ScreenLines offset of the pending run
+    int run_col = 0; // screen column of the pending run
+    int run_cells = 0; // number of cells in the pending run
 
     // Check for illegal row and col, just in case.
     if(row >= Rows)
@@ -5764,10 +6204,19 @@ static void screen_line(int row,
         endcol = (clear_width > 0 ? clear_width : -clear_width);
     }
 
-    redraw_next = char_needs_redraw(off_from, off_to, endcol - col);
-
     while(col < endcol)
     {
+        int skip = screen_cells_skip(off_from, off_to,
+                                     endcol - col, max_off_from);
+
+        if(skip > 0)
+        {
+            off_to += skip;
+            off_from += skip;
+            col += skip;
+            continue;
+        }
+
         if((col + 1 < endcol))
         {
             char_cells = (*mb_off2cells)(off_from, max_off_from);
@@ -5777,61 +6226,72 @@ static void screen_line(int row,
             char_cells = 1;
         }
 
-        redraw_this = redraw_next;
-        redraw_next = force || char_needs_redraw(off_from + CHAR_CELLS,
-                                                 off_to + CHAR_CELLS,
-                                                 endcol - col - CHAR_CELLS);
-
-        if(redraw_this)
+        // When writing a single-width character over a double-width
+        // character and at the end of the redrawn text, need to clear out
+        // the right halve of the old character.
+        // Also required when writing the right halve of a double-width
+        // char over the left halve of an existing one.
+        if(col + char_cells == endcol
+           && ((char_cells == 1
+                && (*mb_off2cells)(off_to, max_off_to) > 1)
+               || (char_cells == 2
+                   && (*mb_off2cells)(off_to, max_off_to) == 1
+                   && (*mb_off2cells)(off_to + 1, max_off_to) > 1)))
         {
-            // When writing a single-width character over a double-width
-            // character and at the end of the redrawn text, need to clear out
-            // the right halve of the old character.
-            // Also required when writing the right halve of a double-width
-            // char over the left halve of an existing one.
-            if(col + char_cells == endcol
-               && ((char_cells == 1
-                    && (*mb_off2cells)(off_to, max_off_to) > 1)
-                   || (char_cells == 2
-                       && (*mb_off2cells)(off_to, max_off_to) == 1
-                       && (*mb_off2cells)(off_to + 1, max_off_to) > 1)))
-            {
-                clear_next = TRUE;
-            }
-
-            ScreenLines[off_to] = ScreenLines[off_from];
-            ScreenLinesUC[off_to] = ScreenLinesUC[off_from];
+            clear_next = TRUE;
+        }
 
-            if(ScreenLinesUC[off_from] != 0)
-            {
-                int i;
+        ScreenLines[off_to] = ScreenLines[off_from];
+        ScreenLinesUC[off_to] = ScreenLinesUC[off_from];
 
-                for(i = 0; i < Screen_mco; ++i)
-                {
-                    ScreenLinesC[i][off_to] = ScreenLinesC[i][off_from];
-                }
-            }
+        if(ScreenLinesUC[off_from] != 0)
+        {
+            int i;
 
-            if(char_cells == 2)
+            for(i = 0; i < Screen_mco; ++i)
             {
-                ScreenLines[off_to + 1] = ScreenLines[off_from + 1];
+                ScreenLinesC[i][off_to] = ScreenLinesC[i][off_from];
             }
+        }
 
-            ScreenAttrs[off_to] = ScreenAttrs[off_from];
+        if(char_cells == 2)
+        {
+            ScreenLines[off_to + 1] = ScreenLines[off_from + 1];
+        }
 
-            // For simplicity set the attributes of second half of a
-            // double-wide character equal to the first half.
-            if(char_cells == 2)
-            {
-                ScreenAttrs[off_to + 1] = ScreenAttrs[off_from];
-            }
+        ScreenAttrs[off_to] = ScreenAttrs[off_from];
 
-            screen_char(off_to, row, col + coloff);
+        // For simplicity set the attributes of second half of a
+        // double-wide character equal to the first half.
+        if(char_cells == 2)
+        {
+            ScreenAttrs[off_to + 1] = ScreenAttrs[off_from];
+        }
+
+        // Changed characters with the same attributes go out as one run.
+        if(run_cells > 0
+           && (run_col + run_cells != col + coloff
+               || ScreenAttrs[run_off] != ScreenAttrs[off_to]))
+        {
+            screen_char_run(run_off, row, run_col, run_cells);
+            run_cells = 0;
         }
 
-        off_to += CHAR_CELLS;
-        off_from += CHAR_CELLS;
-        col += CHAR_CELLS;
+        if(run_cells == 0)
+        {
+            run_off = off_to;
+            run_col = col + coloff;
+        }
+
+        run_cells += char_cells;
+        off_to += char_cells;
+        off_from += char_cells;
+        col += char_cells;
+    }
+
+    if(run_cells > 0)
+    {
+        screen_char_run(run_off, row, run_col, run_cells);
     }
 
     if(clear_next)
@@ -7523,6 +7983,76 @@ static void screen_char(unsigned off, int row, int col)
     }
 }
 
+/// Put the "cells" cells from ScreenLines["off"] on the screen at position
+/// "row" and "col" in one go. They must all have the attributes from
+/// ScreenAttrs["off"].
+static void screen_char_run(unsigned off, int row, int col, int cells)
+{
+    int attr = ScreenAttrs[off];
+
+    // Check for illegal values, just in case
+    // (could happen just after resizing).
+    if(row >= screen_Rows || col >= screen_Columns)
+    {
+        return;
+    }
+
+    if(cells > screen_Columns - col)
+    {
+        cells = screen_Columns - col;
+    }
+
+    uchar_kt *buf = xmalloc((size_t)cells * MB_MAXBYTES + 1);
+    size_t len = 0;
+    int i = 0;
+
+    while(i < cells)
+    {
+        // Outputting the last character on the screen may scrollup the
+        // screen, see screen_char().
+        if(row == screen_Rows - 1
+           && col + i == screen_Columns - 1
+           && !cmdmsg_rl)
+        {
+            ScreenAttrs[off + i] = (sattr_T)-1;
+            break;
+        }
+
+        if(ScreenLinesUC[off + i] != 0)
+        {
+            len += (size_t)utfc_char2bytes((int)(off + i), buf + len);
+        }
+        else
+        {
+            buf[len++] = ScreenLines[off + i];
+        }
+
+        i += (*mb_off2cells)(off + i, off + (unsigned)cells);
+    }
+
+    buf[len] = NUL;
+
+    if(len > 0)
+    {
+        // Stop highlighting first, so it's easier to move the cursor.
+        if(screen_attr != attr)
+        {
+            screen_stop_highlight();
+        }
+
+        ui_cursor_goto(row, col);
+
+        if(screen_attr != attr)
+        {
+            screen_start_highlight(attr);
+        }
+
+        ui_puts(buf);
+    }
+
+    xfree(buf);
+}
+
 /// Fill the screen from 'start_row' to 'end_row', from 'start_col' to 'end_col'
 /// with character 'c1' in first column followed by 'c2' in the other columns.
 /// Use attributes 'attr'.
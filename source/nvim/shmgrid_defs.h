@@ -0,0 +1,86 @@
+/// @file nvim/shmgrid_defs.h
+///
+/// Layout of the shared memory grid of remote UIs with the "ext_shmgrid"
+/// option. Plain C, the UIs include it too.
+///
+/// The object starts with a shmgrid_header_st, followed by the attribute
+/// table of "attrs_max" shmgrid_attr_st and two buffers of rows * cols
+/// shmgrid_cell_st, row after row.
+///
+/// Nvim writes a frame into the buffer the UI doesn't read, makes it the
+/// "front" one, increments "seq" and sends the "grid_flush" event with the
+/// new "seq" and the range of rows that changed. When done reading the
+/// rows of a frame the UI sets "ack" to its "seq". Nvim doesn't start a
+/// frame before "ack" is at most one frame behind "seq": the buffer it
+/// writes is then not read anymore. Frame "seq" is in buffer seq % 2, a
+/// new object starts at frame 0.
+///
+/// The attribute table only grows, entries are written before the cells
+/// using them. A resize or a full table is a new object, announced by the
+/// "grid_shm" event.
+
+#ifndef NVIM_SHMGRID_DEFS_H
+#define NVIM_SHMGRID_DEFS_H
+
+#include <stdint.h>
+
+#define SHMGRID_MAGIC       0x53475244  ///< "SGRD"
+#define SHMGRID_VERSION     1
+#define SHMGRID_ATTRS_MAX   4096        ///< entries of the attribute table
+
+/// shmgrid_attr_st flags
+enum
+{
+    kShmgridBold      = 0x01,
+    kShmgridItalic    = 0x02,
+    kShmgridUnderline = 0x04,
+    kShmgridUndercurl = 0x08,
+    kShmgridReverse   = 0x10,
+};
+
+typedef struct shmgrid_header_s
+{
+    uint32_t magic;         ///< SHMGRID_MAGIC
+    uint32_t version;       ///< SHMGRID_VERSION
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t attrs_max;     ///< size of the attribute table
+    uint32_t attrs_size;    ///< entries of the attribute table in use
+    uint32_t front;         ///< buffer of the last frame, 0 or 1
+    uint32_t seq;           ///< last frame, written by Nvim
+    uint32_t ack;           ///< last frame read, written by the UI
+    uint32_t reserved[7];
+} shmgrid_header_st;
+
+typedef struct shmgrid_attr_s
+{
+    int32_t foreground;     ///< RGB, -1 for the default color
+    int32_t background;
+    int32_t special;
+    uint32_t flags;         ///< kShmgridBold, ...
+} shmgrid_attr_st;
+
+typedef struct shmgrid_cell_s
+{
+    uint32_t chr;           ///< first code point, 0 for the right half
+                            ///< of a double-width character
+    uint32_t attr;          ///< index in the attribute table
+} shmgrid_cell_st;
+
+/// Size of a shared memory grid of @b rows and @b cols.
+#define SHMGRID_SIZE(rows, cols)                                  \
+    (sizeof(shmgrid_header_st)                                    \
+     + SHMGRID_ATTRS_MAX * sizeof(shmgrid_attr_st)                \
+     + 2 * (size_t)(rows) * (size_t)(cols) * sizeof(shmgrid_cell_st))
+
+/// The attribute table of the grid at @b hdr.
+#define SHMGRID_ATTRS(hdr)                                        \
+    ((shmgrid_attr_st *)((char *)(hdr) + sizeof(shmgrid_header_st)))
+
+/// The cells of buffer @b buf of the grid at @b hdr.
+#define SHMGRID_CELLS(hdr, buf)                                   \
+    ((shmgrid_cell_st *)((char *)SHMGRID_ATTRS(hdr)               \
+                         + (hdr)->attrs_max * sizeof(shmgrid_attr_st)) \
+     + (size_t)(buf) * (hdr)->rows * (hdr)->cols)
+
+#endif // NVIM_SHMGRID_DEFS_H
@@ -110,6 +110,7 @@
 #include "nvim/option.h"
 #include "nvim/os_unix.h"
 #include "nvim/path.h"
+#include "nvim/profile.h"
 #include "nvim/regexp.h"
 #include "nvim/screen.h"
 #include "nvim/search.h"
@@ -118,6 +119,7 @@
 #include "nvim/syntax.h"
 #include "nvim/undo.h"
 #include "nvim/os/os.h"
+#include "nvim/lib/kvec.h"
 #include "nvim/os/input.h"
 
 /// mix of upper and lower case: macaRONI
@@ -317,6 +319,48 @@ typedef struct limitscore_s
     int score;
 } limitscore_st;
 
+/// Number of lines for which the spell_check() results are cached.
+#define SPELLCACHE_LINES      512
+
+/// Number of lines above and below the window that are checked in advance.
+#define SPELLCACHE_PREFETCH   50
+
+/// One cached spell_check() result.
+typedef struct spellcache_item_s
+{
+    columnum_kt col; ///< byte column in the line of the checked text
+    int capcol_in;   ///< "capcol" passed to spell_check()
+    int capcol_out;  ///< "capcol" set by spell_check()
+    int len;         ///< length returned by spell_check()
+    hlf_et hlf;      ///< highlight of a bad word, HLF_COUNT when it's OK
+} spellcache_item_st;
+
+/// The cached spell_check() results for one line.
+typedef struct spellcache_line_s
+{
+    linenum_kt lnum;  ///< line number, zero when the entry is not used
+    uint32_t hash;    ///< hash of the line text the items are for
+    uint64_t used;    ///< when last used, the oldest entry is reused first
+    kvec_t(spellcache_item_st) items; ///< sorted on col and capcol_in
+} spellcache_line_st;
+
+/// Words checked in the lines of a buffer, see synblk_st::b_spell_cache.
+///
+/// Redrawing lines that didn't change then doesn't need to walk the word
+/// trees again. The entries move along when lines are inserted or deleted,
+/// changed lines are dropped, see spell_cache_changed(). Everything is
+/// dropped when the languages, word lists or 'spellcapcheck' change.
+struct spellcache_s
+{
+    int generation;          ///< "spellcache_generation" for the items
+    uint64_t used;           ///< use counter for spellcache_line_st::used
+    spellcache_line_st *cur; ///< line set by spell_cache_start_line()
+    spellcache_line_st lines[SPELLCACHE_LINES];
+};
+
+/// Incremented when the cached spell_check() results become invalid.
+static int spellcache_generation = 1;
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
     #include "spell.c.generated.h"
 #endif
@@ -611,6 +655,421 @@ size_t spell_check(win_st *wp,
     return (size_t)(mi.mi_end - ptr);
 }
 
+/// Drop all cached spell_check() results, called when the languages, the
+/// word lists or 'spellcapcheck' change.
+void spell_cache_flush(void)
+{
+    spellcache_generation++;
+}
+
+/// Free the spell_check() results cached for @b synblock
+void spell_cache_free(synblk_st *synblock)
+{
+    spellcache_st *cache = synblock->b_spell_cache;
+
+    if(cache == NULL)
+    {
+        return;
+    }
+
+    for(int i = 0; i < SPELLCACHE_LINES; i++)
+    {
+        kv_destroy(cache->lines[i].items);
+    }
+
+    xfree(cache);
+    synblock->b_spell_cache = NULL;
+}
+
+/// Get the spell_check() cache for @b synblock, allocating it when needed.
+/// When the cached results are outdated they are dropped.
+static spellcache_st *spell_cache_get(synblk_st *synblock)
+{
+    spellcache_st *cache = synblock->b_spell_cache;
+
+    if(cache == NULL)
+    {
+        cache = xcalloc(1, sizeof(spellcache_st));
+        cache->generation = spellcache_generation;
+        synblock->b_spell_cache = cache;
+    }
+    else if(cache->generation != spellcache_generation)
+    {
+        for(int i = 0; i < SPELLCACHE_LINES; i++)
+        {
+            cache->lines[i].lnum = 0;
+            cache->lines[i].used = 0;
+            kv_size(cache->lines[i].items) = 0;
+        }
+
+        cache->generation = spellcache_generation;
+        cache->cur = NULL;
+    }
+
+    return cache;
+}
+
+/// Find the cache entry for line @b lnum
+///
+/// @param create  when the line isn't found reuse the least recently
+///                used entry for it
+///
+/// @return NULL when not found and @b create is false
+static spellcache_line_st *spell_cache_find(spellcache_st *cache,
+                                            linenum_kt lnum,
+                                            bool create)
+{
+    spellcache_line_st *oldest = &cache->lines[0];
+
+    for(int i = 0; i < SPELLCACHE_LINES; i++)
+    {
+        spellcache_line_st *entry = &cache->lines[i];
+
+        if(entry->lnum == lnum)
+        {
+            return entry;
+        }
+
+        if(entry->used < oldest->used)
+        {
+            oldest = entry;
+        }
+    }
+
+    if(!create)
+    {
+        return NULL;
+    }
+
+    if(cache->cur == oldest)
+    {
+        cache->cur = NULL;
+    }
+
+    oldest->lnum = lnum;
+    oldest->hash = 0;
+    oldest->used = 0;
+    kv_size(oldest->items) = 0;
+
+    return oldest;
+}
+
+/// FNV-1a hash of the text of a line, used to notice the cached results
+/// don't match the text, e.g. when a change wasn't reported.
+static uint32_t spell_cache_hash(const uchar_kt *line)
+{
+    uint32_t hash = 2166136261u;
+
+    for(const uchar_kt *p = line; *p != NUL; p++)
+    {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/// Prepare for spell_check_cached() calls for line @b lnum of the buffer in
+/// window @b wp, with text @b line
+void spell_cache_start_line(win_st *wp, linenum_kt lnum, const uchar_kt *line)
+{
+    spellcache_st *cache = spell_cache_get(wp->w_s);
+    spellcache_line_st *entry = spell_cache_find(cache, lnum, true);
+    uint32_t hash = spell_cache_hash(line);
+
+    if(entry->hash != hash)
+    {
+        entry->hash = hash;
+        kv_size(entry->items) = 0;
+    }
+
+    entry->used = ++cache->used;
+    cache->cur = entry;
+}
+
+/// Like spell_check(), but use the result cached for line @b lnum when the
+/// word at byte column @b col was checked before with the same @b capcol.
+/// spell_cache_start_line() must have been called for the line.
+///
+/// @param wp       current window
+/// @param lnum     line number of the text
+/// @param col      byte column of @b ptr in the line
+/// @param ptr      text to check, can be in a copy of the line
+/// @param attrp    set to the highlight of a bad word
+/// @param capcol   column to check for Capital, see spell_check()
+/// @param docount  count good words
+///
+/// @return the length of the word in bytes, as spell_check()
+size_t spell_check_cached(win_st *wp,
+                          linenum_kt lnum,
+                          columnum_kt col,
+                          uchar_kt *ptr,
+                          hlf_et *attrp,
+                          int *capcol,
+                          bool docount)
+{
+    spellcache_st *cache = wp->w_s->b_spell_cache;
+
+    if(cache == NULL
+       || cache->cur == NULL
+       || cache->cur->lnum != lnum
+       || cache->generation != spellcache_generation)
+    {
+        return spell_check(wp, ptr, attrp, capcol, docount);
+    }
+
+    spellcache_line_st *entry = cache->cur;
+    int capcol_in = capcol == NULL ? INT_MIN : *capcol;
+
+    // Binary search for the first item not before (col, capcol_in).
+    size_t lo = 0;
+    size_t hi = kv_size(entry->items);
+
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        spellcache_item_st *item = &kv_A(entry->items, mid);
+
+        if(item->col < col
+           || (item->col == col && item->capcol_in < capcol_in))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if(lo < kv_size(entry->items))
+    {
+        spellcache_item_st *item = &kv_A(entry->items, lo);
+
+        if(item->col == col && item->capcol_in == capcol_in)
+        {
+            if(item->hlf != HLF_COUNT)
+            {
+                *attrp = item->hlf;
+            }
+
+            if(capcol != NULL)
+            {
+                *capcol = item->capcol_out;
+            }
+
+            return (size_t)item->len;
+        }
+    }
+
+    hlf_et hlf = HLF_COUNT;
+    size_t len = spell_check(wp, ptr, &hlf, capcol, docount);
+
+    if(hlf != HLF_COUNT)
+    {
+        *attrp = hlf;
+    }
+
+    // Insert the result, keeping the items sorted.
+    (void)kv_pushp(entry->items);
+
+    spellcache_item_st *items = entry->items.items;
+    size_t count = kv_size(entry->items);
+
+    memmove(&items[lo + 1], &items[lo],
+            (count - 1 - lo) * sizeof(spellcache_item_st));
+
+    items[lo].col = col;
+    items[lo].capcol_in = capcol_in;
+    items[lo].capcol_out = capcol == NULL ? 0 : *capcol;
+    items[lo].len = (int)len;
+    items[lo].hlf = hlf;
+
+    return len;
+}
+
+/// Move the cached results of @b cache along with a change, see
+/// spell_cache_changed().
+static void spell_cache_adjust(spellcache_st *cache,
+                               linenum_kt lnum,
+                               linenum_kt lnume,
+                               long xtra)
+{
+    for(int i = 0; i < SPELLCACHE_LINES; i++)
+    {
+        spellcache_line_st *entry = &cache->lines[i];
+
+        if(entry->lnum == 0)
+        {
+            continue;
+        }
+
+        // The line before the change is dropped too: a word at its end may
+        // continue in the changed line.
+        if(entry->lnum >= lnum - 1 && entry->lnum < lnume)
+        {
+            if(cache->cur == entry)
+            {
+                cache->cur = NULL;
+            }
+
+            entry->lnum = 0;
+            entry->used = 0;
+            kv_size(entry->items) = 0;
+        }
+        else if(entry->lnum >= lnume)
+        {
+            entry->lnum += xtra;
+        }
+    }
+}
+
+/// Lines @b lnum to @b lnume (not including) of buffer @b buf changed and
+/// @b xtra lines were added (negative when deleted). Drop the cached
+/// spell_check() results for the changed lines and move the ones below.
+void spell_cache_changed(filebuf_st *buf,
+                         linenum_kt lnum,
+                         linenum_kt lnume,
+                         long xtra)
+{
+    if(buf->b_s.b_spell_cache != NULL)
+    {
+        spell_cache_adjust(buf->b_s.b_spell_cache, lnum, lnume, xtra);
+    }
+
+    // Windows with ":syntax" set locally have their own spell settings.
+    FOR_ALL_TAB_WINDOWS(tp, wp)
+    {
+        if(wp->w_buffer == buf
+           && wp->w_s != &buf->b_s
+           && wp->w_s->b_spell_cache != NULL)
+        {
+            spell_cache_adjust(wp->w_s->b_spell_cache, lnum, lnume, xtra);
+        }
+    }
+}
+
+/// Check the words in line @b lnum of window @b wp, the way win_line()
+/// does, so that they are cached for when the line is drawn.
+static void spell_cache_fill_line(win_st *wp, linenum_kt lnum)
+{
+    spellcache_st *cache = spell_cache_get(wp->w_s);
+    spellcache_line_st *entry = spell_cache_find(cache, lnum, false);
+
+    if(entry != NULL && kv_size(entry->items) > 0)
+    {
+        return;
+    }
+
+    // Get the start of the next line, for words that wrap to it.
+    uchar_kt catbuf[SPWORDLEN + 1];
+    catbuf[0] = NUL;
+
+    if(lnum < wp->w_buffer->b_ml.ml_line_count)
+    {
+        spell_cat_line(catbuf,
+                       ml_get_buf(wp->w_buffer, lnum + 1, false),
+                       SPWORDLEN);
+    }
+
+    uchar_kt *line = ml_get_buf(wp->w_buffer, lnum, false);
+    spell_cache_start_line(wp, lnum, line);
+
+    size_t len = ustrlen(line);
+    size_t catlen = ustrlen(catbuf);
+    uchar_kt *text = xmalloc(len + catlen + 1);
+
+    memcpy(text, line, len);
+    memcpy(text + len, catbuf, catlen + 1);
+
+    // Like in win_line() the start of the next line is only used for the
+    // last SPWORDLEN bytes of the line.
+    size_t nextlinecol;
+
+    if(catlen == 0)
+    {
+        nextlinecol = MAXCOL;
+    }
+    else if(len < SPWORDLEN)
+    {
+        nextlinecol = 0;
+    }
+    else
+    {
+        nextlinecol = len - SPWORDLEN;
+    }
+
+    int capcol = lnum == 1 ? 0 : -1;
+
+    if(capcol == 0)
+    {
+        capcol = (int)(skipwhite(text) - text);
+    }
+
+    size_t col = 0;
+
+    while(col < len)
+    {
+        uchar_kt save = text[len];
+
+        if(col < nextlinecol)
+        {
+            text[len] = NUL;
+        }
+
+        hlf_et hlf = HLF_COUNT;
+        capcol -= (int)col;
+
+        size_t wlen = spell_check_cached(wp, lnum, (columnum_kt)col,
+                                         text + col, &hlf, &capcol, false);
+
+        if(capcol > 0)
+        {
+            capcol += (int)col;
+        }
+
+        text[len] = save;
+        col += wlen == 0 ? 1 : wlen;
+
+        // Don't stop halfway a multi-byte character.
+        while(col < len && (text[col] & 0xc0) == 0x80)
+        {
+            col++;
+        }
+    }
+
+    xfree(text);
+}
+
+/// Check the words in the lines just above and below window @b wp, so that
+/// scrolling doesn't have to wait for spell checking them.
+/// Called when waiting for a typed character.
+void spell_cache_prefetch(win_st *wp)
+{
+    if(!wp->w_o_curbuf.wo_spell
+       || *wp->w_s->b_p_spl == NUL
+       || GA_EMPTY(&wp->w_s->b_langp)
+       || *(char **)(wp->w_s->b_langp.ga_data) == NULL)
+    {
+        return;
+    }
+
+    linenum_kt line_count = wp->w_buffer->b_ml.ml_line_count;
+
+    for(linenum_kt lnum = wp->w_botline;
+        lnum < wp->w_botline + SPELLCACHE_PREFETCH && lnum <= line_count;
+        lnum++)
+    {
+        spell_cache_fill_line(wp, lnum);
+    }
+
+    for(linenum_kt lnum = wp->w_topline - 1;
+        lnum > wp->w_topline - 1 - SPELLCACHE_PREFETCH && lnum >= 1;
+        lnum--)
+    {
+        spell_cache_fill_line(wp, lnum);
+    }
+}
+
 /// Check if the word at "mip->mi_word" is in the tree.
 /// - When @b mode is FIND_FOLDWORD check in fold-case word tree.
 /// - When @b mode is FIND_KEEPWORD check in keep-case word tree.
@@ -2170,22 +2629,28 @@ void slang_clear(slang_st *lp)
 {
     garray_st *gap;
 
-    xfree(lp->sl_fbyts);
-    lp->sl_fbyts = NULL;
+    if(lp->sl_map != NULL)
+    {
+        // The trees are in the tree image of the mapped file.
+        os_munmap(lp->sl_map, lp->sl_map_len);
+        lp->sl_map = NULL;
+        lp->sl_map_len = 0;
+    }
+    else
+    {
+        xfree(lp->sl_fbyts);
+        xfree(lp->sl_kbyts);
+        xfree(lp->sl_pbyts);
+        xfree(lp->sl_fidxs);
+        xfree(lp->sl_kidxs);
+        xfree(lp->sl_pidxs);
+    }
 
-    xfree(lp->sl_kbyts);
+    lp->sl_fbyts = NULL;
     lp->sl_kbyts = NULL;
-
-    xfree(lp->sl_pbyts);
     lp->sl_pbyts = NULL;
-
-    xfree(lp->sl_fidxs);
     lp->sl_fidxs = NULL;
-
-    xfree(lp->sl_kidxs);
     lp->sl_kidxs = NULL;
-
-    xfree(lp->sl_pidxs);
     lp->sl_pidxs = NULL;
 
     GA_DEEP_CLEAR(&lp->sl_rep, fromto_st, free_fromto);
@@ -2553,6 +3018,7 @@ uchar_kt *did_set_spelllang(win_st *wp)
     }
 
     recursive = true;
+    spell_cache_flush();
     ga_init(&ga, sizeof(langp_st), 2);
     clear_midword(wp);
 
@@ -3124,6 +3590,8 @@ void spell_delete_wordlist(void)
 void spell_free_all(void)
 {
     slang_st *slang;
+    spell_cache_flush();
+
     // Go through all buffers and handle 'spelllang'. <VN>
     FOR_ALL_BUFFERS(buf)
     {
@@ -3428,11 +3896,20 @@ int spell_casefold(uchar_kt *str, int len, uchar_kt *buf, int buflen)
 #define SPS_FAST     2
 #define SPS_DOUBLE   4
 
+/// Time limit for finding suggestions when 'spellsuggest' has no "timeout:",
+/// none: z= and spellsuggest() search as long as they always did
+#define SPS_TIMEOUT_DEFAULT  0
+
 static int sps_flags = SPS_BEST;   ///< flags from 'spellsuggest'
 static int sps_limit = 9999;       ///< max nr of suggestions given
+static int sps_timeout = SPS_TIMEOUT_DEFAULT; ///< msec, no limit when <= 0
+
+/// When the search for suggestions has to stop, see suggest_time_passed()
+static proftime_kt sps_deadline = 0;
+static bool sps_timed_out = false;
 
 /// Check the 'spellsuggest' option. Return FAIL if it's wrong.
-/// Sets "sps_flags" and "sps_limit".
+/// Sets "sps_flags", "sps_limit" and "sps_timeout".
 int spell_check_sps(void)
 {
     uchar_kt *p;
@@ -3441,6 +3918,7 @@ int spell_check_sps(void)
     int f;
     sps_flags = 0;
     sps_limit = 9999;
+    sps_timeout = SPS_TIMEOUT_DEFAULT;
 
     for(p = p_sps; *p != NUL;)
     {
@@ -3469,6 +3947,22 @@ int spell_check_sps(void)
         {
             f = SPS_DOUBLE;
         }
+        else if(ustrncmp(buf, "timeout:", 8) == 0)
+        {
+            intmax_t msec;
+            s = buf + 8;
+
+            if((!ascii_isdigit(*s) && !(*s == '-' && ascii_isdigit(s[1])))
+               || getdigits_safe(&s, &msec) == FAIL
+               || *s != NUL)
+            {
+                f = -1;
+            }
+            else
+            {
+                sps_timeout = msec > INT_MAX ? INT_MAX : (int)msec;
+            }
+        }
         else if(ustrncmp(buf, "expr:", 5) != 0
                 && ustrncmp(buf, "file:", 5) != 0)
         {
@@ -3479,6 +3973,7 @@ int spell_check_sps(void)
         {
             sps_flags = SPS_BEST;
             sps_limit = 9999;
+            sps_timeout = SPS_TIMEOUT_DEFAULT;
             return FAIL;
         }
 
@@ -4279,6 +4774,12 @@ static void spell_suggest_intern(suginfo_st *su, bool interactive)
     // Load the .sug file(s) that are available and not done yet.
     suggest_load_files();
 
+    // Searching the word trees can take very long for a long word in a big
+    // dictionary, stop after the 'spellsuggest' "timeout:" and use what was
+    // found so far.
+    sps_deadline = profile_setlimit(sps_timeout);
+    sps_timed_out = false;
+
     // 1. Try special cases, such as repeating a word:
     //    "the the" -> "the".
     //
@@ -4702,7 +5203,7 @@ static void suggest_trie_walk(suginfo_st *su,
     //   increase "depth".
     // - When a state is done go to the next, set "ts_state".
     // - When all states are tried decrease "depth".
-    while(depth >= 0 && !got_int)
+    while(depth >= 0 && !got_int && !sps_timed_out)
     {
         sp = &stack[depth];
 
@@ -6162,11 +6663,24 @@ static void suggest_trie_walk(suginfo_st *su,
                 {
                     os_breakcheck();
                     breakcheckcount = 1000;
+                    (void)suggest_time_passed();
                 }
         }
     }
 }
 
+/// Check if the time for finding suggestions passed.
+/// Sets "sps_timed_out", which makes the word tree walks stop.
+static bool suggest_time_passed(void)
+{
+    if(!sps_timed_out && profile_passed_limit(sps_deadline))
+    {
+        sps_timed_out = true;
+    }
+
+    return sps_timed_out;
+}
+
 
 // Go one level deeper in the tree.
 static void go_deeper(trystate_st *stack, int depth, int score_add)
@@ -8414,6 +8928,100 @@ static int spell_edit_score(slang_st *slang, uchar_kt *badword, uchar_kt *goodwo
     return i;
 }
 
+/// Compute the number of inserts, deletes and substitutes needed to turn
+/// @b bad into @b good, each costing one.
+///
+/// Uses the bit-parallel algorithm by Myers, 1999, in the form given by
+/// Hyyrö, 2001: a column of the edit distance matrix is kept as bit vectors
+/// of the vertical differences, one bit for each character of @b bad.
+///
+/// @param bad      characters of the bad word
+/// @param badlen   number of characters in @b bad
+/// @param good     characters of the good word
+/// @param goodlen  number of characters in @b good
+///
+/// @return the edit distance, -1 when @b bad is longer than 64 characters
+static int spell_edit_dist_bits(const int *bad,
+                                int badlen,
+                                const int *good,
+                                int goodlen)
+{
+    if(badlen > 64)
+    {
+        return -1;
+    }
+
+    if(badlen == 0)
+    {
+        return goodlen;
+    }
+
+    // The bit masks for the distinct characters in "bad".
+    int chars[64];
+    uint64_t peq[64];
+    int nchars = 0;
+
+    for(int i = 0; i < badlen; i++)
+    {
+        int k = 0;
+
+        while(k < nchars && chars[k] != bad[i])
+        {
+            k++;
+        }
+
+        if(k == nchars)
+        {
+            chars[nchars] = bad[i];
+            peq[nchars++] = 0;
+        }
+
+        peq[k] |= (uint64_t)1 << i;
+    }
+
+    uint64_t mask = badlen == 64 ? UINT64_MAX : ((uint64_t)1 << badlen) - 1;
+    uint64_t last = (uint64_t)1 << (badlen - 1);
+    uint64_t pv = mask;
+    uint64_t mv = 0;
+    int dist = badlen;
+
+    for(int j = 0; j < goodlen; j++)
+    {
+        uint64_t eq = 0;
+
+        for(int k = 0; k < nchars; k++)
+        {
+            if(chars[k] == good[j])
+            {
+                eq = peq[k];
+                break;
+            }
+        }
+
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if(ph & last)
+        {
+            dist++;
+        }
+        else if(mh & last)
+        {
+            dist--;
+        }
+
+        // The first row counts up, shift in a positive difference.
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = (mh | ~(xv | ph)) & mask;
+        mv = ph & xv & mask;
+    }
+
+    return dist;
+}
+
 /// Like spell_edit_score(), but with a limit on the score to make it faster.
 /// May return SCORE_MAXMAX when the score is higher than "limit".
 ///
@@ -8466,6 +9074,16 @@ static int spell_edit_score_limit_w(slang_st *slang,
 
     wgoodword[gi++] = 0;
 
+    // Every edit costs at least SCORE_EDIT_MIN (a swap counts as two edits),
+    // when the plain edit distance is too big already there is no need to
+    // search for the cheapest edits.
+    int dist = spell_edit_dist_bits(wbadword, bi - 1, wgoodword, gi - 1);
+
+    if(dist >= 0 && dist * SCORE_EDIT_MIN > limit)
+    {
+        return SCORE_MAXMAX;
+    }
+
     // The idea is to go from start to end over the words. So long as
     // characters are equal just continue, this always gives the lowest score.
     // When there is a difference try several alternatives. Each alternative
@@ -15,6 +15,10 @@
 // in a byte, thus it can't be above 255.
 #define MAXWLEN   254  ///< Assume max. word len is this many bytes.
 
+/// Number of bytes of the following line used for checking a word that
+/// continues on the next line, see win_line() and spell_cat_line().
+#define SPWORDLEN 150
+
 /// Type used for indexes in the word tree need to be at least 4 bytes.
 /// If int is 8 bytes we could use something smaller, but what?
 typedef int idx_kt;
@@ -124,6 +128,8 @@ struct slang_s
     idx_kt *sl_kidxs;    ///< keep-case word indexes
     uchar_kt *sl_pbyts;  ///< prefix tree word bytes
     idx_kt *sl_pidxs;    ///< prefix tree word indexes
+    void *sl_map;        ///< mapped .spl file the trees point into or NULL
+    size_t sl_map_len;   ///< size of "sl_map"
 
     uchar_kt *sl_info;         ///< infotext string or NULL
     uchar_kt sl_regions[17];   ///< table with up to 8 region names plus NUL
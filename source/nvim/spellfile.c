@@ -9,6 +9,7 @@
 ///                        <LWORDTREE>
 ///                        <KWORDTREE>
 ///                        <PREFIXTREE>
+///                        [<TREEIMAGE>]
 ///
 /// <HEADER>: <fileID> <versionnr>
 ///
@@ -199,6 +200,27 @@
 ///
 /// All text characters are in 'encoding', but stored as single bytes.
 ///
+/// <TREEIMAGE>: <imagetree> <imagetree> <imagetree> <imagetrailer>
+///
+/// The three word trees again, as the "byts" and "idxs" arrays used in
+/// memory. When present the file is mapped and the trees are used in place,
+/// so that processes using the same file share the pages. Older versions
+/// stop reading after <PREFIXTREE> and ignore it. Written by :mkspell, it
+/// is only used on a host with the same byte order and size of idx_kt.
+///
+/// <imagetree>: <imagebyts> <imageidxs>
+///
+/// <imagebyts>  N bytes     "byts" array, N is the <nodecount>, starting at
+///                          a file offset that is a multiple of 8.
+///
+/// <imageidxs>  N idx_kt    "idxs" array, native byte order, starting at a
+///                          multiple of sizeof(idx_kt). For LWORDTREE the
+///                          node headers hold the word counts, see
+///                          tree_count_words().
+///
+/// <imagetrailer>           treeimage_st, native byte order, at the very end
+///                          of the file.
+///
 /// Vim .sug file format:  <SUGHEADER>
 ///                        <SUGWORDTREE>
 ///                        <SUGTABLE>
@@ -274,6 +296,13 @@
 #define VIMSPELLMAGICL     (sizeof(VIMSPELLMAGIC) - 1)
 #define VIMSPELLVERSION    50
 
+/// string at the end of a .spl file with a <TREEIMAGE>
+#define TREEIMAGEMAGIC     "VIMtrees"
+#define TREEIMAGEMAGICL    (sizeof(TREEIMAGEMAGIC) - 1)
+
+/// <TREEIMAGE> byte order mark, as written by the host
+#define TREEIMAGEORDER     0x01020304
+
 // Section IDs.
 // Only renumber them when VIMSPELLVERSION changes!
 #define SN_REGION       0       ///< <regionname> section
@@ -441,6 +470,10 @@ struct wordnode_s
     uint16_t wn_flags;    ///< WF_* flags
     short wn_region;      ///< region mask
 
+    /// "si_compgen" when this list of siblings is in the compression
+    /// hashtable, it didn't change since it was compressed then
+    int wn_compgen;
+
 #ifdef SPELL_PRINTTREE
     int wn_nr;          ///< sequence nr for printing
 #endif
@@ -471,6 +504,12 @@ typedef struct spellinfo_s
     /// words to add before lowering compression limit
     long si_compress_cnt;
 
+    /// Compressed lists of si_foldroot and si_keeproot, kept between
+    /// compressions so that unchanged parts are not compressed again.
+    hashtable_st si_foldht;
+    hashtable_st si_keepht;
+    int si_compgen;  ///< generation of the lists in the hashtables
+
     /// List of nodes that have been freed during
     /// compression, linked by "wn_child" field.
     wordnode_st *si_first_free;
@@ -529,6 +568,16 @@ typedef struct spellinfo_s
     int si_newcompID;         ///< current value for compound ID
 } spellinfo_st;
 
+/// The <imagetrailer> at the end of a .spl file with a <TREEIMAGE>.
+typedef struct treeimage_s
+{
+    uint64_t ti_start;   ///< file offset of the first <imagetree>
+    uint32_t ti_len[3];  ///< <nodecount> of the three trees
+    uint32_t ti_order;   ///< TREEIMAGEORDER
+    uint32_t ti_idxsize; ///< sizeof(idx_kt)
+    char ti_magic[TREEIMAGEMAGICL]; ///< TREEIMAGEMAGIC without NUL
+} treeimage_st;
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
     #include "spellfile.c.generated.h"
 #endif
@@ -885,29 +934,34 @@ truncerr:
         }
     }
 
-    // <LWORDTREE>
-    res = spell_read_tree(fd, &lp->sl_fbyts, &lp->sl_fidxs, false, 0);
-
-    if(res != 0)
+    // When the file ends in a <TREEIMAGE> use the trees in place, otherwise
+    // read them into memory.
+    if(!spell_map_trees(lp, fname))
     {
-        goto someerror;
-    }
+        // <LWORDTREE>
+        res = spell_read_tree(fd, &lp->sl_fbyts, &lp->sl_fidxs, false, 0);
+
+        if(res != 0)
+        {
+            goto someerror;
+        }
 
-    // <KWORDTREE>
-    res = spell_read_tree(fd, &lp->sl_kbyts, &lp->sl_kidxs, false, 0);
+        // <KWORDTREE>
+        res = spell_read_tree(fd, &lp->sl_kbyts, &lp->sl_kidxs, false, 0);
 
-    if(res != 0)
-    {
-        goto someerror;
-    }
+        if(res != 0)
+        {
+            goto someerror;
+        }
 
-    // <PREFIXTREE>
-    res = spell_read_tree(fd, &lp->sl_pbyts,
-                          &lp->sl_pidxs, true, lp->sl_prefixcnt);
+        // <PREFIXTREE>
+        res = spell_read_tree(fd, &lp->sl_pbyts,
+                              &lp->sl_pidxs, true, lp->sl_prefixcnt);
 
-    if(res != 0)
-    {
-        goto someerror;
+        if(res != 0)
+        {
+            goto someerror;
+        }
     }
 
     // For a new file link it in the list of spell files.
@@ -947,6 +1001,229 @@ endOK:
     return lp;
 }
 
+/// Round file offset @b off up to a multiple of @b align
+static uint64_t treeimage_align(uint64_t off, uint64_t align)
+{
+    return (off + align - 1) / align * align;
+}
+
+/// Check that a tree in a <TREEIMAGE> can be used: the nodes must fill the
+/// arrays, each child index must be the start of a node and the prefix
+/// conditions must be in range, like read_tree_node() checks.
+static bool treeimage_valid(const uchar_kt *byts,
+                            const idx_kt *idxs,
+                            uint64_t len,
+                            bool prefixtree,
+                            int prefixcnt)
+{
+    // Bit "i" is set when a node starts at index "i". A child index into
+    // the middle of a node would make the walk read a sibling as the
+    // sibling count.
+    uint8_t *starts = xcalloc((size_t)(len + 7) / 8, 1);
+    bool ok = true;
+    uint64_t i = 0;
+
+    while(i < len)
+    {
+        uint64_t n = byts[i];
+
+        if(n == 0 || i + n >= len)
+        {
+            ok = false;
+            break;
+        }
+
+        starts[i / 8] |= (uint8_t)(1 << (i % 8));
+        i += n + 1;
+    }
+
+    for(i = 0; ok && i < len; i += (uint64_t)byts[i] + 1)
+    {
+        for(uint64_t j = i + 1; ok && j <= i + byts[i]; j++)
+        {
+            if(byts[j] != 0)
+            {
+                ok = idxs[j] > 0
+                     && (uint64_t)idxs[j] < len
+                     && (starts[idxs[j] / 8] & (1 << (idxs[j] % 8))) != 0;
+            }
+            else if(prefixtree)
+            {
+                ok = ((idxs[j] >> 8) & 0xffff) < prefixcnt;
+            }
+        }
+    }
+
+    xfree(starts);
+    return ok;
+}
+
+/// Map the .spl file @b fname and use the trees of its <TREEIMAGE> for
+/// @b lp in place. The file is unmapped by slang_clear().
+///
+/// @return false when the file has no usable <TREEIMAGE>,
+///         the trees must be read then.
+static bool spell_map_trees(slang_st *lp, uchar_kt *fname)
+{
+    size_t maplen = 0;
+    uchar_kt *map = os_mmap_file((char *)fname, &maplen);
+    treeimage_st ti;
+
+    if(map == NULL)
+    {
+        return false;
+    }
+
+    if(maplen < sizeof(ti))
+    {
+        goto fail;
+    }
+
+    memcpy(&ti, map + maplen - sizeof(ti), sizeof(ti));
+
+    if(memcmp(ti.ti_magic, TREEIMAGEMAGIC, TREEIMAGEMAGICL) != 0
+       || ti.ti_order != TREEIMAGEORDER
+       || ti.ti_idxsize != sizeof(idx_kt))
+    {
+        goto fail;
+    }
+
+    uchar_kt **bytsp[3] = { &lp->sl_fbyts, &lp->sl_kbyts, &lp->sl_pbyts };
+    idx_kt **idxsp[3] = { &lp->sl_fidxs, &lp->sl_kidxs, &lp->sl_pidxs };
+    uint64_t end = maplen - sizeof(ti);
+    uint64_t off = ti.ti_start;
+
+    for(int t = 0; t < 3; t++)
+    {
+        uint64_t len = ti.ti_len[t];
+        uint64_t bytsoff = treeimage_align(off, 8);
+        uint64_t idxsoff = treeimage_align(bytsoff + len, sizeof(idx_kt));
+
+        off = idxsoff + len * sizeof(idx_kt);
+
+        if(off > end)
+        {
+            goto fail;
+        }
+
+        if(len == 0)
+        {
+            continue; // empty tree, like spell_read_tree()
+        }
+
+        uchar_kt *byts = map + bytsoff;
+        idx_kt *idxs = (idx_kt *)(map + idxsoff);
+
+        if(!treeimage_valid(byts, idxs, len, t == 2, lp->sl_prefixcnt))
+        {
+            goto fail;
+        }
+
+        *bytsp[t] = byts;
+        *idxsp[t] = idxs;
+    }
+
+    lp->sl_map = map;
+    lp->sl_map_len = maplen;
+
+    return true;
+
+fail:
+
+    lp->sl_fbyts = NULL;
+    lp->sl_kbyts = NULL;
+    lp->sl_pbyts = NULL;
+    lp->sl_fidxs = NULL;
+    lp->sl_kidxs = NULL;
+    lp->sl_pidxs = NULL;
+    os_munmap(map, maplen);
+
+    return false;
+}
+
+/// Append a <TREEIMAGE> to the .spl file @b fname just written.
+/// The trees are read back, that gives them in the form used in memory.
+///
+/// @param fname      the .spl file
+/// @param nodecount  <nodecount> of the three trees written
+///
+/// @return FAIL when writing failed.
+static int spell_write_tree_image(uchar_kt *fname, const size_t *nodecount)
+{
+    slang_st *lp = spell_load_file(fname, NULL, NULL, false);
+
+    if(lp == NULL)
+    {
+        return FAIL;
+    }
+
+    // Put the word counts in the tree now, a mapped tree can't be changed
+    // when the .sug file is loaded.
+    if(lp->sl_fbyts != NULL)
+    {
+        tree_count_words(lp->sl_fbyts, lp->sl_fidxs);
+    }
+
+    FILE *fd = mch_fopen((char *)fname, "a");
+
+    if(fd == NULL)
+    {
+        slang_free(lp);
+        return FAIL;
+    }
+
+    uchar_kt *byts[3] = { lp->sl_fbyts, lp->sl_kbyts, lp->sl_pbyts };
+    idx_kt *idxs[3] = { lp->sl_fidxs, lp->sl_kidxs, lp->sl_pidxs };
+    treeimage_st ti;
+    bool ok = fseek(fd, 0, SEEK_END) == 0;
+    long start = ftell(fd);
+    uint64_t off = start < 0 ? 0 : (uint64_t)start;
+
+    memset(&ti, 0, sizeof(ti));
+    ti.ti_start = off;
+    ti.ti_order = TREEIMAGEORDER;
+    ti.ti_idxsize = sizeof(idx_kt);
+    memcpy(ti.ti_magic, TREEIMAGEMAGIC, TREEIMAGEMAGICL);
+    ok = ok && start >= 0;
+
+    for(int t = 0; t < 3 && ok; t++)
+    {
+        uint64_t len = byts[t] == NULL ? 0 : (uint64_t)nodecount[t];
+        uint64_t bytsoff = treeimage_align(off, 8);
+        uint64_t idxsoff = treeimage_align(bytsoff + len, sizeof(idx_kt));
+
+        ti.ti_len[t] = (uint32_t)len;
+
+        for(; off < bytsoff; off++)
+        {
+            putc(0, fd);
+        }
+
+        ok = len == 0 || fwrite(byts[t], 1, (size_t)len, fd) == len;
+
+        for(off += len; off < idxsoff; off++)
+        {
+            putc(0, fd);
+        }
+
+        ok = ok && (len == 0 || fwrite(idxs[t], sizeof(idx_kt),
+                                       (size_t)len, fd) == len);
+        off += len * sizeof(idx_kt);
+    }
+
+    // The trailer goes last, a partly written image is not used.
+    ok = ok && fwrite(&ti, sizeof(ti), 1, fd) == 1;
+
+    if(fclose(fd) == EOF)
+    {
+        ok = false;
+    }
+
+    slang_free(lp);
+
+    return ok ? OK : FAIL;
+}
+
 /// Fill in the wordcount fields for a trie.
 /// Returns the total number of words.
 static void tree_count_words(uchar_kt *byts, idx_kt *idxs)
@@ -1160,7 +1437,12 @@ someerror:
 
             // Need to put word counts in the word tries,
             // so that we can find a word by its number.
-            tree_count_words(slang->sl_fbyts, slang->sl_fidxs);
+            // A mapped <TREEIMAGE> has them already.
+            if(slang->sl_map == NULL)
+            {
+                tree_count_words(slang->sl_fbyts, slang->sl_fidxs);
+            }
+
             tree_count_words(slang->sl_sbyts, slang->sl_sidxs);
 
 nextone:
@@ -2248,6 +2530,9 @@ static void spell_reload_one(uchar_kt *fname, bool added_word)
     slang_st *slang;
     bool didit = false;
 
+    // The word lists change, the checked words may be spelled differently.
+    spell_cache_flush();
+
     for(slang = first_lang; slang != NULL; slang = slang->sl_next)
     {
         if(path_full_compare(fname, slang->sl_fname, FALSE) == kEqualFiles)
@@ -5101,6 +5386,7 @@ static int tree_add_word(spellinfo_st *spin,
     wordnode_st *np;
     wordnode_st *copyp, **copyprev;
     wordnode_st **prev = NULL;
+    hashtable_st *ht = wordtree_ht(spin, root);
     int i;
 
     // Add each byte of the word to the tree, including the NUL at the end.
@@ -5157,6 +5443,14 @@ static int tree_add_word(spellinfo_st *spin,
                 }
             }
         }
+        else if(node != NULL
+                && ht != NULL
+                && node->wn_compgen == spin->si_compgen)
+        {
+            // This list or a list below it is going to change, it must be
+            // compressed again.
+            wordtree_unhash(ht, node);
+        }
 
         // Look for the sibling that has the same character. They are sorted
         // on byte value, thus stop searching when a sibling is found with a
@@ -5362,10 +5656,83 @@ static void free_wordnode(spellinfo_st *spin, wordnode_st *n)
     ++spin->si_free_count;
 }
 
+/// Get the hashtable kept between compressions of tree @b root,
+/// NULL when the tree is only compressed once.
+static hashtable_st *wordtree_ht(spellinfo_st *spin, wordnode_st *root)
+{
+    if(root == spin->si_foldroot)
+    {
+        return &spin->si_foldht;
+    }
+
+    if(root == spin->si_keeproot)
+    {
+        return &spin->si_keepht;
+    }
+
+    return NULL;
+}
+
+/// Remove list @b node from compression hashtable @b ht,
+/// it is going to be changed.
+static void wordtree_unhash(hashtable_st *ht, wordnode_st *node)
+{
+    hash_kt hash = hash_hash(node->wn_u1.hashkey);
+    hashitem_st *hi = hash_lookup(ht, (const char *)node->wn_u1.hashkey,
+                                  ustrlen(node->wn_u1.hashkey), hash);
+    wordnode_st *tp = HI2WN(hi);
+
+    assert(!HASHITEM_EMPTY(hi));
+    node->wn_compgen = 0;
+
+    if(tp == node)
+    {
+        // First in the list of nodes with this hash key, the next one with
+        // the same key takes its place.
+        if(node->wn_u2.next == NULL)
+        {
+            hash_remove(ht, hi);
+        }
+        else
+        {
+            hi->hi_key = node->wn_u2.next->wn_u1.hashkey;
+        }
+    }
+    else
+    {
+        while(tp->wn_u2.next != node)
+        {
+            tp = tp->wn_u2.next;
+        }
+
+        tp->wn_u2.next = node->wn_u2.next;
+    }
+}
+
+/// Forget the lists in the compression hashtables. Needed before the trees
+/// are written, that reuses the hash key fields, and when the tree was
+/// changed without tree_add_word().
+static void wordtree_compress_reset(spellinfo_st *spin)
+{
+    hash_clear(&spin->si_foldht);
+    hash_init(&spin->si_foldht);
+    hash_clear(&spin->si_keepht);
+    hash_init(&spin->si_keepht);
+    spin->si_compgen++;
+}
+
 /// Compress a tree: find tails that are identical and can be shared.
+///
+/// For the case-folded and keep-case trees the hashtable is kept, the next
+/// time only the lists changed by tree_add_word() since are compressed.
+/// Compressing the whole tree again each time made building a large word
+/// list with a low 'mkspellmem' very slow. The result is the same: every
+/// list is compared with all the others either way.
 static void wordtree_compress(spellinfo_st *spin, wordnode_st *root)
 {
-    hashtable_st ht;
+    hashtable_st tmp_ht;
+    hashtable_st *ht = wordtree_ht(spin, root);
+    int compgen = spin->si_compgen;
     int n;
     int tot = 0;
     int perc;
@@ -5374,8 +5741,14 @@ static void wordtree_compress(spellinfo_st *spin, wordnode_st *root)
     // The first sibling is the start of the tree.
     if(root->wn_sibling != NULL)
     {
-        hash_init(&ht);
-        n = node_compress(spin, root->wn_sibling, &ht, &tot);
+        if(ht == NULL)
+        {
+            hash_init(&tmp_ht);
+            ht = &tmp_ht;
+            compgen = 0;
+        }
+
+        n = node_compress(spin, root->wn_sibling, ht, compgen, &tot);
 
     #ifndef SPELL_PRINTTREE
         if(spin->si_verbose || p_verbose > 2)
@@ -5405,7 +5778,10 @@ static void wordtree_compress(spellinfo_st *spin, wordnode_st *root)
         spell_print_tree(root->wn_sibling);
         #endif
 
-        hash_clear(&ht);
+        if(ht == &tmp_ht)
+        {
+            hash_clear(&tmp_ht);
+        }
     }
 }
 
@@ -5415,11 +5791,14 @@ static void wordtree_compress(spellinfo_st *spin, wordnode_st *root)
 /// @param spin
 /// @param node
 /// @param ht
-/// @param tot   total count of nodes before compressing
-///              incremented while going through the tree
+/// @param compgen  "si_compgen" when @b ht is kept between compressions,
+///                 zero otherwise
+/// @param tot      total count of nodes before compressing
+///                 incremented while going through the tree
 static int node_compress(spellinfo_st *spin,
                          wordnode_st *node,
                          hashtable_st *ht,
+                         int compgen,
                          int *tot)
 {
     wordnode_st *np;
@@ -5441,8 +5820,15 @@ static int node_compress(spellinfo_st *spin,
 
         if((child = np->wn_child) != NULL)
         {
+            // A child in the hashtable didn't change since it was
+            // compressed, its hashkey is still valid.
+            if(compgen != 0 && child->wn_compgen == compgen)
+            {
+                continue;
+            }
+
             // Compress the child first. This fills hashkey.
-            compressed += node_compress(spin, child, ht, tot);
+            compressed += node_compress(spin, child, ht, compgen, tot);
 
             // Try to find an identical child.
             hash = hash_hash(child->wn_u1.hashkey);
@@ -5476,12 +5862,15 @@ static int node_compress(spellinfo_st *spin,
                     tp = HI2WN(hi);
                     child->wn_u2.next = tp->wn_u2.next;
                     tp->wn_u2.next = child;
+                    child->wn_compgen = compgen;
                 }
             }
             else
             {
                 // No other child has this hash value, add it to the hashtable.
+                child->wn_u2.next = NULL;
                 hash_add_item(ht, hi, child->wn_u1.hashkey, hash);
+                child->wn_compgen = compgen;
             }
         }
     }
@@ -5572,11 +5961,33 @@ static int write_vim_spell(spellinfo_st *spin, uchar_kt *fname)
 {
     int retval = OK;
     int regionmask;
-    FILE *fd = mch_fopen((char *)fname, "w");
+    size_t nodecounts[3] = { 0, 0, 0 }; // for <TREEIMAGE>
+
+    // The file may be mapped by this or another process, see
+    // spell_map_trees(). Truncating it would break the mapping, write a
+    // new file next to it and rename that over it when done. For a symlink
+    // the file it points to is replaced.
+    uchar_kt *destname = fname;
+
+#ifdef HAVE_FUN_READLINK
+    uchar_kt linkname[MAXPATHL];
+
+    if(resolve_symlink(fname, linkname) == OK)
+    {
+        destname = linkname;
+    }
+#endif
+
+    size_t tmplen = ustrlen(destname) + 5;
+    uchar_kt *tmpname = xmalloc(tmplen);
+    vim_snprintf((char *)tmpname, tmplen, "%s.tmp", destname);
+
+    FILE *fd = mch_fopen((char *)tmpname, "w");
 
     if(fd == NULL)
     {
-        EMSG2(_(e_notopen), fname);
+        EMSG2(_(e_notopen), tmpname);
+        xfree(tmpname);
         return FAIL;
     }
 
@@ -5985,6 +6396,8 @@ static int write_vim_spell(spellinfo_st *spin, uchar_kt *fname)
         size_t nodecount = (size_t)put_node(NULL, tree, 0,
                                             regionmask, round == 3);
 
+        nodecounts[round - 1] = nodecount;
+
         // number of nodes in 4 bytes
         put_bytes(fd, nodecount, 4); // <nodecount>
         assert(nodecount + nodecount * sizeof(int) < INT_MAX);
@@ -6010,11 +6423,35 @@ theend:
         retval = FAIL;
     }
 
+    // <TREEIMAGE>
+    if(retval == OK && spell_write_tree_image(tmpname, nodecounts) == FAIL)
+    {
+        retval = FAIL;
+    }
+
+    if(retval == OK)
+    {
+        // Keep the permissions of the file that is replaced.
+        int32_t perm = os_getperm((const char *)destname);
+
+        if(perm >= 0)
+        {
+            (void)os_setperm((const char *)tmpname, perm);
+        }
+
+        if(os_rename(tmpname, destname) == FAIL)
+        {
+            retval = FAIL;
+        }
+    }
+
     if(retval == FAIL)
     {
+        (void)os_remove((char *)tmpname);
         EMSG(_(e_write));
     }
 
+    xfree(tmpname);
     return retval;
 }
 
@@ -6270,6 +6707,7 @@ static void spell_make_sugfile(spellinfo_st *spin, uchar_kt *wfname)
     spin->si_free_count = 0;
     spin->si_first_free = NULL;
     spin->si_foldwcount = 0;
+    wordtree_compress_reset(spin);
 
     // Go through the trie of good words, soundfold each word
     // and add it to the soundfold trie.
@@ -6292,9 +6730,12 @@ static void spell_make_sugfile(spellinfo_st *spin, uchar_kt *wfname)
     smsg(_("Number of words after soundfolding: %" PRId64),
          (int64_t)spin->si_spellbuf->b_ml.ml_line_count);
 
-    // Compress the soundfold trie.
+    // Compress the soundfold trie. sug_maketable() changed the word ends,
+    // compress all of it.
     spell_message(spin, (uchar_kt *)_(msg_compressing));
+    wordtree_compress_reset(spin);
     wordtree_compress(spin, spin->si_foldroot);
+    wordtree_compress_reset(spin);
 
     // Write the .sug file.
     // Make the file name by changing ".spl" to ".sug".
@@ -6314,6 +6755,7 @@ theend:
         slang_free(slang);
     }
 
+    wordtree_compress_reset(spin);
     free_blocks(spin->si_blocks);
     close_spellbuf(spin->si_spellbuf);
 }
@@ -6702,6 +7144,9 @@ static void mkspell(int fcount,
     ga_init(&spin.si_prefcond, (int)sizeof(uchar_kt *), 50);
 
     hash_init(&spin.si_commonwords);
+    hash_init(&spin.si_foldht);
+    hash_init(&spin.si_keepht);
+    spin.si_compgen = 1;
 
     // start compound ID at first maximum
     spin.si_newcompID = 127;
@@ -6890,6 +7335,9 @@ static void mkspell(int fcount,
             wordtree_compress(&spin, spin.si_prefroot);
         }
 
+        // Writing the trees uses the hash key fields.
+        wordtree_compress_reset(&spin);
+
         if(!error && !got_int)
         {
             // Write the info in the spell file.
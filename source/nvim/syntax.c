@@ -33,6 +33,7 @@
 #include "nvim/macros.h"
 #include "nvim/regexp.h"
 #include "nvim/screen.h"
+#include "nvim/spell.h"
 #include "nvim/strings.h"
 #include "nvim/syntax_defs.h"
 #include "nvim/terminal.h"
@@ -3706,6 +3707,7 @@ void reset_synblock(win_st *wp)
     if(wp->w_s != &wp->w_buffer->b_s)
     {
         syntax_clear(wp->w_s);
+        spell_cache_free(wp->w_s);
         xfree(wp->w_s);
         wp->w_s = &wp->w_buffer->b_s;
     }
@@ -8299,6 +8301,7 @@ int get_attr_entry(attrinfo_st *aep)
 void clear_hl_tables(void)
 {
     ga_clear(&attr_table);
+    screen_decor_changed();
 }
 
 /// Combine special attributes (e.g., for spelling)
@@ -8984,6 +8987,7 @@ void highlight_changed(void)
     int id_S = -1;
     int hlcnt;
     need_highlight_changed = FALSE;
+    screen_decor_changed();
 
     // Translate builtin highlight groups into attributes for quick lookup.
     for(int hlf = 0; hlf < (int)HLF_COUNT; hlf++)
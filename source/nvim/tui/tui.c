@@ -39,11 +39,18 @@
 #include "nvim/syntax.h"
 #include "nvim/macros.h"
 
-// Space reserved in the output buffer to restore the cursor to normal when
-// flushing. No existing terminal will require 32 bytes to do that.
-#define CNORM_COMMAND_MAX_SIZE    32
+// Initial size of the output buffer, it grows to hold the whole frame.
 #define OUTBUF_SIZE               0xffff
 
+// Number of cached SGR sequences, see update_attrs().
+#define SGR_CACHE_SIZE            64
+
+// Longest cursor motion considered, see cursor_move().
+#define MOTION_MAX                64
+
+// Colour of the cells of the terminal model that aren't known.
+#define UNKNOWN_COLOR             -2
+
 #define TOO_MANY_EVENTS           1000000
 #define STARTS_WITH(str, prefix)  (!memcmp(str, prefix, sizeof(prefix) - 1))
 
@@ -70,13 +77,31 @@ typedef struct rect_s
     int right;
 } rect_st;
 
+/// A cached SGR sequence: the attributes and the default colors it is for.
+typedef struct sgr_s
+{
+    uihl_attr_st attrs;
+    int fg;
+    int bg;
+    size_t len;     ///< length of "str", 0 for an unused entry
+    char str[116];
+} sgr_st;
+
+/// Output of unibi_format() into a fixed buffer.
+typedef struct fmtbuf_s
+{
+    char *buf;
+    size_t size;
+    size_t len;     ///< may exceed "size", then the output was cut
+} fmtbuf_st;
+
 typedef struct tui_data_s
 {
     ui_bridge_st *bridge;
     main_loop_st *loop;
     bool stop;
     unibi_var_t params[9];
-    char buf[OUTBUF_SIZE];
+    char *buf;
     size_t bufpos, bufsize;
     terminal_input_st input;
     uv_loop_t write_loop;
@@ -92,6 +117,10 @@ typedef struct tui_data_s
     signal_watcher_st winch_handle, cont_handle;
     bool cont_received;
     ugrid_st grid;
+    ugrid_st screen;    ///< what the terminal shows
+    int cursor_row;     ///< row of the terminal cursor, -1 for unknown
+    int cursor_col;     ///< column of the terminal cursor
+    sgr_st sgr_cache[SGR_CACHE_SIZE];
     kvec_t(rect_st) invalid_regions;
     int out_fd;
     bool scroll_region_is_full_screen;
@@ -115,6 +144,7 @@ typedef struct tui_data_s
         int enable_focus_reporting, disable_focus_reporting;
         int resize_screen;
         int reset_scroll_region;
+        int sync;
     } unibi_ext;
 } tuidata_st;
 
@@ -147,6 +177,7 @@ ui_st *tui_start(void)
     ui->scroll = tui_scroll;
     ui->highlight_set = tui_highlight_set;
     ui->put = tui_put;
+    ui->put_run = tui_put_run;
     ui->bell = tui_bell;
     ui->visual_bell = tui_visual_bell;
     ui->update_fg = tui_update_fg;
@@ -169,7 +200,8 @@ static void terminfo_start(ui_st *ui)
 
     data->scroll_region_is_full_screen = true;
     data->bufpos = 0;
-    data->bufsize = sizeof(data->buf) - CNORM_COMMAND_MAX_SIZE;
+    data->cursor_row = -1;
+    memset(data->sgr_cache, 0, sizeof(data->sgr_cache));
     data->showing_mode = kCsrShpIdxNormal;
     data->unibi_ext.enable_mouse = -1;
     data->unibi_ext.disable_mouse = -1;
@@ -182,6 +214,7 @@ static void terminfo_start(ui_st *ui)
     data->unibi_ext.disable_focus_reporting = -1;
     data->unibi_ext.resize_screen = -1;
     data->unibi_ext.reset_scroll_region = -1;
+    data->unibi_ext.sync = -1;
     data->out_fd = 1;
     data->out_isatty = os_isatty(data->out_fd);
     data->ut = unibi_from_env(); // setup unibilium
@@ -208,6 +241,15 @@ static void terminfo_start(ui_st *ui)
     // Set 't_Co' from the result of unibilium & fix_terminfo.
     t_colors = unibi_get_num(data->ut, unibi_max_colors);
 
+    // The "Sync" extension begins and ends synchronized updates.
+    for(size_t i = 0; i < unibi_count_ext_str(data->ut); i++)
+    {
+        if(xstrequal(unibi_get_ext_str_name(data->ut, i), "Sync"))
+        {
+            data->unibi_ext.sync = (int)i;
+        }
+    }
+
     // Enter alternate screen and clear
     // NOTE: Do this *before* changing terminal settings.
     unibi_out(ui, unibi_enter_ca_mode);
@@ -273,6 +315,7 @@ static void tui_terminal_start(ui_st *ui)
 
     data->print_attrs = EMPTY_ATTRS;
     ugrid_init(&data->grid);
+    ugrid_init(&data->screen);
     terminfo_start(ui);
     update_size(ui);
     signal_watcher_start(&data->winch_handle, sigwinch_cb, SIGWINCH);
@@ -287,6 +330,7 @@ static void tui_terminal_stop(ui_st *ui)
     signal_watcher_stop(&data->winch_handle);
     terminfo_stop(ui);
     ugrid_free(&data->grid);
+    ugrid_free(&data->screen);
 }
 
 static void tui_stop(ui_st *ui)
@@ -309,6 +353,8 @@ static void tui_main(ui_bridge_st *bridge, ui_st *ui)
     data->loop = &tui_loop;
 
     kv_init(data->invalid_regions);
+    data->buf = xmalloc(OUTBUF_SIZE);
+    data->bufsize = OUTBUF_SIZE;
 
     signal_watcher_init(data->loop, &data->winch_handle, ui);
     signal_watcher_init(data->loop, &data->cont_handle, data);
@@ -345,6 +391,7 @@ static void tui_main(ui_bridge_st *bridge, ui_st *ui)
 
     kv_destroy(data->invalid_regions);
 
+    xfree(data->buf);
     xfree(data);
     xfree(ui);
 }
@@ -386,6 +433,8 @@ static bool attrs_differ(uihl_attr_st a1, uihl_attr_st a2)
            || a1.reverse != a2.reverse;
 }
 
+/// The SGR sequences are expanded by unibilium once for each combination
+/// of attributes and default colors, then taken from "sgr_cache".
 static void update_attrs(ui_st *ui, uihl_attr_st attrs)
 {
     tuidata_st *data = ui->data;
@@ -396,12 +445,32 @@ static void update_attrs(ui_st *ui, uihl_attr_st attrs)
     }
 
     data->print_attrs = attrs;
-    unibi_out(ui, unibi_exit_attribute_mode);
 
     ugrid_st *grid = &data->grid;
     int fg = attrs.foreground != -1 ? attrs.foreground : grid->fg;
     int bg = attrs.background != -1 ? attrs.background : grid->bg;
 
+    unsigned hash = (unsigned)fg * 31u + (unsigned)bg;
+    hash = hash * 31u + (unsigned)(attrs.bold | attrs.italic << 1
+                                   | attrs.underline << 2
+                                   | attrs.undercurl << 3
+                                   | attrs.reverse << 4);
+    sgr_st *sgr = &data->sgr_cache[hash % SGR_CACHE_SIZE];
+
+    if(sgr->len > 0
+       && sgr->fg == fg
+       && sgr->bg == bg
+       && !attrs_differ(sgr->attrs, attrs))
+    {
+        out(ui, sgr->str, sgr->len);
+        return;
+    }
+
+    // The output buffer isn't flushed before the end of the frame, the
+    // new sequence can be taken from it.
+    size_t start = data->bufpos;
+    unibi_out(ui, unibi_exit_attribute_mode);
+
     if(ui->rgb)
     {
         if(fg != -1)
@@ -454,80 +523,17 @@ static void update_attrs(ui_st *ui, uihl_attr_st attrs)
     {
         unibi_out(ui, unibi_enter_reverse_mode);
     }
-}
-
-static void print_cell(ui_st *ui, ucell_st *ptr)
-{
-    update_attrs(ui, ptr->attrs);
-    out(ui, ptr->data, strlen(ptr->data));
-}
-
-static void clear_region(ui_st *ui, int top, int bot, int left, int right)
-{
-    tuidata_st *data = ui->data;
-    ugrid_st *grid = &data->grid;
-    bool cleared = false;
-
-    if(grid->bg == -1 && right == ui->width -1)
-    {
-        // Background is set to the default color and the right edge
-        // matches the screen end, try to use terminal codes for
-        // clearing the requested area.
-        uihl_attr_st clear_attrs = EMPTY_ATTRS;
-
-        clear_attrs.foreground = grid->fg;
-        clear_attrs.background = grid->bg;
-        update_attrs(ui, clear_attrs);
-
-        if(left == 0)
-        {
-            if(bot == ui->height - 1)
-            {
-                if(top == 0)
-                {
-                    unibi_out(ui, unibi_clear_screen);
-                }
-                else
-                {
-                    unibi_goto(ui, top, 0);
-                    unibi_out(ui, unibi_clr_eos);
-                }
-
-                cleared = true;
-            }
-        }
 
-        if(!cleared)
-        {
-            // iterate through each line and clear with clr_eol
-            for(int row = top; row <= bot; ++row)
-            {
-                unibi_goto(ui, row, left);
-                unibi_out(ui, unibi_clr_eol);
-            }
+    size_t len = data->bufpos - start;
 
-            cleared = true;
-        }
-    }
-
-    if(!cleared)
+    if(len <= sizeof(sgr->str))
     {
-        // could not clear using faster terminal
-        // codes, refresh the whole region
-        int currow = -1;
-
-        UGRID_FOREACH_CELL(grid, top, bot, left, right, {
-            if(currow != row)
-            {
-                unibi_goto(ui, row, col);
-                currow = row;
-            }
-            print_cell(ui, cell);
-        });
+        memcpy(sgr->str, data->buf + start, len);
+        sgr->len = len;
+        sgr->attrs = attrs;
+        sgr->fg = fg;
+        sgr->bg = bg;
     }
-
-    // restore cursor
-    unibi_goto(ui, grid->row, grid->col);
 }
 
 static bool can_use_scroll(ui_st *ui)
@@ -570,7 +576,8 @@ static void set_scroll_region(ui_st *ui)
         }
     }
 
-    unibi_goto(ui, grid->row, grid->col);
+    // Changing the scroll region moves the cursor.
+    data->cursor_row = -1;
 }
 
 static void reset_scroll_region(ui_st *ui)
@@ -608,13 +615,15 @@ static void reset_scroll_region(ui_st *ui)
         unibi_out(ui, data->unibi_ext.disable_lr_margin);
     }
 
-    unibi_goto(ui, grid->row, grid->col);
+    data->cursor_row = -1;
 }
 
 static void tui_resize(ui_st *ui, Integer width, Integer height)
 {
     tuidata_st *data = ui->data;
     ugrid_resize(&data->grid, (int)width, (int)height);
+    ugrid_resize(&data->screen, (int)width, (int)height);
+    screen_forget(ui, 0, (int)height - 1, 0, (int)width - 1);
 
     if(!got_winch) // Try to resize the terminal window.
     {
@@ -642,7 +651,29 @@ static void tui_clear(ui_st *ui)
     ugrid_st *grid = &data->grid;
 
     ugrid_clear(grid);
-    clear_region(ui, grid->top, grid->bot, grid->left, grid->right);
+
+    if(grid->bg == -1
+       && grid->top == 0 && grid->bot == ui->height - 1
+       && grid->left == 0 && grid->right == ui->width - 1)
+    {
+        // Clearing the screen costs less than any diff, the terminal
+        // model is cleared the same way.
+        uihl_attr_st clear_attrs = EMPTY_ATTRS;
+        clear_attrs.foreground = grid->fg;
+        clear_attrs.background = grid->bg;
+        update_attrs(ui, clear_attrs);
+        unibi_out(ui, unibi_clear_screen);
+        data->cursor_row = -1;
+
+        data->screen.fg = grid->fg;
+        data->screen.bg = grid->bg;
+        ugrid_set_scroll_region(&data->screen, grid->top, grid->bot,
+                                grid->left, grid->right);
+        ugrid_clear(&data->screen);
+        return;
+    }
+
+    invalidate(ui, grid->top, grid->bot, grid->left, grid->right);
 }
 
 static void tui_eol_clear(ui_st *ui)
@@ -650,16 +681,16 @@ static void tui_eol_clear(ui_st *ui)
     tuidata_st *data = ui->data;
     ugrid_st *grid = &data->grid;
 
+    invalidate(ui, grid->row, grid->row, grid->col, grid->right);
     ugrid_eol_clear(grid);
-    clear_region(ui, grid->row, grid->row, grid->col, grid->right);
 }
 
 static void tui_cursor_goto(ui_st *ui, Integer row, Integer col)
 {
     tuidata_st *data = ui->data;
 
+    // The terminal cursor is moved when flushing.
     ugrid_goto(&data->grid, (int)row, (int)col);
-    unibi_goto(ui, (int)row, (int)col);
 }
 
 cursor_shape_et tui_cursor_decode_shape(const char *shape_str)
@@ -919,6 +950,9 @@ static void tui_scroll(ui_st *ui, Integer count)
 
     ugrid_scroll(grid, (int)count, &clear_top, &clear_bot);
 
+    // The cells of the whole region moved, the diff finds what to draw.
+    invalidate(ui, grid->top, grid->bot, grid->left, grid->right);
+
     if(can_use_scroll(ui))
     {
         bool scroll_clears_to_current_colour =
@@ -967,26 +1001,27 @@ static void tui_scroll(ui_st *ui, Integer count)
             }
         }
 
-        // Restore terminal scroll region and cursor
+        // Restore terminal scroll region
         if(!data->scroll_region_is_full_screen)
         {
             reset_scroll_region(ui);
         }
 
-        unibi_goto(ui, grid->row, grid->col);
+        // The terminal model scrolls the same way.
+        ugrid_st *screen = &data->screen;
+        screen->fg = grid->fg;
+        screen->bg = grid->bg;
+        ugrid_set_scroll_region(screen, grid->top, grid->bot,
+                                grid->left, grid->right);
+        ugrid_scroll(screen, (int)count, &clear_top, &clear_bot);
 
         if(!scroll_clears_to_current_colour)
         {
-            // This is required because scrolling will leave
-            // wrong background in the cleared area on non-bge terminals.
-            clear_region(ui, clear_top, clear_bot, grid->left, grid->right);
+            // Scrolling leaves the default background
+            // in the cleared area on non-bce terminals.
+            screen_forget(ui, clear_top, clear_bot, grid->left, grid->right);
         }
     }
-    else
-    {
-        // Mark the entire scroll region as invalid for redrawing later
-        invalidate(ui, grid->top, grid->bot, grid->left, grid->right);
-    }
 }
 
 static void tui_highlight_set(ui_st *ui, uihl_attr_st attrs)
@@ -997,7 +1032,31 @@ static void tui_highlight_set(ui_st *ui, uihl_attr_st attrs)
 static void tui_put(ui_st *ui, String text)
 {
     tuidata_st *data = ui->data;
-    print_cell(ui, ugrid_put(&data->grid, (uint8_t *)text.data, text.size));
+    ugrid_st *grid = &data->grid;
+
+    invalidate(ui, grid->row, grid->row, grid->col, grid->col);
+    ugrid_put(grid, (uint8_t *)text.data, text.size);
+}
+
+static void tui_put_run(ui_st *ui, String cells)
+{
+    tuidata_st *data = ui->data;
+    ugrid_st *grid = &data->grid;
+    int col = grid->col;
+    size_t i = 0;
+
+    while(i < cells.size)
+    {
+        size_t len = strlen(cells.data + i);
+
+        ugrid_put(grid, (uint8_t *)cells.data + i, len);
+        i += len + 1;
+    }
+
+    if(grid->col > col)
+    {
+        invalidate(ui, grid->row, grid->row, col, grid->col - 1);
+    }
 }
 
 static void tui_bell(ui_st *ui)
@@ -1050,20 +1109,366 @@ static void tui_flush(ui_st *ui)
     while(kv_size(data->invalid_regions))
     {
         rect_st r = kv_pop(data->invalid_regions);
-        int currow = -1;
 
-        UGRID_FOREACH_CELL(grid, r.top, r.bot, r.left, r.right, {
-            if(currow != row)
+        for(int row = r.top; row <= r.bot; row++)
+        {
+            draw_row(ui, row, r.left, r.right);
+        }
+    }
+
+    cursor_move(ui, grid->row, grid->col);
+    flush_buf(ui, true);
+}
+
+static bool cells_equal(ucell_st *a, ucell_st *b)
+{
+    return !attrs_differ(a->attrs, b->attrs)
+           && b->attrs.foreground != UNKNOWN_COLOR
+           && strcmp(a->data, b->data) == 0;
+}
+
+/// The cell at @b col of @b cells is the right half of a double-width
+/// character.
+static bool is_continuation(ucell_st *cells, int col)
+{
+    return col > 0 && cells[col].data[0] == NUL && cells[col - 1].data[0] != NUL;
+}
+
+/// Bring the cells @b left .. @b right of @b row on the terminal up to date
+/// with the grid, drawing only the cells that differ from what the
+/// terminal shows.
+static void draw_row(ui_st *ui, int row, int left, int right)
+{
+    tuidata_st *data = ui->data;
+    ugrid_st *grid = &data->grid;
+    ucell_st *want = grid->cells[row];
+    ucell_st *have = data->screen.cells[row];
+    int end = right + 1; // the cells from "end" on are cleared
+
+    uihl_attr_st clear_attrs = EMPTY_ATTRS;
+    clear_attrs.foreground = grid->fg;
+    clear_attrs.background = grid->bg;
+
+    const char *el = unibi_get_str(data->ut, unibi_clr_eol);
+
+    if(el != NULL && grid->bg == -1 && right == ui->width - 1)
+    {
+        // Blank cells up to the end of the row are cleared with clr_eol,
+        // when more of them differ than it takes bytes.
+        int blank = ui->width;
+
+        while(blank > left
+              && strcmp(want[blank - 1].data, " ") == 0
+              && !attrs_differ(want[blank - 1].attrs, clear_attrs))
+        {
+            blank--;
+        }
+
+        while(blank <= right && cells_equal(&want[blank], &have[blank]))
+        {
+            blank++;
+        }
+
+        size_t ndiff = 0;
+
+        for(int col = blank; col <= right; col++)
+        {
+            ndiff += !cells_equal(&want[col], &have[col]);
+        }
+
+        if(ndiff > strlen(el))
+        {
+            end = blank;
+        }
+    }
+
+    for(int col = left; col < end; col++)
+    {
+        if(cells_equal(&want[col], &have[col]))
+        {
+            continue;
+        }
+
+        if(is_continuation(want, col))
+        {
+            col--;
+        }
+
+        col += draw_cell(ui, row, col) - 1;
+    }
+
+    if(end <= right)
+    {
+        cursor_move(ui, row, end);
+        update_attrs(ui, clear_attrs);
+        unibi_out(ui, unibi_clr_eol);
+
+        for(int col = end; col <= right; col++)
+        {
+            have[col] = want[col];
+        }
+    }
+}
+
+/// Draw the grid cell at @b row, @b col on the terminal.
+///
+/// @return the number of columns drawn, 2 for a double-width character
+static int draw_cell(ui_st *ui, int row, int col)
+{
+    tuidata_st *data = ui->data;
+    ucell_st *want = data->grid.cells[row];
+    ucell_st *have = data->screen.cells[row];
+    size_t len = strlen(want[col].data);
+    int width = 1;
+
+    cursor_move(ui, row, col);
+    update_attrs(ui, want[col].attrs);
+
+    // An empty cell that isn't the right half of a character would leave
+    // the cursor behind.
+    out(ui, len > 0 ? want[col].data : " ", len > 0 ? len : 1);
+    have[col] = want[col];
+
+    if(col + 1 < ui->width && is_continuation(want, col + 1))
+    {
+        have[col + 1] = want[col + 1];
+        width = 2;
+    }
+
+    // After the last column the cursor position depends on the terminal.
+    data->cursor_col = col + width;
+
+    if(data->cursor_col >= ui->width)
+    {
+        data->cursor_row = -1;
+    }
+
+    return width;
+}
+
+/// Mark the terminal cells @b top .. @b bot, @b left .. @b right as
+/// unknown, they are drawn again when they get invalid.
+static void screen_forget(ui_st *ui, int top, int bot, int left, int right)
+{
+    tuidata_st *data = ui->data;
+
+    UGRID_FOREACH_CELL(&data->screen, top, bot, left, right, {
+        cell->data[0] = NUL;
+        cell->attrs.foreground = UNKNOWN_COLOR;
+    });
+
+    data->cursor_row = -1;
+}
+
+/// Collect the output of unibi_format() in a fmtbuf_st.
+static void out_fmt(void *ctx, const char *str, size_t len)
+{
+    fmtbuf_st *fmt = ctx;
+
+    if(fmt->len + len <= fmt->size)
+    {
+        memcpy(fmt->buf + fmt->len, str, len);
+    }
+
+    fmt->len += len;
+}
+
+/// Add the terminfo string @b unibi_index, or extension string as for
+/// unibi_out(), with the parameter @b n to @b fmt, or mark @b fmt as cut
+/// when the terminal doesn't have it.
+static void fmt_cap(ui_st *ui, fmtbuf_st *fmt, int unibi_index, int n)
+{
+    tuidata_st *data = ui->data;
+    const char *str = NULL;
+
+    if(unibi_index >= 0)
+    {
+        if(unibi_index < unibi_string_begin_)
+        {
+            str = unibi_get_ext_str(data->ut, (unsigned)unibi_index);
+        }
+        else
+        {
+            str = unibi_get_str(data->ut, (unsigned)unibi_index);
+        }
+    }
+
+    if(str == NULL)
+    {
+        fmt->len = fmt->size + 1;
+        return;
+    }
+
+    unibi_var_t vars[26 + 26] = { { 0 } };
+    unibi_var_t params[9] = { { 0 } };
+    params[0].i = n;
+    unibi_format(vars, vars + 26, str, params, out_fmt, fmt, NULL, NULL);
+}
+
+/// Add a move of @b n cells with @b one for a single cell, unless it is -1,
+/// or @b parm for any count to @b fmt.
+static void fmt_move(ui_st *ui, fmtbuf_st *fmt, int one, int parm, int n)
+{
+    tuidata_st *data = ui->data;
+
+    if(n == 0)
+    {
+        return;
+    }
+
+    if(n == 1 && one >= 0 && unibi_get_str(data->ut, (unsigned)one) != NULL)
+    {
+        fmt_cap(ui, fmt, one, 0);
+        return;
+    }
+
+    fmt_cap(ui, fmt, parm, n);
+}
+
+/// Add the vertical and horizontal moves from @b from_row, @b from_col to
+/// @b row, @b col to @b fmt.
+static void fmt_moves(ui_st *ui, fmtbuf_st *fmt, int from_row, int from_col,
+                      int row, int col)
+{
+    if(row > from_row)
+    {
+        // A "cursor_down" that is a newline also goes to the first column,
+        // the output keeps ONLCR in raw mode.
+        int one = from_col == 0 || !cursor_down_is_newline(ui)
+                  ? unibi_cursor_down : -1;
+        fmt_move(ui, fmt, one, unibi_parm_down_cursor, row - from_row);
+    }
+    else
+    {
+        fmt_move(ui, fmt, unibi_cursor_up, unibi_parm_up_cursor,
+                 from_row - row);
+    }
+
+    if(col > from_col)
+    {
+        fmt_move(ui, fmt, unibi_cursor_right, unibi_parm_right_cursor,
+                 col - from_col);
+    }
+    else
+    {
+        fmt_move(ui, fmt, unibi_cursor_left, unibi_parm_left_cursor,
+                 from_col - col);
+    }
+}
+
+/// True if the "cursor_down" of the terminal is "\n" or "\r\n".
+static bool cursor_down_is_newline(ui_st *ui)
+{
+    tuidata_st *data = ui->data;
+    const char *str = unibi_get_str(data->ut, unibi_cursor_down);
+
+    return str != NULL && (xstrequal(str, "\n") || xstrequal(str, "\r\n"));
+}
+
+/// Move the terminal cursor to @b row, @b col with the fewest bytes: an
+/// absolute move, relative moves, a carriage return and relative moves,
+/// or writing the cells in between again.
+static void cursor_move(ui_st *ui, int row, int col)
+{
+    tuidata_st *data = ui->data;
+
+    if(data->cursor_row == row && data->cursor_col == col)
+    {
+        return;
+    }
+
+    char best[MOTION_MAX];
+    char buf[MOTION_MAX];
+    size_t best_len = 0;
+
+    data->params[0].i = row;
+    data->params[1].i = col;
+
+    fmtbuf_st fmt = { .buf = best, .size = sizeof(best), .len = 0 };
+    const char *cup = unibi_get_str(data->ut, unibi_cursor_address);
+
+    if(cup != NULL)
+    {
+        unibi_var_t vars[26 + 26] = { { 0 } };
+        unibi_format(vars, vars + 26, cup, data->params, out_fmt, &fmt,
+                     NULL, NULL);
+        best_len = fmt.len;
+    }
+    else
+    {
+        best_len = sizeof(best) + 1;
+    }
+
+    if(data->cursor_row >= 0)
+    {
+        fmtbuf_st rel = { .buf = buf, .size = sizeof(buf), .len = 0 };
+        fmt_moves(ui, &rel, data->cursor_row, data->cursor_col, row, col);
+
+        if(rel.len < best_len)
+        {
+            memcpy(best, buf, rel.len);
+            best_len = rel.len;
+        }
+
+        rel.len = 0;
+        fmt_cap(ui, &rel, unibi_carriage_return, 0);
+        fmt_moves(ui, &rel, data->cursor_row, 0, row, col);
+
+        if(rel.len < best_len)
+        {
+            memcpy(best, buf, rel.len);
+            best_len = rel.len;
+        }
+
+        if(row == data->cursor_row && col > data->cursor_col)
+        {
+            // The cells in between are drawn again as they are.
+            ucell_st *have = data->screen.cells[row];
+            size_t len = 0;
+            int c = data->cursor_col;
+
+            for(; c < col; c++)
+            {
+                size_t n = strlen(have[c].data);
+
+                if(n == 0
+                   || have[c].attrs.foreground == UNKNOWN_COLOR
+                   || is_continuation(have, c + 1)
+                   || attrs_differ(have[c].attrs, data->print_attrs)
+                   || len + n >= best_len)
+                {
+                    break;
+                }
+
+                memcpy(buf + len, have[c].data, n);
+                len += n;
+            }
+
+            if(c == col)
             {
-                unibi_goto(ui, row, col);
-                currow = row;
+                memcpy(best, buf, len);
+                best_len = len;
             }
-            print_cell(ui, cell);
-        });
+        }
     }
 
-    unibi_goto(ui, grid->row, grid->col);
-    flush_buf(ui, true);
+    if(best_len <= sizeof(best))
+    {
+        out(ui, best, best_len);
+    }
+    else if(cup != NULL)
+    {
+        unibi_goto(ui, row, col);
+    }
+    else
+    {
+        // The terminal can't go there, where the cursor is isn't known.
+        data->cursor_row = -1;
+        return;
+    }
+
+    data->cursor_row = row;
+    data->cursor_col = col;
 }
 
 #ifdef UNIX
@@ -1248,6 +1653,8 @@ static void unibi_goto(ui_st *ui, int row, int col)
     data->params[0].i = row;
     data->params[1].i = col;
     unibi_out(ui, unibi_cursor_address);
+    data->cursor_row = row;
+    data->cursor_col = col;
 }
 
 static void unibi_out(ui_st *ui, int unibi_index)
@@ -1278,11 +1685,16 @@ static void out(void *ctx, const char *str, size_t len)
 {
     ui_st *ui = ctx;
     tuidata_st *data = ui->data;
-    size_t available = data->bufsize - data->bufpos;
 
-    if(len > available)
+    // The frame goes out in one write, the buffer grows to hold it.
+    if(len > data->bufsize - data->bufpos)
     {
-        flush_buf(ui, false);
+        while(len > data->bufsize - data->bufpos)
+        {
+            data->bufsize *= 2;
+        }
+
+        data->buf = xrealloc(data->buf, data->bufsize);
     }
 
     memcpy(data->buf + data->bufpos, str, len);
@@ -1508,25 +1920,49 @@ end:
 static void flush_buf(ui_st *ui, bool toggle_cursor)
 {
     uv_write_t req;
-    uv_buf_t buf;
+    uv_buf_t bufs[3];
+    unsigned nbufs = 0;
     tuidata_st *data = ui->data;
 
     if(toggle_cursor && !data->busy)
     {
         // not busy and the cursor is invisible(see below).
         // Append a "cursor normal" command to the end of the buffer.
-        data->bufsize += CNORM_COMMAND_MAX_SIZE;
         unibi_out(ui, unibi_cursor_normal);
-        data->bufsize -= CNORM_COMMAND_MAX_SIZE;
     }
 
-    buf.base = data->buf;
-    buf.len = data->bufpos;
+    // Frames are wrapped in the synchronized update markers of "Sync",
+    // the parameter is 1 to begin and 2 to end.
+    char begin_buf[32];
+    char end_buf[32];
+    fmtbuf_st begin = { .buf = begin_buf, .size = sizeof(begin_buf), .len = 0 };
+    fmtbuf_st end = { .buf = end_buf, .size = sizeof(end_buf), .len = 0 };
+
+    if(toggle_cursor && data->unibi_ext.sync != -1)
+    {
+        fmt_cap(ui, &begin, data->unibi_ext.sync, 1);
+        fmt_cap(ui, &end, data->unibi_ext.sync, 2);
+    }
+
+    bool sync = begin.len > 0 && begin.len <= begin.size
+                && end.len > 0 && end.len <= end.size;
+
+    if(sync)
+    {
+        bufs[nbufs++] = uv_buf_init(begin_buf, (unsigned)begin.len);
+    }
+
+    bufs[nbufs++] = uv_buf_init(data->buf, (unsigned)data->bufpos);
+
+    if(sync)
+    {
+        bufs[nbufs++] = uv_buf_init(end_buf, (unsigned)end.len);
+    }
 
     uv_write(&req,
              STRUCT_CAST(uv_stream_t, &data->output_handle),
-             &buf,
-             1,
+             bufs,
+             nbufs,
              NULL);
 
     uv_run(&data->write_loop, UV_RUN_DEFAULT);
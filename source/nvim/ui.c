@@ -359,11 +359,20 @@ void ui_stop_highlight(void)
     set_highlight_args(current_attr_code);
 }
 
+/// Put "str" on the screen at the cursor position. The characters go
+/// to the UIs as runs of cells, a run ends at the end of the line and
+/// after a character of ambiguous width, where the cursor is resent.
 void ui_puts(uint8_t *str)
 {
     uint8_t *p = str;
     uint8_t c;
 
+    // Each cell is NUL terminated, at most two bytes per byte of "str".
+    char cells_buf[64];
+    size_t need = 2 * strlen((char *)str) + 1;
+    char *cells = need <= sizeof(cells_buf) ? cells_buf : xmalloc(need);
+    size_t size = 0;
+
     while((c = *p))
     {
         if(c < 0x20)
@@ -371,20 +380,35 @@ void ui_puts(uint8_t *str)
             abort();
         }
 
-        size_t clen = (size_t)mb_ptr2len(p);
+        if(size == 0)
+        {
+            // Position the cursor before "col" moves past the run.
+            flush_cursor_update();
+        }
 
-        ui_call_put((String) { .data = (char *)p, .size = clen });
+        size_t clen = (size_t)mb_ptr2len(p);
 
+        memcpy(cells + size, p, clen);
+        size += clen;
+        cells[size++] = NUL;
         col++;
 
         if(mb_ptr2cells(p) > 1)
         {
             // double cell character, blank the next cell
-            ui_call_put((String)STRING_INIT);
+            cells[size++] = NUL;
             col++;
         }
 
-        if(utf_ambiguous_width(utf_ptr2char(p)))
+        bool ambiguous = utf_ambiguous_width(utf_ptr2char(p));
+
+        if(ambiguous || col >= width)
+        {
+            ui_call_put_run((String) { .data = cells, .size = size });
+            size = 0;
+        }
+
+        if(ambiguous)
         {
             pending_cursor_update = true;
         }
@@ -396,6 +420,16 @@ void ui_puts(uint8_t *str)
 
         p += clen;
     }
+
+    if(size > 0)
+    {
+        ui_call_put_run((String) { .data = cells, .size = size });
+    }
+
+    if(cells != cells_buf)
+    {
+        xfree(cells);
+    }
 }
 
 void ui_putc(uint8_t c)
@@ -4,12 +4,15 @@
 /// Used by the built-in TUI and libnvim-based UIs.
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <limits.h>
+#include <string.h>
 
 #include "nvim/log.h"
 #include "nvim/main.h"
+#include "nvim/ascii.h"
 #include "nvim/nvim.h"
 #include "nvim/ui.h"
 #include "nvim/memory.h"
@@ -21,47 +24,46 @@
     #include "ui_bridge.c.generated.h"
 #endif
 
-#define UI_PTR(b) (((ui_bridge_st *)b)->ui)
+#ifdef _MSC_VER
+// volatile accesses have acquire and release semantics with /volatile:ms
+    #define RING_LOAD(p)      (*(volatile size_t *)(p))
+    #define RING_STORE(p, v)  (*(volatile size_t *)(p) = (v))
+#else
+    #define RING_LOAD(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define RING_STORE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
 
 #if NVIM_LOG_LEVEL_MIN <= DEBUG_LOG_LEVEL
 static size_t uilog_seen = 0;
-static argv_callback_ft uilog_event = NULL;
-
-#define UI_CALL(ui, name, argc, ...)                                           \
-    do                                                                         \
-    {                                                                          \
-        if(uilog_event == ui_bridge_##name##_event)                            \
-        {                                                                      \
-            uilog_seen++;                                                      \
-        }                                                                      \
-        else                                                                   \
-        {                                                                      \
-            if(uilog_seen > 0)                                                 \
-            {                                                                  \
-                DEBUG_LOG("UI bridge: ...%zu times", uilog_seen);              \
-            }                                                                  \
-            DEBUG_LOG("UI bridge: " STR(name));                                \
-            uilog_seen = 0;                                                    \
-            uilog_event = ui_bridge_##name##_event;                            \
-        }                                                                      \
-                                                                               \
-        ((ui_bridge_st *)ui)->scheduler(event_create(ui_bridge_##name##_event, \
-                                                     argc,                     \
-                                                     __VA_ARGS__),             \
-                                        UI_PTR(ui));                           \
-    }while(0)
+static uicmd_ft uilog_cmd = NULL;
+
+static void ui_bridge_log(uicmd_ft cmd, const char *name)
+{
+    if(uilog_cmd == cmd)
+    {
+        uilog_seen++;
+        return;
+    }
+
+    if(uilog_seen > 0)
+    {
+        DEBUG_LOG("UI bridge: ...%zu times", uilog_seen);
+    }
+
+    DEBUG_LOG("UI bridge: %s", name);
+    uilog_seen = 0;
+    uilog_cmd = cmd;
+}
+
+#define UI_CALL(ui, name)                                         \
+    (ui_bridge_log(ui_bridge_##name##_cmd, STR(name)),            \
+     ui_bridge_push((ui_bridge_st *)(ui), ui_bridge_##name##_cmd))
 #else
-/// Schedule a function call on the UI bridge thread.
-#define UI_CALL(ui, name, argc, ...)                                       \
-    ((ui_bridge_st *)ui)->scheduler(event_create(ui_bridge_##name##_event, \
-                                                 argc,                     \
-                                                 __VA_ARGS__),             \
-                                    UI_PTR(ui))
+/// Add a command for the UI thread, return it to fill in the arguments.
+#define UI_CALL(ui, name) \
+    ui_bridge_push((ui_bridge_st *)(ui), ui_bridge_##name##_cmd)
 #endif
 
-#define INT2PTR(i)   ((void *)(intptr_t)i)
-#define PTR2INT(p)   ((Integer)(intptr_t)p)
-
 #ifdef INCLUDE_GENERATED_DECLARATIONS
     #include "ui_events_bridge.generated.h"
 #endif
@@ -90,6 +92,7 @@ ui_st *ui_bridge_attach(ui_st *ui,
     rv->bridge.scroll = ui_bridge_scroll;
     rv->bridge.highlight_set = ui_bridge_highlight_set;
     rv->bridge.put = ui_bridge_put;
+    rv->bridge.put_run = ui_bridge_put_run;
     rv->bridge.bell = ui_bridge_bell;
     rv->bridge.visual_bell = ui_bridge_visual_bell;
     rv->bridge.update_fg = ui_bridge_update_fg;
@@ -106,6 +109,10 @@ ui_st *ui_bridge_attach(ui_st *ui,
         rv->bridge.ui_ext[i] = ui->ui_ext[i];
     }
 
+    rv->ring = xmalloc(UI_BRIDGE_RING_SIZE * sizeof(uicmd_st));
+    ga_init(&rv->arenas[0], 1, 4096);
+    ga_init(&rv->arenas[1], 1, 4096);
+
     rv->ui_main = ui_main;
     uv_mutex_init(&rv->mutex);
     uv_cond_init(&rv->cond);
@@ -142,11 +149,114 @@ static void ui_thread_run(void *data)
     bridge->ui_main(bridge, bridge->ui);
 }
 
+/// Get a command of @b bridge that runs @b exec on the UI thread.
+static uicmd_st *ui_bridge_push(ui_bridge_st *bridge, uicmd_ft exec)
+{
+    if(bridge->write - RING_LOAD(&bridge->read) == UI_BRIDGE_RING_SIZE)
+    {
+        // The ring is full: let the UI thread run all of it.
+        ui_bridge_publish(bridge);
+        ui_bridge_wait(bridge, bridge->write);
+    }
+
+    uicmd_st *cmd = &bridge->ring[bridge->write & (UI_BRIDGE_RING_SIZE - 1)];
+    bridge->write++;
+    cmd->exec = exec;
+    return cmd;
+}
+
+/// Copy @b str into the text arena of @b b being filled.
+static uitext_st ui_bridge_text(ui_st *b, String str)
+{
+    ui_bridge_st *bridge = (ui_bridge_st *)b;
+    garray_st *ga = &bridge->arenas[bridge->arena];
+    uitext_st text = { .pos = SIZE_MAX, .size = 0, .arena = bridge->arena };
+
+    if(str.data == NULL)
+    {
+        return text;
+    }
+
+    ga_grow(ga, (int)str.size + 1);
+    text.pos = (size_t)ga->ga_len;
+    text.size = str.size;
+
+    char *p = (char *)ga->ga_data + ga->ga_len;
+    memcpy(p, str.data, str.size);
+    p[str.size] = NUL;
+    ga->ga_len += (int)str.size + 1;
+
+    return text;
+}
+
+/// The String of @b text, on the UI thread of @b bridge.
+static String ui_bridge_string(ui_bridge_st *bridge, uitext_st text)
+{
+    if(text.pos == SIZE_MAX)
+    {
+        return (String)STRING_INIT;
+    }
+
+    char *data = bridge->arenas[text.arena].ga_data;
+    return (String){ .data = data + text.pos, .size = text.size };
+}
+
+/// Let the UI thread of @b bridge run the commands written so far.
+static void ui_bridge_publish(ui_bridge_st *bridge)
+{
+    if(bridge->write == bridge->published)
+    {
+        return;
+    }
+
+    RING_STORE(&bridge->published, bridge->write);
+    bridge->scheduler(event_create(ui_bridge_run_event, 1, bridge), bridge->ui);
+}
+
+/// Wait until the UI thread of @b bridge ran the commands before @b pos.
+static void ui_bridge_wait(ui_bridge_st *bridge, size_t pos)
+{
+    if(RING_LOAD(&bridge->read) >= pos)
+    {
+        return;
+    }
+
+    uv_mutex_lock(&bridge->mutex);
+
+    while(RING_LOAD(&bridge->read) < pos)
+    {
+        uv_cond_wait(&bridge->cond, &bridge->mutex);
+    }
+
+    uv_mutex_unlock(&bridge->mutex);
+}
+
+/// Run the published commands, on the UI thread.
+static void ui_bridge_run_event(void **argv)
+{
+    ui_bridge_st *bridge = argv[0];
+    size_t end = RING_LOAD(&bridge->published);
+    size_t pos = bridge->read;
+
+    while(pos != end)
+    {
+        uicmd_st *cmd = &bridge->ring[pos & (UI_BRIDGE_RING_SIZE - 1)];
+        cmd->exec(bridge, cmd);
+        pos++;
+    }
+
+    uv_mutex_lock(&bridge->mutex);
+    RING_STORE(&bridge->read, end);
+    uv_cond_signal(&bridge->cond);
+    uv_mutex_unlock(&bridge->mutex);
+}
+
 static void ui_bridge_stop(ui_st *b)
 {
     ui_bridge_st *bridge = (ui_bridge_st *)b;
     bool stopped = bridge->stopped = false;
-    UI_CALL(b, stop, 1, b);
+    (void)UI_CALL(b, stop);
+    ui_bridge_publish(bridge);
 
     for(;;)
     {
@@ -165,34 +275,57 @@ static void ui_bridge_stop(ui_st *b)
     uv_thread_join(&bridge->ui_thread);
     uv_mutex_destroy(&bridge->mutex);
     uv_cond_destroy(&bridge->cond);
+    ga_clear(&bridge->arenas[0]);
+    ga_clear(&bridge->arenas[1]);
+    xfree(bridge->ring);
     ui_detach_impl(b);
     xfree(b);
 }
-static void ui_bridge_stop_event(void **argv)
+static void ui_bridge_stop_cmd(ui_bridge_st *bridge,
+                               uicmd_st *FUNC_ARGS_UNUSED_MATCH(cmd))
 {
-    ui_st *ui = UI_PTR(argv[0]);
+    ui_st *ui = bridge->ui;
     ui->stop(ui);
 }
 
 static void ui_bridge_highlight_set(ui_st *b, uihl_attr_st attrs)
 {
-    uihl_attr_st *a = xmalloc(sizeof(uihl_attr_st));
-    *a = attrs;
-    UI_CALL(b, highlight_set, 2, b, a);
+    UI_CALL(b, highlight_set)->data.attrs = attrs;
+}
+static void ui_bridge_highlight_set_cmd(ui_bridge_st *bridge, uicmd_st *cmd)
+{
+    ui_st *ui = bridge->ui;
+    ui->highlight_set(ui, cmd->data.attrs);
+}
+
+/// Batches of commands end at flushes. The arena of the text of the
+/// previous batch is reused once the UI thread ran it, so the main thread
+/// gets at most one flush ahead of the UI thread.
+static void ui_bridge_flush(ui_st *b)
+{
+    ui_bridge_st *bridge = (ui_bridge_st *)b;
+    (void)UI_CALL(b, flush);
+
+    ui_bridge_wait(bridge, bridge->published);
+    ui_bridge_publish(bridge);
+
+    bridge->arena ^= 1;
+    bridge->arenas[bridge->arena].ga_len = 0;
 }
-static void ui_bridge_highlight_set_event(void **argv)
+static void ui_bridge_flush_cmd(ui_bridge_st *bridge,
+                                uicmd_st *FUNC_ARGS_UNUSED_MATCH(cmd))
 {
-    ui_st *ui = UI_PTR(argv[0]);
-    ui->highlight_set(ui, *((uihl_attr_st *)argv[1]));
-    xfree(argv[1]);
+    ui_st *ui = bridge->ui;
+    ui->flush(ui);
 }
 
 static void ui_bridge_suspend(ui_st *b)
 {
     ui_bridge_st *data = (ui_bridge_st *)b;
+    (void)UI_CALL(b, suspend);
     uv_mutex_lock(&data->mutex);
-    UI_CALL(b, suspend, 1, b);
     data->ready = false;
+    ui_bridge_publish(data);
 
     // suspend the main thread until
     // CONTINUE is called by the UI thread
@@ -203,8 +336,9 @@ static void ui_bridge_suspend(ui_st *b)
 
     uv_mutex_unlock(&data->mutex);
 }
-static void ui_bridge_suspend_event(void **argv)
+static void ui_bridge_suspend_cmd(ui_bridge_st *bridge,
+                                  uicmd_st *FUNC_ARGS_UNUSED_MATCH(cmd))
 {
-    ui_st *ui = UI_PTR(argv[0]);
+    ui_st *ui = bridge->ui;
     ui->suspend(ui);
 }
@@ -6,11 +6,41 @@
 #include <uv.h>
 
 #include "nvim/ui.h"
+#include "nvim/garray.h"
 #include "nvim/event/defs.h"
 
+/// Number of commands in the ring of a UI bridge, a power of two.
+#define UI_BRIDGE_RING_SIZE  4096
+
 typedef struct ui_bridge_s ui_bridge_st;
 typedef void(*ui_main_ft)(ui_bridge_st *bridge, ui_st *ui);
 
+/// A String argument of a UI command, kept in a text arena of the bridge.
+typedef struct uitext_s
+{
+    size_t pos;     ///< offset in the arena, SIZE_MAX for a NULL string
+    size_t size;    ///< size, without the terminating NUL
+    int arena;      ///< index of the arena
+} uitext_st;
+
+typedef struct uicmd_s uicmd_st;
+typedef void(*uicmd_ft)(ui_bridge_st *bridge, uicmd_st *cmd);
+
+/// A UI callback to run on the UI thread, with its arguments.
+struct uicmd_s
+{
+    uicmd_ft exec;          ///< runs the callback
+
+    union
+    {
+        Integer args[4];    ///< Integer and Boolean arguments
+        uihl_attr_st attrs; ///< highlight_set() attributes
+    } data;
+
+    uitext_st text;         ///< String argument
+    Array array;            ///< Array argument, freed by "exec"
+};
+
 struct ui_bridge_s
 {
     /// actual UI passed to nvim_ui_attach()
@@ -40,6 +70,20 @@ struct ui_bridge_s
     // set by the UI thread as a signal that it will no longer send
     // messages to the main thread.
     bool stopped;
+
+    // The main thread writes the UI callbacks into a ring of commands,
+    // the UI thread runs them. Only the "published" and "read" counts are
+    // shared, the UI thread is woken once per batch of commands.
+    uicmd_st *ring;         ///< UI_BRIDGE_RING_SIZE commands
+    size_t write;           ///< commands written by the main thread
+    size_t published;       ///< commands the UI thread may run
+    size_t read;            ///< commands the UI thread has run
+
+    // The text of the commands of a flush goes into one arena, the next
+    // flush uses the other one. An arena is reused after the UI thread
+    // ran all the commands that refer to it.
+    garray_st arenas[2];
+    int arena;              ///< index of the arena being filled
 };
 
 #define CONTINUE(b)                          \
@@ -5227,6 +5227,9 @@ void win_free_lsize(win_st *wp)
     {
         xfree(wp->w_lines);
         wp->w_lines = NULL;
+        line_cache_free(wp);
+        vcol_index_free(wp);
+        plines_cache_free(wp);
     }
 }
 
@@ -7354,6 +7357,7 @@ int match_add(win_st *wp,
             m->pos.toplnum = toplnum;
             m->pos.botlnum = botlnum;
             rtype = VALID;
+            line_cache_invalidate(wp, toplnum, botlnum);
         }
     }
 
@@ -7379,6 +7383,12 @@ int match_add(win_st *wp,
     }
 
     m->next = cur;
+
+    if(rtype != VALID)
+    {
+        line_cache_invalidate(wp, 1, MAXLNUM);
+    }
+
     redraw_later(rtype);
 
     return id;
@@ -7460,6 +7470,11 @@ int match_delete(win_st *wp, int id, int perr)
         }
 
         rtype = VALID;
+        line_cache_invalidate(wp, cur->pos.toplnum, cur->pos.botlnum);
+    }
+    else
+    {
+        line_cache_invalidate(wp, 1, MAXLNUM);
     }
 
     xfree(cur);
@@ -7482,6 +7497,7 @@ void clear_matches(win_st *wp)
         wp->w_match_head = m;
     }
 
+    line_cache_invalidate(wp, 1, MAXLNUM);
     redraw_later(SOME_VALID);
 }
 
@@ -0,0 +1,630 @@
+/// @file plugins/bin/snail/bench/snailbench.cpp
+///
+/// Rendering benchmark of snail: replays msgpack redraw streams into a
+/// Shell without any Nvim process, by default on the offscreen platform.
+///
+/// Every redraw notification is a frame, the time and allocations are
+/// reported for the three steps of a frame:
+///
+/// - decode: reading and unpacking the stream, and decoding redraw
+///   notifications into RedrawBatch
+/// - apply: Shell::handleRedrawBatch(), updating the shell contents
+/// - paint: the paint events the batch caused
+///
+/// Without arguments the built in scenarios run: full redraws, scrolling
+/// and insert mode typing. Streams of real sessions are recorded with
+///
+///     GKIDE_SNAIL_RECORD=scroll.msgpack snail
+///
+/// and replayed with `snail-bench scroll.msgpack`, the scenario is named
+/// after the file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QAtomicInteger>
+#include <msgpack.h>
+
+#include "plugins/bin/snail/attributes.h"
+#include "plugins/bin/snail/shell.h"
+#include "plugins/bin/snail/msgpackiodevice.h"
+#include "plugins/bin/snail/redrawdecoder.h"
+
+/// Allocations so far, counted on glibc only
+static QBasicAtomicInteger<quint64> s_allocations = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+#if defined(__GLIBC__)
+// Count the allocations by wrapping the glibc allocator, this covers
+// Qt containers as well as operator new
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    s_allocations.fetchAndAddRelaxed(1);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    s_allocations.fetchAndAddRelaxed(1);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    s_allocations.fetchAndAddRelaxed(1);
+    return __libc_realloc(ptr, size);
+}
+
+#define ALLOC_COUNTING  1
+#else
+#define ALLOC_COUNTING  0
+#endif
+
+using namespace SnailNvimQt;
+
+/// Read size of the replayed stream, the size of a socket read
+#define REPLAY_CHUNK_SIZE   (64*1024)
+
+/// A sequential device serving a recorded stream, one chunk at a time.
+/// Anything written to it is dropped.
+class ReplayDevice: public QIODevice
+{
+public:
+    ReplayDevice(const QByteArray &data)
+        :m_data(data), m_pos(0), m_end(0)
+    {
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    virtual bool isSequential(void) const Q_DECL_OVERRIDE
+    {
+        return true;
+    }
+
+    virtual qint64 bytesAvailable(void) const Q_DECL_OVERRIDE
+    {
+        return m_end - m_pos + QIODevice::bytesAvailable();
+    }
+
+    /// Make the next @b size bytes readable, returns false at the end
+    bool feed(qint64 size)
+    {
+        if(m_end >= m_data.size())
+        {
+            return false;
+        }
+
+        m_end = qMin(m_end + size, (qint64)m_data.size());
+        emit readyRead();
+        return true;
+    }
+
+    void rewind(void)
+    {
+        m_pos = m_end = 0;
+    }
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxlen) Q_DECL_OVERRIDE
+    {
+        qint64 len = qMin(maxlen, m_end - m_pos);
+        memcpy(data, m_data.constData() + m_pos, len);
+        m_pos += len;
+        return len;
+    }
+
+    virtual qint64 writeData(const char *VATTR_UNUSED_MATCH(data),
+                             qint64 len) Q_DECL_OVERRIDE
+    {
+        return len;
+    }
+
+private:
+    QByteArray m_data;
+    qint64 m_pos;
+    /// End of the bytes fed so far
+    qint64 m_end;
+};
+
+/// Decodes redraw notifications in the calling thread and keeps the
+/// batches until they are applied
+class ReplayHandler: public MsgpackNotificationHandler
+{
+public:
+    virtual bool handleNotification(MsgpackIODevice *dev,
+                                    msgpack_unpacked &msg) Q_DECL_OVERRIDE
+    {
+        RedrawBatch batch;
+        m_worker.decodeNotification(dev->textCodec(),
+                                    msg.data.via.array.ptr[2], batch);
+        RedrawDecoder::decodeGeneric(dev, batch);
+
+        if(!batch.isEmpty())
+        {
+            m_batches.append(batch);
+        }
+
+        return true;
+    }
+
+    QVector<RedrawBatch> takeBatches(void)
+    {
+        QVector<RedrawBatch> batches;
+        batches.swap(m_batches);
+        return batches;
+    }
+
+private:
+    RedrawWorker m_worker;
+    QVector<RedrawBatch> m_batches;
+};
+
+/// Writes the redraw notifications of the built in scenarios. The
+/// updates of a frame are counted as they are written.
+class StreamWriter
+{
+public:
+    StreamWriter(void)
+        :m_updates(0)
+    {
+        msgpack_sbuffer_init(&m_stream);
+        msgpack_sbuffer_init(&m_frame);
+        msgpack_packer_init(&m_pk, &m_frame, msgpack_sbuffer_write);
+    }
+
+    ~StreamWriter()
+    {
+        msgpack_sbuffer_destroy(&m_stream);
+        msgpack_sbuffer_destroy(&m_frame);
+    }
+
+    /// Write the updates since the last frame as a redraw notification,
+    /// [2, "redraw", [updates...]]
+    void endFrame(void)
+    {
+        msgpack_packer pk;
+        msgpack_packer_init(&pk, &m_stream, msgpack_sbuffer_write);
+        msgpack_pack_array(&pk, 3);
+        msgpack_pack_int(&pk, 2);
+        packStr(&pk, "redraw");
+        msgpack_pack_array(&pk, m_updates);
+        msgpack_sbuffer_write(&m_stream, m_frame.data, m_frame.size);
+
+        msgpack_sbuffer_clear(&m_frame);
+        m_updates = 0;
+    }
+
+    QByteArray data(void) const
+    {
+        return QByteArray(m_stream.data, (int)m_stream.size);
+    }
+
+    void resize(int cols, int rows)
+    {
+        update("resize", 1);
+        msgpack_pack_array(&m_pk, 2);
+        msgpack_pack_int(&m_pk, cols);
+        msgpack_pack_int(&m_pk, rows);
+    }
+
+    /// update_fg, update_bg or update_sp
+    void updateColor(const char *name, qint64 rgb)
+    {
+        update(name, 1);
+        msgpack_pack_array(&m_pk, 1);
+        msgpack_pack_int64(&m_pk, rgb);
+    }
+
+    void clear(void)
+    {
+        update("clear", 1);
+        msgpack_pack_array(&m_pk, 0);
+    }
+
+    void eolClear(void)
+    {
+        update("eol_clear", 1);
+        msgpack_pack_array(&m_pk, 0);
+    }
+
+    void cursorGoto(int row, int col)
+    {
+        update("cursor_goto", 1);
+        msgpack_pack_array(&m_pk, 2);
+        msgpack_pack_int(&m_pk, row);
+        msgpack_pack_int(&m_pk, col);
+    }
+
+    /// highlight_set with a foreground color, -1 for the default
+    /// attributes
+    void highlightSet(qint64 fg, bool bold=false)
+    {
+        update("highlight_set", 1);
+        msgpack_pack_array(&m_pk, 1);
+
+        if(fg == -1)
+        {
+            msgpack_pack_map(&m_pk, 0);
+            return;
+        }
+
+        msgpack_pack_map(&m_pk, bold ? 2 : 1);
+        packStr(&m_pk, "foreground");
+        msgpack_pack_int64(&m_pk, fg);
+
+        if(bold)
+        {
+            packStr(&m_pk, "bold");
+            msgpack_pack_true(&m_pk);
+        }
+    }
+
+    /// One put update with one call per character, as Nvim sends it
+    void put(const QByteArray &text)
+    {
+        update("put", text.size());
+
+        for(int i=0; i<text.size(); i++)
+        {
+            msgpack_pack_array(&m_pk, 1);
+            msgpack_pack_str(&m_pk, 1);
+            msgpack_pack_str_body(&m_pk, text.constData() + i, 1);
+        }
+    }
+
+    void scroll(int count)
+    {
+        update("scroll", 1);
+        msgpack_pack_array(&m_pk, 1);
+        msgpack_pack_int(&m_pk, count);
+    }
+
+    void setScrollRegion(int top, int bot, int left, int right)
+    {
+        update("set_scroll_region", 1);
+        msgpack_pack_array(&m_pk, 4);
+        msgpack_pack_int(&m_pk, top);
+        msgpack_pack_int(&m_pk, bot);
+        msgpack_pack_int(&m_pk, left);
+        msgpack_pack_int(&m_pk, right);
+    }
+
+private:
+    static void packStr(msgpack_packer *pk, const char *str)
+    {
+        size_t len = strlen(str);
+        msgpack_pack_str(pk, len);
+        msgpack_pack_str_body(pk, str, len);
+    }
+
+    /// Start an update [name, calls...], the caller packs the calls
+    void update(const char *name, int calls)
+    {
+        msgpack_pack_array(&m_pk, calls + 1);
+        packStr(&m_pk, name);
+        m_updates++;
+    }
+
+    msgpack_sbuffer m_stream;
+    msgpack_sbuffer m_frame;
+    msgpack_packer m_pk; ///< packs into m_frame
+    int m_updates;
+};
+
+/// Some source code like text of @b cols characters, varying by @b seed
+static QByteArray lineText(int seed, int cols)
+{
+    static const char code[] =
+        "    for(int i=0; i<count; i++) { total += values[i] * 42; } "
+        "// accumulate the weighted values ";
+    static const int len = sizeof(code) - 1;
+    QByteArray line;
+
+    for(int i=0; i<cols; i++)
+    {
+        line.append(code[(seed * 7 + i) % len]);
+    }
+
+    return line;
+}
+
+/// The color of the text in row @b row
+static qint64 rowColor(int row)
+{
+    static const qint64 colors[] =
+    {
+        0xd0d0d0, 0x87afd7, 0xafd787, 0xd7af5f,
+    };
+
+    return colors[row % 4];
+}
+
+/// First frame of the scenarios: a grid filled with text
+static void startScenario(StreamWriter &w, int cols, int rows)
+{
+    w.resize(cols, rows);
+    w.updateColor("update_fg", 0xd0d0d0);
+    w.updateColor("update_bg", 0x1c1c1c);
+    w.clear();
+
+    for(int row=0; row<rows; row++)
+    {
+        w.cursorGoto(row, 0);
+        w.highlightSet(rowColor(row));
+        w.put(lineText(row, cols));
+    }
+
+    w.highlightSet(-1);
+    w.cursorGoto(0, 0);
+    w.endFrame();
+}
+
+/// Every frame redraws the whole grid, e.g. switching buffers
+static QByteArray redrawScenario(int cols, int rows)
+{
+    StreamWriter w;
+    startScenario(w, cols, rows);
+
+    for(int frame=1; frame<100; frame++)
+    {
+        w.highlightSet(-1);
+        w.clear();
+
+        for(int row=0; row<rows; row++)
+        {
+            w.cursorGoto(row, 0);
+            w.highlightSet(rowColor(row + frame), row % 5 == 0);
+            w.put(lineText(row + frame, cols));
+        }
+
+        w.highlightSet(-1);
+        w.cursorGoto(0, 0);
+        w.endFrame();
+    }
+
+    return w.data();
+}
+
+/// Every frame scrolls by one line above the status line, e.g. holding
+/// CTRL-E
+static QByteArray scrollScenario(int cols, int rows)
+{
+    StreamWriter w;
+    startScenario(w, cols, rows);
+
+    for(int frame=1; frame<500; frame++)
+    {
+        w.setScrollRegion(0, rows - 2, 0, cols - 1);
+        w.scroll(1);
+        w.setScrollRegion(0, rows - 1, 0, cols - 1);
+        w.cursorGoto(rows - 2, 0);
+        w.highlightSet(rowColor(frame));
+        w.put(lineText(rows + frame, cols - 10));
+        w.highlightSet(-1);
+        w.eolClear();
+        w.cursorGoto(rows - 2, 0);
+        w.endFrame();
+    }
+
+    return w.data();
+}
+
+/// Every frame inserts a character, e.g. typing in insert mode
+static QByteArray typingScenario(int cols, int rows)
+{
+    StreamWriter w;
+    startScenario(w, cols, rows);
+
+    const QByteArray text = lineText(0, cols);
+    int row = 0;
+    int col = 0;
+
+    for(int frame=1; frame<2000; frame++)
+    {
+        w.cursorGoto(row, col);
+        w.highlightSet(rowColor(row));
+        w.put(text.mid(col, 1));
+        w.highlightSet(-1);
+
+        if(++col >= cols - 1)
+        {
+            col = 0;
+            row = (row + 1) % (rows - 1);
+        }
+
+        w.cursorGoto(row, col);
+        w.endFrame();
+    }
+
+    return w.data();
+}
+
+/// Totals of a scenario
+struct BenchResult
+{
+    BenchResult(void)
+        :frames(0), decodeNs(0), applyNs(0), paintNs(0),
+         decodeAllocs(0), applyAllocs(0), paintAllocs(0)
+    { /* do nothing */ }
+
+    quint64 frames;
+    qint64 decodeNs, applyNs, paintNs;
+    quint64 decodeAllocs, applyAllocs, paintAllocs;
+};
+
+/// Replay @b stream @b repeat times into a new shell
+static BenchResult runScenario(const QByteArray &stream, int repeat)
+{
+    BenchResult r;
+    ReplayDevice *dev = new ReplayDevice(stream);
+    MsgpackIODevice io(dev);
+    ReplayHandler handler;
+    io.setNotificationHandler("redraw", &handler);
+
+    Shell shell(NULL);
+    shell.show();
+    QApplication::processEvents();
+
+    QElapsedTimer timer;
+
+    for(int i=0; i<repeat; i++)
+    {
+        dev->rewind();
+
+        forever
+        {
+            quint64 allocs = s_allocations.load();
+            timer.start();
+
+            if(!dev->feed(REPLAY_CHUNK_SIZE))
+            {
+                break;
+            }
+
+            r.decodeNs += timer.nsecsElapsed();
+            r.decodeAllocs += s_allocations.load() - allocs;
+
+            foreach(const RedrawBatch &batch, handler.takeBatches())
+            {
+                allocs = s_allocations.load();
+                timer.start();
+                shell.handleRedrawBatch(batch);
+                r.applyNs += timer.nsecsElapsed();
+                r.applyAllocs += s_allocations.load() - allocs;
+
+                // Follow redraw:resize, not part of the frame
+                if(shell.size() != shell.sizeHint())
+                {
+                    shell.resize(shell.sizeHint());
+                }
+
+                allocs = s_allocations.load();
+                timer.start();
+                QApplication::processEvents();
+                r.paintNs += timer.nsecsElapsed();
+                r.paintAllocs += s_allocations.load() - allocs;
+
+                r.frames++;
+            }
+        }
+    }
+
+    io.setNotificationHandler("redraw", NULL);
+    return r;
+}
+
+static void printResult(const QString &name, const BenchResult &r)
+{
+    qint64 total = r.decodeNs + r.applyNs + r.paintNs;
+    double frames = r.frames ? r.frames : 1;
+
+    printf("%-16s %8llu %11.2f %11.2f %11.2f %9.1f",
+           qPrintable(name), (unsigned long long)r.frames,
+           r.decodeNs / 1e6, r.applyNs / 1e6, r.paintNs / 1e6,
+           total ? r.frames * 1e9 / total : 0.0);
+
+    if(ALLOC_COUNTING)
+    {
+        printf(" %9.1f %9.1f %9.1f\n", r.decodeAllocs / frames,
+               r.applyAllocs / frames, r.paintAllocs / frames);
+    }
+    else
+    {
+        printf(" %9s %9s %9s\n", "-", "-", "-");
+    }
+
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    // Headless unless a platform is asked for
+    if(!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Replay msgpack redraw streams into the snail shell");
+    parser.addHelpOption();
+
+    QCommandLineOption repeatOpt("repeat",
+                                 "Replay each scenario <n> times.",
+                                 "n", "1");
+    QCommandLineOption sizeOpt("size",
+                               "Grid of the built in scenarios.",
+                               "colsxrows", "120x40");
+    parser.addOption(repeatOpt);
+    parser.addOption(sizeOpt);
+    parser.addPositionalArgument("recordings",
+                                 "Streams recorded with GKIDE_SNAIL_RECORD, "
+                                 "runs the built in scenarios if none.",
+                                 "[recording...]");
+    parser.process(app);
+
+    bool ok = false;
+    int repeat = parser.value(repeatOpt).toInt(&ok);
+
+    if(!ok || repeat < 1)
+    {
+        fprintf(stderr, "Invalid --repeat value\n");
+        return 1;
+    }
+
+    QStringList size = parser.value(sizeOpt).split('x');
+    int cols = 0;
+    int rows = 0;
+
+    if(size.size() == 2)
+    {
+        cols = size.at(0).toInt();
+        rows = size.at(1).toInt();
+    }
+
+    if(cols < 2 || rows < 2)
+    {
+        fprintf(stderr, "Invalid --size value\n");
+        return 1;
+    }
+
+    printf("%-16s %8s %11s %11s %11s %9s %9s %9s %9s\n",
+           "scenario", "frames", "decode(ms)", "apply(ms)", "paint(ms)",
+           "fps", "alloc/d", "alloc/a", "alloc/p");
+
+    QStringList files = parser.positionalArguments();
+
+    if(files.isEmpty())
+    {
+        printResult("redraw", runScenario(redrawScenario(cols, rows), repeat));
+        printResult("scroll", runScenario(scrollScenario(cols, rows), repeat));
+        printResult("typing", runScenario(typingScenario(cols, rows), repeat));
+        return 0;
+    }
+
+    foreach(const QString &path, files)
+    {
+        QFile file(path);
+
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            fprintf(stderr, "Unable to open %s: %s\n", qPrintable(path),
+                    qPrintable(file.errorString()));
+            return 1;
+        }
+
+        printResult(QFileInfo(path).completeBaseName(),
+                    runScenario(file.readAll(), repeat));
+    }
+
+    return 0;
+}
@@ -5,68 +5,116 @@
 
 #include <QColor>
 #include <QChar>
+#include <QHash>
 #include "plugins/bin/snail/konsole_wcwidth.h"
 
+/// Colors and styles of cells, kept once in the attribute table of
+/// ShellContents and referenced by index from each Cell.
+struct CellAttrs
+{
+public:
+    inline CellAttrs(QColor fgColor, QColor bgColor, QColor spColor,
+                     bool bold, bool italic, bool underline, bool undercurl)
+        :foregroundColor(fgColor), backgroundColor(bgColor),
+         specialColor(spColor), bold(bold), italic(italic),
+         underline(underline), undercurl(undercurl)
+    { /* do nothing */ }
+
+    /// Default attributes use invalid colors
+    inline CellAttrs()
+        :bold(false), italic(false), underline(false), undercurl(false)
+    { /* do nothing */ }
+
+    QColor foregroundColor, backgroundColor, specialColor;
+    bool bold, italic, underline, undercurl;
+};
+
+inline bool operator==(const CellAttrs &a1, const CellAttrs &a2)
+{
+    return (a1.foregroundColor == a2.foregroundColor
+            && a1.backgroundColor == a2.backgroundColor
+            && a1.specialColor == a2.specialColor
+            && a1.bold == a2.bold
+            && a1.italic == a2.italic
+            && a1.underline == a2.underline
+            && a1.undercurl == a2.undercurl
+           );
+}
+
+inline uint qHash(const CellAttrs &a, uint seed = 0)
+{
+    uint styles = (a.bold ? 1 : 0) | (a.italic ? 2 : 0)
+                  | (a.underline ? 4 : 0) | (a.undercurl ? 8 : 0);
+
+    return qHash(a.foregroundColor.rgba(), seed)
+           ^ (qHash(a.backgroundColor.rgba(), seed) * 31)
+           ^ (qHash(a.specialColor.rgba(), seed) * 131)
+           ^ styles;
+}
+
+/// A cell packs its character with the index of its attributes in 8
+/// bytes, so rows can be moved with memcpy and compared cheaply.
 struct Cell
 {
 public:
-    inline Cell(QChar c, QColor fgColor, QColor bgColor, QColor spColor,
-                bool bold, bool italic, bool underline, bool undercurl)
-        :foregroundColor(fgColor), backgroundColor(bgColor), specialColor(spColor),
-         bold(bold), italic(italic), underline(underline), undercurl(undercurl),
-         valid(true), doubleWidth(false)
+    inline Cell(uint chr, quint16 attrId)
+        :valid(true), attr(attrId)
     {
-        setChar(c);
+        setChar(chr);
     }
 
-    /// Default cells are space characters using invalid colors
+    /// Default cells are space characters using the default attributes
     inline Cell()
-        :c(' '), foregroundColor(QColor()), backgroundColor(QColor()),
-         specialColor(QColor()), bold(false), italic(false), underline(false),
-         undercurl(false), valid(true), doubleWidth(false)
+        :c(' '), doubleWidth(false), valid(true), attr(0)
     { /* do nothing */ }
 
     inline void reset(void)
     {
-        c = ' ';
-        foregroundColor = QColor();
-        backgroundColor = foregroundColor;
-        specialColor = foregroundColor;
-        bold = italic = underline = undercurl = doubleWidth = false;
-        valid = true;
+        *this = Cell();
     }
 
-    /// Create an empty Cell with a background color
-    static Cell bg(QColor bg)
+    /// Create an empty Cell with the attributes @b attrId
+    static Cell bg(quint16 attrId)
     {
         Cell c;
-        c.backgroundColor = bg;
+        c.attr = attrId;
         return c;
     }
 
-    inline void setChar(const QChar &chr)
+    /// Set the character to the code point @b chr
+    inline void setChar(uint chr)
     {
         c = chr;
-        doubleWidth = (konsole_wcwidth(c.unicode()) > 1);
+        // The width of code points outside the BMP is not known
+        doubleWidth = (chr <= 0xFFFF && konsole_wcwidth(chr) > 1);
+    }
+
+    /// The character as a string
+    inline QString text(void) const
+    {
+        uint chr = c;
+        return QString::fromUcs4(&chr, 1);
     }
 
     static inline Cell invalid()
     {
-        Cell c = Cell('X', Qt::white, Qt::red, QColor(),
-                      false, false, false, false);
+        Cell c = Cell('X', 0);
         c.valid = false;
         return c;
     }
 
-    QChar c;
-    QColor foregroundColor, backgroundColor, specialColor;
-    bool bold, italic, underline, undercurl;
-    bool valid;
-    bool doubleWidth;
+    quint32 c : 21;
+    quint32 doubleWidth : 1;
+    quint32 valid : 1;
+    /// Index in the attribute table of ShellContents
+    quint16 attr;
 };
 
-/// Two cells are equal if all atributes are the same
-/// except if they are invalid.
+Q_STATIC_ASSERT(sizeof(Cell) == 8);
+
+/// Two cells are equal if the characters and attributes are the same
+/// except if they are invalid. Attributes are interned, equal attributes
+/// have the same index.
 inline bool operator==(const Cell &c1, const Cell &c2)
 {
     if(!c1.valid || !c2.valid)
@@ -74,15 +122,7 @@ inline bool operator==(const Cell &c1, const Cell &c2)
         return false;
     }
 
-    return (c1.c == c2.c
-            && c1.foregroundColor == c2.foregroundColor
-            && c1.backgroundColor == c2.backgroundColor
-            && c1.specialColor == c2.specialColor
-            && c1.bold == c2.bold
-            && c1.italic == c2.italic
-            && c1.underline == c2.underline
-            && c1.undercurl == c2.undercurl
-           );
+    return (c1.c == c2.c && c1.attr == c2.attr);
 }
 
 #endif // PLUGIN_SNAIL_CELL_H
@@ -27,14 +27,15 @@ bool saveShellContents(const ShellContents &s, const QString &filename)
         {
             QRect r(j*w, i*h, w, h);
             const Cell &cell = s.constValue(i,j);
-            p.setPen(cell.foregroundColor);
+            const CellAttrs &attrs = s.attrs(cell.attr);
+            p.setPen(attrs.foregroundColor);
 
-            if(cell.backgroundColor.isValid())
+            if(attrs.backgroundColor.isValid())
             {
-                p.fillRect(r, cell.backgroundColor);
+                p.fillRect(r, attrs.backgroundColor);
             }
 
-            p.drawText(r, cell.c);
+            p.drawText(r, cell.text());
         }
     }
 
@@ -18,7 +18,8 @@ namespace SnailNvimQt {
 
 MsgpackIODevice::MsgpackIODevice(QIODevice *dev, QObject *parent)
     : QObject(parent), m_reqid(0), m_dev(dev),
-      m_encoding(NULL), m_reqHandler(NULL), m_error(NoError)
+      m_encoding(NULL), m_reqHandler(NULL), m_record(NULL),
+      m_error(NoError)
 {
     //qRegisterMetaType<MsgpackError>("MsgpackError");
     //qRegisterMetaType<NvimApiFuncID>("NvimApiFuncID");
@@ -56,6 +57,36 @@ MsgpackIODevice::~MsgpackIODevice()
     msgpack_unpacker_destroy(&m_uk);
 }
 
+/// Record the incoming msgpack stream to the file @b path, as read from
+/// the device. Replaying the file into a MsgpackIODevice gives the same
+/// messages, e.g. for the snail-bench rendering benchmark.
+///
+/// An empty @b path stops recording. Returns false if the file can not
+/// be opened.
+bool MsgpackIODevice::setRecordFile(const QString &path)
+{
+    delete m_record;
+    m_record = NULL;
+
+    if(path.isEmpty())
+    {
+        return true;
+    }
+
+    m_record = new QFile(path, this);
+
+    if(!m_record->open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Unable to record msgpack stream to" << path
+                   << m_record->errorString();
+        delete m_record;
+        m_record = NULL;
+        return false;
+    }
+
+    return true;
+}
+
 /// is IODevice opened and check errors
 bool MsgpackIODevice::isOpen(void)
 {
@@ -148,6 +179,11 @@ void MsgpackIODevice::dataAvailable(void)
 
         if(read > 0)
         {
+            if(m_record)
+            {
+                m_record->write(msgpack_unpacker_buffer(&m_uk), read);
+            }
+
             msgpack_unpacker_buffer_consumed(&m_uk, read);
 
             msgpack_unpacked obj;
@@ -155,8 +191,10 @@ void MsgpackIODevice::dataAvailable(void)
 
             while(msgpack_unpacker_next(&m_uk, &obj))
             {
-                dispatch(obj.data);
+                dispatch(obj);
             }
+
+            msgpack_unpacked_destroy(&obj);
         }
     }
 }
@@ -189,8 +227,10 @@ void MsgpackIODevice::sendError(uint64_t msgid, const QString &msg)
 }
 
 /// Do some sanity checks and forward message to the proper handler
-void MsgpackIODevice::dispatch(msgpack_object &req)
+void MsgpackIODevice::dispatch(msgpack_unpacked &msg)
 {
+    msgpack_object &req = msg.data;
+
     // nvim msgpack rpc calls are:
     // 0            1            2             3
     // [msgType(0), msgID(uint), method(uint), args(array)]  => request
@@ -248,6 +288,7 @@ void MsgpackIODevice::dispatch(msgpack_object &req)
                 return;
             }
 
+            finishNotifications();
             dispatchRequest(req);
             break;
         }
@@ -260,12 +301,13 @@ void MsgpackIODevice::dispatch(msgpack_object &req)
                 return;
             }
 
+            finishNotifications();
             dispatchResponse(req);
             break;
         }
         case msgNotification:
         {
-            dispatchNotification(req);
+            dispatchNotification(msg);
             break;
         }
         default:
@@ -321,6 +363,21 @@ void MsgpackIODevice::setRequestHandler(MsgpackRequestHandler *h)
     m_reqHandler = h;
 }
 
+/// Assign a handler for the notifications of @b method, they skip the
+/// conversion to QVariant. A NULL handler removes it.
+void MsgpackIODevice::setNotificationHandler(const QByteArray &method,
+                                             MsgpackNotificationHandler *h)
+{
+    if(h)
+    {
+        m_ntHandlers.insert(method, h);
+    }
+    else
+    {
+        m_ntHandlers.remove(method);
+    }
+}
+
 /// Send back a response [type(1), msgid(uint), error(...), result(...)]
 ///
 /// @param msgid    message ID of nvim<->snail
@@ -416,8 +473,10 @@ QList<quint32> MsgpackIODevice::pendingRequests(void) const
 }
 
 /// Handle nvim notification messages
-void MsgpackIODevice::dispatchNotification(msgpack_object &nt)
+void MsgpackIODevice::dispatchNotification(msgpack_unpacked &msg)
 {
+    msgpack_object &nt = msg.data;
+
     //  0           1       2
     // [msgType(2), method, params]
     QByteArray methodName;
@@ -428,6 +487,20 @@ void MsgpackIODevice::dispatchNotification(msgpack_object &nt)
         return;
     }
 
+    MsgpackNotificationHandler *h = m_ntHandlers.value(methodName);
+    finishNotifications(h);
+
+    if(h && nt.via.array.ptr[2].type == MSGPACK_OBJECT_ARRAY
+       && h->handleNotification(this, msg))
+    {
+        return;
+    }
+
+    if(h)
+    {
+        h->finishNotifications();
+    }
+
     QVariant val;
 
     if(decodeMsgpack(nt.via.array.ptr[2], val)
@@ -440,6 +513,19 @@ void MsgpackIODevice::dispatchNotification(msgpack_object &nt)
     emit notification(methodName, val.toList());
 }
 
+/// Let the notification handlers but @b except finish the notifications
+/// they got, before a message they don't handle is dispatched
+void MsgpackIODevice::finishNotifications(MsgpackNotificationHandler *except)
+{
+    foreach(MsgpackNotificationHandler *h, m_ntHandlers)
+    {
+        if(h != except)
+        {
+            h->finishNotifications();
+        }
+    }
+}
+
 /// Sets latest error code and message for this connector
 void MsgpackIODevice::setError(MsgpackError err, const QString &msg)
 {
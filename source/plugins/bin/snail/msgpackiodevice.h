@@ -4,6 +4,7 @@
 #define PLUGIN_SNAIL_MSGPACKIODEVICE_H
 
 #include <QIODevice>
+#include <QFile>
 #include <QHash>
 #include <msgpack.h>
 
@@ -11,6 +12,7 @@ namespace SnailNvimQt {
 
 class MsgpackRequest;
 class MsgpackRequestHandler;
+class MsgpackNotificationHandler;
 
 /// A msgpack-rpc channel build on top of QIODevice
 class MsgpackIODevice: public QObject
@@ -78,12 +80,20 @@ public:
 
     QByteArray encode(const QString &);
     QString decode(const QByteArray &);
+
+    /// The codec of encode() and decode(), NULL for UTF-8
+    inline QTextCodec *textCodec(void) const
+    {
+        return m_encoding;
+    }
     bool checkVariant(const QVariant &);
 
     bool sendResponse(uint64_t msgid, const QVariant &err, const QVariant &res);
     bool sendNotification(const QByteArray &method, const QVariantList &params);
 
     void setRequestHandler(MsgpackRequestHandler *);
+    void setNotificationHandler(const QByteArray &method,
+                                MsgpackNotificationHandler *);
 
     /// Typedef for msgpack-to-Qvariant decoder @see registerExtType
     typedef QVariant(*msgpackExtDecoder)(MsgpackIODevice *,
@@ -93,6 +103,10 @@ public:
 
     QList<quint32> pendingRequests(void) const;
 
+    bool setRecordFile(const QString &path);
+
+    bool decodeMsgpack(const msgpack_object &in, QVariant &out);
+
 signals:
     void error(MsgpackError);
     /// A notification with the given name and arguments was received
@@ -101,13 +115,13 @@ signals:
 protected:
     void sendError(const msgpack_object &req, const QString &msg);
     void sendError(uint64_t msgid, const QString &msg);
-    void dispatch(msgpack_object &obj);
+    void dispatch(msgpack_unpacked &msg);
     void dispatchRequest(msgpack_object &obj);
     void dispatchResponse(msgpack_object &obj);
-    void dispatchNotification(msgpack_object &obj);
+    void dispatchNotification(msgpack_unpacked &msg);
+    void finishNotifications(MsgpackNotificationHandler *except=NULL);
 
     bool decodeMsgpack(const msgpack_object &in, int64_t &out);
-    bool decodeMsgpack(const msgpack_object &in, QVariant &out);
     bool decodeMsgpack(const msgpack_object &in, QByteArray &out);
     bool decodeMsgpack(const msgpack_object &in, bool &out);
     bool decodeMsgpack(const msgpack_object &in, QList<QByteArray> &out);
@@ -132,9 +146,13 @@ private:
     msgpack_unpacker m_uk; ///< msgpack unpacker
 
     MsgpackRequestHandler *m_reqHandler;
+    QHash<QByteArray, MsgpackNotificationHandler *> m_ntHandlers;
     QHash<quint32, MsgpackRequest *> m_requests;
     QHash<int8_t, msgpackExtDecoder> m_extTypes;
 
+    /// Copy of everything read from m_dev, @see setRecordFile
+    QFile *m_record;
+
     QString m_errorString;
     MsgpackError m_error;
 };
@@ -148,6 +166,29 @@ public:
                                const QVariantList &)=0;
 };
 
+/// Decodes notifications straight from msgpack, see
+/// MsgpackIODevice::setNotificationHandler()
+class MsgpackNotificationHandler
+{
+public:
+    /// Handle the notification @b msg, [type, method, params] with an
+    /// array of params. Returns false to emit
+    /// MsgpackIODevice::notification() instead.
+    ///
+    /// The handler may keep @b msg past the call: it then sets msg.zone
+    /// to NULL and frees the zone with msgpack_zone_free() when done.
+    /// The zone holds a reference to the unpacker buffer, freeing it
+    /// from another thread is safe.
+    virtual bool handleNotification(MsgpackIODevice *,
+                                    msgpack_unpacked &msg)=0;
+
+    /// Finish the notifications handled so far. The device calls this
+    /// before it dispatches any other message, a handler that works on
+    /// them later keeps the order of the messages this way.
+    virtual void finishNotifications(void)
+    { /* do nothing */ }
+};
+
 } // namespace::SnailNvimQt
 
 Q_DECLARE_METATYPE(SnailNvimQt::MsgpackIODevice::MsgpackError)
@@ -10,6 +10,7 @@
 #include "plugins/bin/snail/msgpackrequest.h"
 #include "plugins/bin/snail/nvimconnectorhelper.h"
 #include "plugins/bin/snail/msgpackiodevice.h"
+#include "plugins/bin/snail/shmgrid.h"
 
 namespace SnailNvimQt {
 
@@ -23,13 +24,21 @@ NvimConnector::NvimConnector(QIODevice *dev)
 NvimConnector::NvimConnector(MsgpackIODevice *dev)
     : QObject(), m_dev(dev), m_helper(NULL), m_error(NoError),
       m_nvimObj(NULL), m_nvimVer(NULL), m_channel(0),
-      m_ctype(OtherConnection), m_ready(false)
+      m_ctype(OtherConnection), m_ready(false), m_uiLineRuns(false),
+      m_uiShmGrid(false)
 {
     m_helper = new NvimConnectorHelper(this);
 
     connect(m_dev, &MsgpackIODevice::error,
             this, &NvimConnector::msgpackError);
 
+    if(qEnvironmentVariableIsSet(ENV_GKIDE_SNAIL_RECORD)
+       && !qEnvironmentVariableIsEmpty(ENV_GKIDE_SNAIL_RECORD))
+    {
+        QString path = QString::fromLocal8Bit(qgetenv(ENV_GKIDE_SNAIL_RECORD));
+        m_dev->setRecordFile(path);
+    }
+
     if(!m_dev->isOpen())
     {
         return;
@@ -94,6 +103,15 @@ MsgpackRequest *NvimConnector::attachUi(int64_t width, int64_t height)
 
     QVariantMap opts;
     opts.insert("rgb", true);
+
+    if(m_uiLineRuns)
+    {
+        // Lines of cells with highlight ids, instead of a put per cell
+        opts.insert("ext_lineruns", true);
+        // No more redraws than the screen can show
+        opts.insert("flush_rate", 60);
+    }
+
     m_dev->send(opts);
 
     return r;
@@ -142,6 +160,14 @@ QString NvimConnector::decode(const QByteArray &in)
     return m_dev->decode(in);
 }
 
+/// Decode the notifications of @b method with @b h instead of emitting
+/// Nvim::neovimNotification(), see MsgpackIODevice::setNotificationHandler
+void NvimConnector::setNotificationHandler(const QByteArray &method,
+                                           MsgpackNotificationHandler *h)
+{
+    m_dev->setNotificationHandler(method, h);
+}
+
 /// Encode a string into the appropriate encoding for this Nvim instance
 ///
 /// see :h 'encoding'
@@ -462,6 +488,15 @@ NvimConnector::NeovimConnectionType NvimConnector::connectionType()
     return m_ctype;
 }
 
+/// True if Nvim runs on this machine and can publish its grid in shared
+/// memory, see the "ext_shmgrid" UI option
+bool NvimConnector::canShareGrid(void)
+{
+    return m_uiShmGrid
+           && ShmGrid::isSupported()
+           && (m_ctype == SpawnedConnection || m_ctype == SocketConnection);
+}
+
 /// Create a new connection using the same parameters as the current one.
 ///
 /// This is the equivalent of creating a new object with startEmbedNvim(),
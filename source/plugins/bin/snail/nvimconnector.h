@@ -57,6 +57,7 @@ public:
 namespace SnailNvimQt {
 
 class MsgpackIODevice;
+class MsgpackNotificationHandler;
 class NvimConnectorHelper;
 
 /// Connection to a Nvim instance
@@ -122,7 +123,10 @@ public:
     uint64_t channel(void);
     QString decode(const QByteArray &);
     QByteArray encode(const QString &);
+    void setNotificationHandler(const QByteArray &method,
+                                MsgpackNotificationHandler *);
     NeovimConnectionType connectionType();
+    bool canShareGrid(void);
 
     NvimVersion *getNvimVersionObj(void);
 
@@ -174,6 +178,8 @@ private:
     QString m_connHost;
     int m_connPort;
     bool m_ready;
+    bool m_uiLineRuns; ///< nvim can send "line" redraw events
+    bool m_uiShmGrid; ///< nvim can publish its grid in shared memory
 };
 
 } // namespace::SnailNvimQt
@@ -65,6 +65,12 @@ void NvimConnectorHelper::handleMetadata(
             bindingFuncOK = checkFunctions(it.value().toList());
         }
 
+        if(it.key() == "ui_events")
+        {
+            m_c->m_uiLineRuns = hasUiEvent(it.value().toList(), "line");
+            m_c->m_uiShmGrid = hasUiEvent(it.value().toList(), "grid_flush");
+        }
+
         if(it.key() == "version")
         {
             if(this->m_c->m_nvimVer == NULL)
@@ -162,4 +168,19 @@ bool NvimConnectorHelper::checkFunctions(const QVariantList &ftable)
     return NvimApiFunc::nvimAPIs.size() == supported.size();
 }
 
+/// Check the UI event table from api_metadata[1] for event @b name
+bool NvimConnectorHelper::hasUiEvent(const QVariantList &evtable,
+                                     const QString &name)
+{
+    foreach(const QVariant &val, evtable)
+    {
+        if(val.toMap().value("name").toString() == name)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 } // namespace::SnailNvimQt
@@ -23,6 +23,7 @@ public slots:
     void encodingChanged(const QVariant &);
 protected:
     bool checkFunctions(const QVariantList &ftable);
+    bool hasUiEvent(const QVariantList &evtable, const QString &name);
 
 private:
     NvimConnector *m_c;
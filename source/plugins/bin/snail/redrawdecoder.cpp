@@ -0,0 +1,525 @@
+/// @file plugins/bin/snail/redrawdecoder.cpp
+
+#include <QDebug>
+#include <QMetaObject>
+#include "plugins/bin/snail/util.h"
+#include "plugins/bin/snail/redrawdecoder.h"
+
+namespace SnailNvimQt {
+
+/// Highlight keys setting colors, next to the RedrawAttrs flags
+enum
+{
+    AttrForeground = 0x100,
+    AttrBackground = 0x200,
+    AttrSpecial    = 0x400,
+};
+
+/// Sets @b out to the bytes of a String or Binary, without copying
+/// them. Returns false for other types.
+static bool getBytes(const msgpack_object &in, QByteArray &out)
+{
+    if(in.type == MSGPACK_OBJECT_STR)
+    {
+        out = QByteArray::fromRawData(in.via.str.ptr, (int)in.via.str.size);
+    }
+    else if(in.type == MSGPACK_OBJECT_BIN)
+    {
+        out = QByteArray::fromRawData(in.via.bin.ptr, (int)in.via.bin.size);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/// Sets @b out to an Integer, returns false for other types
+static bool getInt(const msgpack_object &in, qint64 &out)
+{
+    if(in.type == MSGPACK_OBJECT_POSITIVE_INTEGER)
+    {
+        out = (qint64)in.via.u64;
+    }
+    else if(in.type == MSGPACK_OBJECT_NEGATIVE_INTEGER)
+    {
+        out = (qint64)in.via.i64;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/// The text of @b bytes in @b codec, UTF-8 for NULL. The conversion state
+/// is local, the worker thread can use the codec of the device.
+static QString decodeText(QTextCodec *codec, const QByteArray &bytes)
+{
+    if(!codec)
+    {
+        return QString::fromUtf8(bytes);
+    }
+
+    QTextCodec::ConverterState state;
+    return codec->toUnicode(bytes.constData(), bytes.size(), &state);
+}
+
+/// True for true Booleans and non zero Integers
+static bool isTrue(const msgpack_object &in)
+{
+    if(in.type == MSGPACK_OBJECT_BOOLEAN)
+    {
+        return in.via.boolean;
+    }
+
+    qint64 val;
+    return getInt(in, val) && val != 0;
+}
+
+RedrawDecoder::RedrawDecoder(QObject *parent)
+    :QObject(parent), m_dev(NULL), m_workerIdle(1), m_guiIdle(1),
+     m_pending(0), m_stop(0)
+{
+    m_worker = new RedrawWorker(this);
+    m_worker->moveToThread(&m_thread);
+    m_thread.setObjectName("redraw");
+    m_thread.start();
+}
+
+RedrawDecoder::~RedrawDecoder()
+{
+    m_stop.storeRelease(1);
+    m_thread.quit();
+    m_thread.wait();
+    delete m_worker;
+
+    RedrawMessage m;
+
+    while(m_messages.pop(m))
+    {
+        msgpack_zone_free(m.msg.zone);
+    }
+}
+
+/// Hand the redraw notification @b msg over to the decoder thread, it
+/// keeps the zone of @b msg
+bool RedrawDecoder::handleNotification(MsgpackIODevice *dev,
+                                       msgpack_unpacked &msg)
+{
+    RedrawMessage m;
+    m.codec = dev->textCodec();
+    m.msg = msg;
+    m_dev = dev;
+    m_pending.ref();
+
+    while(!m_messages.push(m))
+    {
+        // The worker may be waiting for room in m_batches
+        applyBatches();
+        QThread::yieldCurrentThread();
+    }
+
+    msg.zone = NULL;
+
+    if(m_workerIdle.testAndSetOrdered(1, 0))
+    {
+        QMetaObject::invokeMethod(m_worker, "decodePending",
+                                  Qt::QueuedConnection);
+    }
+
+    return true;
+}
+
+/// Emit the batches decoded so far, in order
+void RedrawDecoder::applyBatches(void)
+{
+    RedrawBatch batch;
+    m_guiIdle.storeRelease(1);
+
+    while(m_batches.pop(batch))
+    {
+        decodeGeneric(m_dev, batch);
+        emit redraw(batch);
+    }
+}
+
+/// Wait for the worker to decode the notifications handed over so far,
+/// and apply them: the message the device dispatches next comes after.
+void RedrawDecoder::finishNotifications(void)
+{
+    while(m_pending.loadAcquire() > 0)
+    {
+        applyBatches();
+        QThread::yieldCurrentThread();
+    }
+
+    applyBatches();
+}
+
+/// Decode the arguments of the Generic updates of @b batch, the worker
+/// left them packed: only the GUI thread may use @b dev.
+void RedrawDecoder::decodeGeneric(MsgpackIODevice *dev, RedrawBatch &batch)
+{
+    for(int i=0; i<batch.size(); i++)
+    {
+        RedrawOp &op = batch[i];
+
+        if(op.event != RedrawOp::Generic || op.packed.isEmpty())
+        {
+            continue;
+        }
+
+        msgpack_unpacked up;
+        msgpack_unpacked_init(&up);
+        QVariant val;
+
+        if(!msgpack_unpack_next(&up, op.packed.constData(),
+                                (size_t)op.packed.size(), NULL)
+           || dev->decodeMsgpack(up.data, val))
+        {
+            qWarning() << "Unexpected arguments for redraw:" << op.name;
+        }
+
+        msgpack_unpacked_destroy(&up);
+        op.generic = val.toList();
+        op.packed.clear();
+    }
+}
+
+RedrawWorker::RedrawWorker(RedrawDecoder *decoder)
+    :m_decoder(decoder)
+{
+    static const struct
+    {
+        const char *name;
+        RedrawOp::Event event;
+    } events[] =
+    {
+        { "put",                RedrawOp::Put               },
+        { "cursor_goto",        RedrawOp::CursorGoto        },
+        { "highlight_set",      RedrawOp::HighlightSet      },
+        { "hl_define",          RedrawOp::HighlightDefine   },
+        { "line",               RedrawOp::Line              },
+        { "scroll",             RedrawOp::Scroll            },
+        { "set_scroll_region",  RedrawOp::SetScrollRegion   },
+        { "clear",              RedrawOp::Clear             },
+        { "eol_clear",          RedrawOp::EolClear          },
+    };
+
+    static const struct
+    {
+        const char *name;
+        int attr;
+    } attrKeys[] =
+    {
+        { "foreground", AttrForeground          },
+        { "background", AttrBackground          },
+        { "special",    AttrSpecial             },
+        { "bold",       RedrawAttrs::Bold       },
+        { "italic",     RedrawAttrs::Italic     },
+        { "underline",  RedrawAttrs::Underline  },
+        { "undercurl",  RedrawAttrs::Undercurl  },
+        { "reverse",    RedrawAttrs::Reverse    },
+    };
+
+    for(size_t i=0; i<sizeof(events)/sizeof(events[0]); i++)
+    {
+        m_events.insert(events[i].name, events[i].event);
+    }
+
+    for(size_t i=0; i<sizeof(attrKeys)/sizeof(attrKeys[0]); i++)
+    {
+        m_attrKeys.insert(attrKeys[i].name, attrKeys[i].attr);
+    }
+}
+
+/// Decode the pending notifications, one batch each, and wake the GUI
+/// thread up to apply them. Malformed updates are skipped.
+void RedrawWorker::decodePending(void)
+{
+    RedrawMessage m;
+    m_decoder->m_workerIdle.storeRelease(1);
+
+    while(m_decoder->m_messages.pop(m))
+    {
+        decodeNotification(m.codec, m.msg.data.via.array.ptr[2], m_batch);
+        msgpack_zone_free(m.msg.zone);
+
+        if(m_batch.isEmpty())
+        {
+            m_decoder->m_pending.deref();
+            continue;
+        }
+
+        while(!m_decoder->m_batches.push(m_batch))
+        {
+            if(m_decoder->m_stop.loadAcquire())
+            {
+                return;
+            }
+
+            QThread::yieldCurrentThread();
+        }
+
+        m_batch.clear();
+        m_decoder->m_pending.deref();
+
+        if(m_decoder->m_guiIdle.testAndSetOrdered(1, 0))
+        {
+            QMetaObject::invokeMethod(m_decoder, "applyBatches",
+                                      Qt::QueuedConnection);
+        }
+    }
+}
+
+/// Append the updates of the redraw notification @b params, an array,
+/// to @b batch
+void RedrawWorker::decodeNotification(QTextCodec *codec,
+                                      const msgpack_object &params,
+                                      RedrawBatch &batch)
+{
+    for(uint32_t i=0; i<params.via.array.size; i++)
+    {
+        decodeUpdate(codec, params.via.array.ptr[i], batch);
+    }
+}
+
+/// Decode an update [name, args...] into @b batch, one RedrawOp per args
+/// except for put: the text of all its args is one RedrawOp.
+void RedrawWorker::decodeUpdate(QTextCodec *codec,
+                                const msgpack_object &update,
+                                RedrawBatch &batch)
+{
+    QByteArray name;
+
+    if(update.type != MSGPACK_OBJECT_ARRAY
+       || update.via.array.size < 1
+       || !getBytes(update.via.array.ptr[0], name))
+    {
+        qWarning() << "Received unexpected redraw operation" << update;
+        return;
+    }
+
+    RedrawOp::Event event = m_events.value(name, RedrawOp::Generic);
+    const msgpack_object *calls = update.via.array.ptr + 1;
+    uint32_t ncalls = update.via.array.size - 1;
+
+    if(event == RedrawOp::Put)
+    {
+        QByteArray text;
+
+        for(uint32_t i=0; i<ncalls; i++)
+        {
+            QByteArray bytes;
+
+            if(calls[i].type != MSGPACK_OBJECT_ARRAY
+               || calls[i].via.array.size != 1
+               || !getBytes(calls[i].via.array.ptr[0], bytes))
+            {
+                qWarning() << "Unexpected arguments for redraw:put"
+                           << calls[i];
+                continue;
+            }
+
+            text.append(bytes);
+        }
+
+        if(!text.isEmpty())
+        {
+            RedrawOp op(RedrawOp::Put);
+            op.text = decodeText(codec, text);
+            batch.append(op);
+        }
+
+        return;
+    }
+
+    for(uint32_t i=0; i<ncalls; i++)
+    {
+        if(calls[i].type != MSGPACK_OBJECT_ARRAY)
+        {
+            qWarning() << "Received unexpected redraw "
+                          "arguments, expecting list" << calls[i];
+            continue;
+        }
+
+        const msgpack_object *args = calls[i].via.array.ptr;
+        uint32_t nargs = calls[i].via.array.size;
+        RedrawOp op(event);
+        bool ok = true;
+
+        switch(event)
+        {
+            case RedrawOp::CursorGoto:
+            {
+                ok = nargs >= 2
+                     && getInt(args[0], op.args[0])
+                     && getInt(args[1], op.args[1]);
+                break;
+            }
+            case RedrawOp::HighlightSet:
+            {
+                ok = nargs >= 1 && decodeAttrs(args[0], op.attrs);
+                break;
+            }
+            case RedrawOp::HighlightDefine:
+            {
+                ok = nargs == 2
+                     && getInt(args[0], op.args[0])
+                     && decodeAttrs(args[1], op.attrs);
+                break;
+            }
+            case RedrawOp::Line:
+            {
+                ok = nargs == 3
+                     && getInt(args[0], op.args[0])
+                     && getInt(args[1], op.args[1])
+                     && decodeCells(codec, args[2], op.cells);
+                break;
+            }
+            case RedrawOp::Scroll:
+            {
+                ok = nargs >= 1 && getInt(args[0], op.args[0]);
+                break;
+            }
+            case RedrawOp::SetScrollRegion:
+            {
+                ok = nargs >= 4;
+
+                for(int j=0; ok && j<4; j++)
+                {
+                    ok = getInt(args[j], op.args[j]);
+                }
+
+                break;
+            }
+            case RedrawOp::Clear:
+            case RedrawOp::EolClear:
+            {
+                break;
+            }
+            default:
+            {
+                // Packed again for decodeGeneric(), it may hold EXT types
+                // that only the device decodes.
+                msgpack_sbuffer sbuf;
+                msgpack_packer pk;
+                msgpack_sbuffer_init(&sbuf);
+                msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+                ok = msgpack_pack_object(&pk, calls[i]) == 0;
+                op.name = QByteArray(name.constData(), name.size());
+                op.packed = QByteArray(sbuf.data, (int)sbuf.size);
+                msgpack_sbuffer_destroy(&sbuf);
+                break;
+            }
+        }
+
+        if(!ok)
+        {
+            qWarning() << "Unexpected arguments for redraw:" << name
+                       << calls[i];
+            continue;
+        }
+
+        batch.append(op);
+    }
+}
+
+/// Decode a highlight map, returns false if @b in is not a map
+bool RedrawWorker::decodeAttrs(const msgpack_object &in, RedrawAttrs &out)
+{
+    if(in.type != MSGPACK_OBJECT_MAP)
+    {
+        return false;
+    }
+
+    for(uint32_t i=0; i<in.via.map.size; i++)
+    {
+        const msgpack_object_kv &kv = in.via.map.ptr[i];
+        QByteArray key;
+
+        if(!getBytes(kv.key, key))
+        {
+            continue;
+        }
+
+        int attr = m_attrKeys.value(key, 0);
+
+        switch(attr)
+        {
+            case 0:
+            {
+                break;
+            }
+            case AttrForeground:
+            {
+                getInt(kv.val, out.foreground);
+                break;
+            }
+            case AttrBackground:
+            {
+                getInt(kv.val, out.background);
+                break;
+            }
+            case AttrSpecial:
+            {
+                getInt(kv.val, out.special);
+                break;
+            }
+            default:
+            {
+                if(isTrue(kv.val))
+                {
+                    out.flags |= attr;
+                }
+
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+/// Decode the [text, hl_id, repeat] cells of redraw:line, malformed
+/// cells are skipped. Returns false if @b in is not an array.
+bool RedrawWorker::decodeCells(QTextCodec *codec,
+                               const msgpack_object &in,
+                               QVector<RedrawCell> &out)
+{
+    if(in.type != MSGPACK_OBJECT_ARRAY)
+    {
+        return false;
+    }
+
+    out.reserve(in.via.array.size);
+
+    for(uint32_t i=0; i<in.via.array.size; i++)
+    {
+        const msgpack_object &cell = in.via.array.ptr[i];
+        QByteArray text;
+        qint64 repeat;
+        RedrawCell c;
+
+        if(cell.type != MSGPACK_OBJECT_ARRAY
+           || cell.via.array.size != 3
+           || !getBytes(cell.via.array.ptr[0], text)
+           || !getInt(cell.via.array.ptr[1], c.hlId)
+           || !getInt(cell.via.array.ptr[2], repeat))
+        {
+            qWarning() << "Unexpected cell for redraw:line" << cell;
+            continue;
+        }
+
+        c.text = decodeText(codec, text);
+        c.repeat = (int)repeat;
+        out.append(c);
+    }
+
+    return true;
+}
+
+} // namespace::SnailNvimQt
@@ -0,0 +1,176 @@
+/// @file plugins/bin/snail/redrawdecoder.h
+///
+/// Decodes redraw notifications from msgpack into typed updates. The
+/// frequent events never become QVariant trees, the others are handed
+/// over as name and QVariantList like any notification.
+///
+/// The decoding runs in a thread of its own: the GUI thread hands over
+/// the unpacked notifications and gets back batches to apply, both
+/// through lock-free queues. The worker doesn't touch the MsgpackIODevice:
+/// it decodes text with the codec the message came with, and leaves the
+/// arguments of the other events packed for the GUI thread. Before any
+/// other message the device has the pending batches applied, see
+/// finishNotifications(), so they keep their order.
+
+#ifndef PLUGIN_SNAIL_REDRAWDECODER_H
+#define PLUGIN_SNAIL_REDRAWDECODER_H
+
+#include <QObject>
+#include <QThread>
+#include <QAtomicInt>
+#include <QHash>
+#include <QVector>
+#include <QVariant>
+#include <QTextCodec>
+#include <msgpack.h>
+#include "plugins/bin/snail/msgpackiodevice.h"
+#include "plugins/bin/snail/spscqueue.h"
+
+namespace SnailNvimQt {
+
+/// Attributes of redraw:highlight_set and redraw:hl_define
+struct RedrawAttrs
+{
+    enum Flag
+    {
+        Bold      = 0x01,
+        Italic    = 0x02,
+        Underline = 0x04,
+        Undercurl = 0x08,
+        Reverse   = 0x10,
+    };
+
+    inline RedrawAttrs()
+        :foreground(-1), background(-1), special(-1), flags(0)
+    { /* do nothing */ }
+
+    /// RGB colors, -1 if not given
+    qint64 foreground, background, special;
+    int flags;
+};
+
+/// A cell of redraw:line, [text, hl_id, repeat]
+struct RedrawCell
+{
+    QString text;
+    qint64 hlId;
+    int repeat;
+};
+
+/// One redraw update and its arguments
+struct RedrawOp
+{
+    enum Event
+    {
+        Generic = 0,        ///< Any other event: name, generic
+        Put,                ///< text, all the puts of one update
+        CursorGoto,         ///< args: row, col
+        HighlightSet,       ///< attrs
+        HighlightDefine,    ///< args: id; attrs
+        Line,               ///< args: row, col; cells
+        Scroll,             ///< args: count
+        SetScrollRegion,    ///< args: top, bot, left, right
+        Clear,
+        EolClear,
+    };
+
+    inline RedrawOp(Event ev=Generic)
+        :event(ev)
+    {
+        args[0] = args[1] = args[2] = args[3] = 0;
+    }
+
+    Event event;
+    qint64 args[4];
+    QString text;
+    RedrawAttrs attrs;
+    QVector<RedrawCell> cells;
+    QByteArray name;
+    QVariantList generic;
+    /// Generic: the arguments packed again, until decodeGeneric()
+    QByteArray packed;
+};
+
+/// The updates of one redraw notification, in order
+typedef QVector<RedrawOp> RedrawBatch;
+
+/// A redraw notification on its way to the decoder thread, it owns the
+/// zone of msg
+struct RedrawMessage
+{
+    QTextCodec *codec; ///< of the device, NULL for UTF-8
+    msgpack_unpacked msg;
+};
+
+class RedrawDecoder;
+
+/// The decoding side of RedrawDecoder, lives in its thread. Without a
+/// decoder it only serves decodeNotification() to its own thread.
+class RedrawWorker: public QObject
+{
+    Q_OBJECT
+public:
+    RedrawWorker(RedrawDecoder *decoder=0);
+    void decodeNotification(QTextCodec *codec,
+                            const msgpack_object &params,
+                            RedrawBatch &batch);
+
+public slots:
+    void decodePending(void);
+
+private:
+    void decodeUpdate(QTextCodec *codec, const msgpack_object &update,
+                      RedrawBatch &batch);
+    bool decodeAttrs(const msgpack_object &in, RedrawAttrs &out);
+    bool decodeCells(QTextCodec *codec, const msgpack_object &in,
+                     QVector<RedrawCell> &out);
+
+    RedrawDecoder *m_decoder;
+    /// Event of the redraw update names, Generic if not listed
+    QHash<QByteArray, RedrawOp::Event> m_events;
+    /// RedrawAttrs flag or color set by the highlight keys
+    QHash<QByteArray, int> m_attrKeys;
+    RedrawBatch m_batch;
+};
+
+class RedrawDecoder: public QObject, public MsgpackNotificationHandler
+{
+    Q_OBJECT
+    friend class RedrawWorker;
+public:
+    RedrawDecoder(QObject *parent=0);
+    ~RedrawDecoder();
+    virtual bool handleNotification(MsgpackIODevice *dev,
+                                    msgpack_unpacked &msg) Q_DECL_OVERRIDE;
+    virtual void finishNotifications(void) Q_DECL_OVERRIDE;
+
+    static void decodeGeneric(MsgpackIODevice *dev, RedrawBatch &batch);
+
+signals:
+    void redraw(const SnailNvimQt::RedrawBatch &batch);
+
+private slots:
+    void applyBatches(void);
+
+private:
+    QThread m_thread;
+    RedrawWorker *m_worker;
+    /// Device of the notifications, for decodeGeneric()
+    MsgpackIODevice *m_dev;
+    /// Notifications for the worker, and the batches it decoded
+    SpscQueue<RedrawMessage, 1024> m_messages;
+    SpscQueue<RedrawBatch, 256> m_batches;
+    /// 1 while the worker, or the GUI thread, has no wake up pending
+    QAtomicInt m_workerIdle;
+    QAtomicInt m_guiIdle;
+    /// Notifications handed over that the worker hasn't finished
+    QAtomicInt m_pending;
+    /// Set when the decoder goes away, the worker stops waiting
+    QAtomicInt m_stop;
+};
+
+} // namespace::SnailNvimQt
+
+Q_DECLARE_METATYPE(SnailNvimQt::RedrawBatch)
+
+#endif // PLUGIN_SNAIL_REDRAWDECODER_H
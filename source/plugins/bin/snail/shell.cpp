@@ -14,15 +14,22 @@
 #include "plugins/bin/snail/msgpackrequest.h"
 #include "plugins/bin/snail/konsole_wcwidth.h"
 
+/// Interval of the mouse drags and wheel steps sent to Nvim, a frame
+#define INPUT_FRAME_MSEC    16
+
 namespace SnailNvimQt {
 
 Shell::Shell(NvimConnector *nvim, QWidget *parent)
     :ShellWidget(parent), m_attached(false), m_nvimCon(nvim),
+     m_redraw(new RedrawDecoder(this)),
      m_font_bold(false), m_font_italic(false), m_font_underline(false),
      m_font_undercurl(false), m_mouseHide(true), m_hg_foreground(Qt::black),
-     m_hg_background(Qt::white), m_hg_special(QColor()), m_cursor_color(Qt::white),
+     m_hg_background(Qt::white), m_hg_special(QColor()), m_hg_attr(0),
+     m_hl_id(-1),
+     m_cursor_color(Qt::white),
      m_cursor_pos(0,0), m_insertMode(false), m_resizing(false),
-     m_mouse_wheel_delta_fraction(0, 0), m_neovimBusy(false)
+     m_mouse_wheel_delta_fraction(0, 0), m_neovimBusy(false),
+     m_wheelSteps(0, 0), m_inputInFlight(false)
 {
     setAttribute(Qt::WA_KeyCompression, false);
     setAcceptDrops(true);
@@ -31,6 +38,9 @@ Shell::Shell(NvimConnector *nvim, QWidget *parent)
     m_mouseclick_timer.setSingleShot(true);
     connect(&m_mouseclick_timer, &QTimer::timeout,
             this, &Shell::mouseClickReset);
+    m_inputTimer.setSingleShot(true);
+    connect(&m_inputTimer, &QTimer::timeout,
+            this, &Shell::sendInput);
 
     setAttribute(Qt::WA_InputMethodEnabled, true); // IM Tooltip
     m_tooltip = new QLabel(this);
@@ -150,15 +160,34 @@ Shell::~Shell()
     {
         m_nvimCon->detachUi();
     }
+
+    if(m_nvimCon)
+    {
+        m_nvimCon->setNotificationHandler("redraw", NULL);
+    }
 }
 
 void Shell::setAttached(bool attached)
 {
     m_attached = attached;
+    m_inputInFlight = false;
+
+    if(!attached)
+    {
+        m_shmGrid.close();
+    }
 
     if(attached)
     {
         updateWindowId();
+
+        if(m_nvimCon->canShareGrid())
+        {
+            // Cells from the shared memory instead of redraw:put
+            m_nvimCon->neovimObject()->nvim_ui_set_option("ext_shmgrid",
+                                                          true);
+        }
+
         m_nvimCon->neovimObject()->nvim_set_var("GuiFont", fontDesc());
 
         if(isWindow())
@@ -221,6 +250,10 @@ void Shell::init(void)
 
     connect(m_nvimCon->neovimObject(), &Nvim::neovimNotification,
             this, &Shell::handleNeovimNotification);
+    // Redraw notifications skip the QVariant conversion
+    connect(m_redraw, &RedrawDecoder::redraw,
+            this, &Shell::handleRedrawBatch);
+    m_nvimCon->setNotificationHandler("redraw", m_redraw);
     connect(m_nvimCon->neovimObject(), &Nvim::on_nvim_ui_try_resize,
             this, &Shell::neovimResizeFinished);
     QRect screenRect = QApplication::desktop()->availableGeometry(this);
@@ -272,83 +305,95 @@ void Shell::handleResize(uint64_t n_cols, uint64_t n_rows)
     emit neovimResized(rows(), columns());
 }
 
-void Shell::handleHighlightSet(const QVariantMap &attrs)
+void Shell::handleHighlightSet(const RedrawAttrs &attrs)
 {
-    if(attrs.contains("foreground"))
-    {
-        /// @todo: When does Nvim send -1
-        m_hg_foreground =
-            color(attrs.value("foreground").toLongLong(), foreground());
-    }
-    else
-    {
-        m_hg_foreground = foreground();
-    }
+    m_hg_foreground = color(attrs.foreground, foreground());
+    m_hg_background = color(attrs.background, background());
+    m_hg_special = color(attrs.special, special());
 
-    if(attrs.contains("background"))
-    {
-        m_hg_background =
-            color(attrs.value("background").toLongLong(), background());
-    }
-    else
-    {
-        m_hg_background = background();
-    }
-
-    if(attrs.contains(("special")))
-    {
-        m_hg_special = color(attrs.value("special").toLongLong(), special());
-    }
-    else
-    {
-        m_hg_special = special();
-    }
-
-    if(attrs.contains("reverse"))
+    if(attrs.flags & RedrawAttrs::Reverse)
     {
         auto tmp = m_hg_background;
         m_hg_background = m_hg_foreground;
         m_hg_foreground = tmp;
     }
 
-    m_font_bold = attrs.value("bold").toBool();
-    m_font_italic = attrs.value("italic").toBool();
-    m_font_undercurl = attrs.value("undercurl").toBool();
-    m_font_underline = attrs.value("underline").toBool();
+    m_font_bold = attrs.flags & RedrawAttrs::Bold;
+    m_font_italic = attrs.flags & RedrawAttrs::Italic;
+    m_font_undercurl = attrs.flags & RedrawAttrs::Undercurl;
+    m_font_underline = attrs.flags & RedrawAttrs::Underline;
+    internHighlight();
 }
 
-/// Paint a character and advance the cursor
-void Shell::handlePut(const QVariantList &args)
+/// Look up the highlight attributes in the attribute table once, puts
+/// only carry their index
+void Shell::internHighlight(void)
 {
-    if(args.size() != 1
-       || (QMetaType::Type)args.at(0).type() != QMetaType::QByteArray)
-    {
-        qWarning() << "Unexpected arguments for redraw:put" << args;
-        return;
-    }
-
-    QString text = m_nvimCon->decode(args.at(0).toByteArray());
-
-    if(!text.isEmpty())
-    {
-        int cols = put(text,
-                       m_cursor_pos.y(),
-                       m_cursor_pos.x(),
-                       m_hg_foreground,
+    m_hg_attr = attrId(m_hg_foreground,
                        m_hg_background,
                        m_hg_special,
                        m_font_bold,
                        m_font_italic,
                        m_font_underline,
                        m_font_undercurl);
+}
+
+/// Paint text and advance the cursor
+void Shell::handlePut(const QString &text)
+{
+    if(!text.isEmpty())
+    {
+        int cols = put(text,
+                       m_cursor_pos.y(),
+                       m_cursor_pos.x(),
+                       m_hg_attr);
 
         // Move cursor ahead
-        update(neovimCursorRect());
         setNeovimCursor(m_cursor_pos.y(), m_cursor_pos.x()+cols);
-        update(neovimCursorRect());
     }
 }
 
+/// Remember the attributes of a highlight id for redraw:line
+void Shell::handleHighlightDefine(qint64 id, const RedrawAttrs &attrs)
+{
+    m_hl_defs.insert(id, attrs);
+
+    if(id == m_hl_id)
+    {
+        m_hl_id = -1;
+    }
+}
+
+/// Paint the cells of a line, [text, hl_id, repeat] each, from row/col
+/// on and move the cursor after them, like a put per cell would. Every
+/// cell takes one column, an empty one is the right half of a double-width
+/// character: the columns don't depend on the width Qt gives a character.
+void Shell::handleLine(int row, int col, const QVector<RedrawCell> &cells)
+{
+    foreach(const RedrawCell &cell, cells)
+    {
+        if(cell.text.isEmpty())
+        {
+            col += cell.repeat;
+            continue;
+        }
+
+        if(cell.hlId != m_hl_id)
+        {
+            handleHighlightSet(m_hl_defs.value(cell.hlId));
+            m_hl_id = cell.hlId;
+        }
+
+        for(int i = 0; i < cell.repeat; i++)
+        {
+            put(cell.text, row, col, m_hg_attr);
+            col++;
+        }
+    }
+
+    setNeovimCursor(row, col);
+}
+
 /// Scroll shell contents by *count* lines, a positive count scrolls
 /// lines to the top, a negative number scrolls lines to the bottom.
 ///
@@ -356,51 +401,103 @@ void Shell::handlePut(const QVariantList &args)
 ///   with the background color.
 /// - The scrolled area can be the entire shell, or a region defined
 ///   by the set_scroll_region notification
-void Shell::handleScroll(const QVariantList &args)
+void Shell::handleScroll(qint64 count)
 {
-    if(!args.at(0).canConvert<qint64>())
-    {
-        qWarning() << "Unexpected arguments for redraw:scroll" << args;
-        return;
-    }
-
-    qint64 count = args.at(0).toULongLong();
+    scrollShellRegion(m_scroll_region.top(),
+                      m_scroll_region.bottom(),
+                      m_scroll_region.left(),
+                      m_scroll_region.right(),
+                      (int)count);
 
-    // Keep track of the cursor position, repaint
-    // over its old position after the scroll
+    // The cursor was painted into the scrolled pixels,
+    // repaint over its old position
     if(m_scroll_region.contains(m_cursor_pos))
     {
         QPoint old_cursor_pos = m_cursor_pos;
         old_cursor_pos.setY((int)(old_cursor_pos.y()-count));
-        QRect cr = neovimCursorRect(old_cursor_pos);
-        update(cr);
+        markCursorDirty(old_cursor_pos);
     }
+}
 
-    scrollShellRegion(m_scroll_region.top(),
-                      m_scroll_region.bottom(),
-                      m_scroll_region.left(),
-                      m_scroll_region.right(),
-                      (int)count);
+void Shell::handleSetScrollRegion(qint64 top, qint64 bot,
+                                  qint64 left, qint64 right)
+{
+    m_scroll_region = QRect(QPoint((int)left, (int)top),
+                            QPoint((int)(right+1), (int)(bot+1)));
 }
 
-void Shell::handleSetScrollRegion(const QVariantList &opargs)
+/// Apply the updates of a redraw notification, see RedrawDecoder
+void Shell::handleRedrawBatch(const RedrawBatch &batch)
 {
-    if(opargs.size() < 4)
+    // Repaint once, after the whole batch
+    beginUpdates();
+
+    foreach(const RedrawOp &op, batch)
     {
-        qWarning() << "Unexpected arguments for redraw:set_scroll_region"
-                   << opargs;
-        return;
+        switch(op.event)
+        {
+            case RedrawOp::Put:
+            {
+                handlePut(op.text);
+                break;
+            }
+            case RedrawOp::CursorGoto:
+            {
+                setNeovimCursor(op.args[0], op.args[1]);
+                break;
+            }
+            case RedrawOp::HighlightSet:
+            {
+                handleHighlightSet(op.attrs);
+                m_hl_id = -1;
+                break;
+            }
+            case RedrawOp::HighlightDefine:
+            {
+                handleHighlightDefine(op.args[0], op.attrs);
+                break;
+            }
+            case RedrawOp::Line:
+            {
+                handleLine((int)op.args[0], (int)op.args[1], op.cells);
+                break;
+            }
+            case RedrawOp::Scroll:
+            {
+                handleScroll(op.args[0]);
+                break;
+            }
+            case RedrawOp::SetScrollRegion:
+            {
+                handleSetScrollRegion(op.args[0], op.args[1],
+                                      op.args[2], op.args[3]);
+                break;
+            }
+            case RedrawOp::Clear:
+            {
+                clearShell(m_hg_background);
+                break;
+            }
+            case RedrawOp::EolClear:
+            {
+                clearRegion(m_cursor_pos.y(),
+                            m_cursor_pos.x(),
+                            m_cursor_pos.y()+1,
+                            columns());
+                break;
+            }
+            default:
+            {
+                handleRedraw(op.name, op.generic);
+                break;
+            }
+        }
     }
 
-    qint64 top = opargs.at(0).toULongLong();
-    qint64 bot = opargs.at(1).toULongLong();
-    qint64 left = opargs.at(2).toULongLong();
-    qint64 right = opargs.at(3).toULongLong();
-
-    m_scroll_region = QRect(QPoint((int)left, (int)top),
-                            QPoint((int)(right+1), (int)(bot+1)));
+    endUpdates();
 }
 
+/// Apply the redraw updates RedrawDecoder does not decode
 void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
 {
     if(name == "update_fg")
@@ -420,6 +517,8 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
         }
 
         m_hg_foreground = foreground();
+        internHighlight();
+        m_shmAttrIds.fill(-1);
     }
     else if(name == "update_bg")
     {
@@ -438,6 +537,8 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
         }
 
         m_hg_background = background();
+        internHighlight();
+        m_shmAttrIds.fill(-1);
         update();
     }
     else if(name == "update_sp")
@@ -457,6 +558,8 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
         }
 
         m_hg_special = special();
+        internHighlight();
+        m_shmAttrIds.fill(-1);
     }
     else if(name == "resize")
     {
@@ -471,59 +574,10 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
 
         handleResize(opargs.at(0).toULongLong(), opargs.at(1).toULongLong());
     }
-    else if(name == "clear")
-    {
-        clearShell(m_hg_background);
-    }
     else if(name == "bell")
     {
         QApplication::beep();
     }
-    else if(name == "eol_clear")
-    {
-        clearRegion(m_cursor_pos.y(),
-                    m_cursor_pos.x(),
-                    m_cursor_pos.y()+1,
-                    columns());
-    }
-    else if(name == "cursor_goto")
-    {
-        if(opargs.size() < 2
-           || !opargs.at(0).canConvert<quint64>()
-           || !opargs.at(1).canConvert<quint64>())
-        {
-            qWarning() << "Unexpected arguments for redraw:"
-                       << name << opargs;
-            return;
-        }
-
-        setNeovimCursor(opargs.at(0).toULongLong(),
-                        opargs.at(1).toULongLong());
-    }
-    else if(name == "highlight_set")
-    {
-        if(opargs.size() < 1
-           && (QMetaType::Type)opargs.at(0).type() != QMetaType::QVariantMap)
-        {
-            qWarning() << "Unexpected argument for redraw:"
-                       << name << opargs;
-            return;
-        }
-
-        handleHighlightSet(opargs.at(0).toMap());
-    }
-    else if(name == "put")
-    {
-        handlePut(opargs);
-    }
-    else if(name == "scroll")
-    {
-        handleScroll(opargs);
-    }
-    else if(name == "set_scroll_region")
-    {
-        handleSetScrollRegion(opargs);
-    }
     else if(name == "mouse_on")
     {
         // See :h mouse
@@ -540,7 +594,7 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
             return;
         }
 
-        QString mode = m_nvimCon->decode(opargs.at(0).toByteArray());
+        QString mode = decode(opargs.at(0).toByteArray());
         handleModeChange(mode);
     }
     else if(name == "cursor_on")
@@ -565,6 +619,14 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
     {
         //
     }
+    else if(name == "grid_shm")
+    {
+        handleGridShm(opargs);
+    }
+    else if(name == "grid_flush")
+    {
+        handleGridFlush(opargs);
+    }
     else
     {
         qDebug() << "Received unknown redraw notification"
@@ -572,11 +634,141 @@ void Shell::handleRedraw(const QByteArray &name, const QVariantList &opargs)
     }
 }
 
+/// Map the shared memory grid named in redraw:grid_shm, an empty name
+/// drops it. If it can't be mapped, Nvim is asked to send the cells in
+/// the redraw notifications again.
+void Shell::handleGridShm(const QVariantList &opargs)
+{
+    if(opargs.size() < 3
+       || !opargs.at(0).canConvert<QByteArray>()
+       || !opargs.at(1).canConvert<quint64>()
+       || !opargs.at(2).canConvert<quint64>())
+    {
+        qWarning() << "Unexpected arguments for redraw:grid_shm" << opargs;
+        return;
+    }
+
+    QByteArray name = opargs.at(0).toByteArray();
+    m_shmAttrIds.fill(-1, SHMGRID_ATTRS_MAX);
+
+    if(name.isEmpty())
+    {
+        m_shmGrid.close();
+        return;
+    }
+
+    if(!m_shmGrid.open(name, opargs.at(1).toInt(), opargs.at(2).toInt())
+       && m_nvimCon)
+    {
+        m_nvimCon->neovimObject()->nvim_ui_set_option("ext_shmgrid", false);
+    }
+}
+
+/// Copy the rows of a frame of the shared memory grid that changed,
+/// redraw:grid_flush [seq, top, bot], and let Nvim know it was read
+void Shell::handleGridFlush(const QVariantList &opargs)
+{
+    if(opargs.size() < 3
+       || !opargs.at(0).canConvert<quint64>()
+       || !opargs.at(1).canConvert<qint64>()
+       || !opargs.at(2).canConvert<qint64>())
+    {
+        qWarning() << "Unexpected arguments for redraw:grid_flush" << opargs;
+        return;
+    }
+
+    if(!m_shmGrid.isOpen())
+    {
+        return;
+    }
+
+    quint32 seq = opargs.at(0).toUInt();
+    int top = qMax(opargs.at(1).toInt(), 0);
+    int bot = qMin(opargs.at(2).toInt(), qMin(m_shmGrid.rows(), rows()) - 1);
+    int cols = qMin(m_shmGrid.columns(), columns());
+    m_shmRow.resize(cols);
+
+    for(int row=top; row<=bot; row++)
+    {
+        const shmgrid_cell_st *in = m_shmGrid.row(seq, row);
+        Cell *out = m_shmRow.data();
+
+        for(int col=0; col<cols; col++)
+        {
+            // Like put(), the right half of a double width character is
+            // a default cell
+            out[col] = in[col].chr == 0 ? Cell()
+                       : Cell(in[col].chr, shmAttr(in[col].attr));
+        }
+
+        setCells(row, 0, out, cols);
+    }
+
+    m_shmGrid.ack(seq);
+    // The cells were painted over the cursor
+    markCursorDirty(m_cursor_pos);
+}
+
+/// The index in the attribute table of the attributes @b id of the shared
+/// memory grid
+quint16 Shell::shmAttr(quint32 id)
+{
+    if(id < (quint32)m_shmAttrIds.size() && m_shmAttrIds.at(id) >= 0)
+    {
+        return (quint16)m_shmAttrIds.at(id);
+    }
+
+    const shmgrid_attr_st *in = m_shmGrid.attr(id);
+
+    if(!in || id >= (quint32)m_shmAttrIds.size())
+    {
+        return 0;
+    }
+
+    RedrawAttrs attrs;
+    attrs.foreground = in->foreground;
+    attrs.background = in->background;
+    attrs.special = in->special;
+
+    static const struct
+    {
+        quint32 shm;
+        int flag;
+    } flags[] =
+    {
+        { kShmgridBold,      RedrawAttrs::Bold      },
+        { kShmgridItalic,    RedrawAttrs::Italic    },
+        { kShmgridUnderline, RedrawAttrs::Underline },
+        { kShmgridUndercurl, RedrawAttrs::Undercurl },
+        { kShmgridReverse,   RedrawAttrs::Reverse   },
+    };
+
+    for(size_t i=0; i<sizeof(flags)/sizeof(flags[0]); i++)
+    {
+        if(in->flags & flags[i].shm)
+        {
+            attrs.flags |= flags[i].flag;
+        }
+    }
+
+    handleHighlightSet(attrs);
+    m_hl_id = -1;
+    m_shmAttrIds[id] = m_hg_attr;
+    return m_hg_attr;
+}
+
 void Shell::setNeovimCursor(quint64 row, quint64 col)
 {
-    update(neovimCursorRect());
+    markCursorDirty(m_cursor_pos);
     m_cursor_pos = QPoint((int)col, (int)row);
-    update(neovimCursorRect());
+    markCursorDirty(m_cursor_pos);
+}
+
+/// Repaint the cells covered by the cursor at @b pos
+void Shell::markCursorDirty(QPoint pos)
+{
+    const Cell &c = contents().constValue(pos.y(), pos.x());
+    markDirty(pos.y(), pos.x(), pos.x() + (c.doubleWidth ? 2 : 1));
 }
 
 void Shell::handleModeChange(const QString &mode)
@@ -600,10 +792,22 @@ void Shell::handleSetTitle(const QVariantList &opargs)
         return;
     }
 
-    QString title = m_nvimCon->decode(opargs.at(0).toByteArray());
+    QString title = decode(opargs.at(0).toByteArray());
     emit neovimTitleChanged(title);
 }
 
+/// Decode @b text from Nvim, as UTF-8 if there is no connector, e.g.
+/// when replaying a recorded session
+QString Shell::decode(const QByteArray &text) const
+{
+    if(m_nvimCon == NULL)
+    {
+        return QString::fromUtf8(text);
+    }
+
+    return m_nvimCon->decode(text);
+}
+
 void Shell::handleBusy(bool busy)
 {
     m_neovimBusy = busy;
@@ -690,53 +894,13 @@ void Shell::handleNeovimNotification(const QByteArray &name,
             qDebug() << "Nvim requested a GUI close";
             emit neovimGuiCloseRequest();
         }
-
-        return;
-    }
-    else if(name != "redraw")
-    {
-        return;
-    }
-
-    foreach(const QVariant &update_item, args)
-    {
-        if((QMetaType::Type)update_item.type() != QMetaType::QVariantList)
-        {
-            qWarning() << "Received unexpected redraw operation"
-                       << update_item;
-            continue;
-        }
-
-        const QVariantList &redrawupdate = update_item.toList();
-
-        if(redrawupdate.size() < 2)
-        {
-            qWarning() << "Received unexpected redraw operation"
-                       << update_item;
-            continue;
-        }
-
-        const QByteArray &name = redrawupdate.at(0).toByteArray();
-        const QVariantList &update_args = redrawupdate.mid(1);
-
-        foreach(const QVariant &opargs_var, update_args)
-        {
-            if((QMetaType::Type)opargs_var.type() != QMetaType::QVariantList)
-            {
-                qWarning() << "Received unexpected redraw "
-                              "arguments, expecting list" << opargs_var;
-                continue;
-            }
-
-            const QVariantList &opargs = opargs_var.toList();
-            handleRedraw(name, opargs);
-        }
     }
 }
 
 void Shell::paintEvent(QPaintEvent *ev)
 {
-    if(!m_attached)
+    // Without a connector the contents come from replayed redraws
+    if(m_nvimCon && !m_attached)
     {
         QPainter painter(this);
         painter.fillRect(rect(), palette().window());
@@ -790,8 +954,7 @@ void Shell::keyPressEvent(QKeyEvent *ev)
         return;
     }
 
-    m_nvimCon->neovimObject()->nvim_input(m_nvimCon->encode(inp));
-    // FIXME: bytes might not be written, and need to be buffered
+    queueInput(inp);
 }
 
 void Shell::neovimMouseEvent(QMouseEvent *ev)
@@ -836,8 +999,17 @@ void Shell::neovimMouseEvent(QMouseEvent *ev)
         return;
     }
 
-    m_nvimCon->neovimObject()->nvim_input(inp.toLatin1());
+    if(ev->type() == QEvent::MouseMove)
+    {
+        // Only the latest drag position matters
+        m_pendingMove = inp;
+        scheduleInput(INPUT_FRAME_MSEC);
+        return;
+    }
+
+    queueInput(inp);
 }
+
 void Shell::mousePressEvent(QMouseEvent *ev)
 {
     m_mouseclick_timer.start();
@@ -886,6 +1058,13 @@ void Shell::mouseMoveEvent(QMouseEvent *ev)
     unsetCursor();
     QPoint pos(ev->x()/cellSize().width(), ev->y()/cellSize().height());
 
+    // Nvim is busy, do not pile up drags
+    if(m_neovimBusy)
+    {
+        m_mouse_pos = pos;
+        return;
+    }
+
     if(pos != m_mouse_pos)
     {
         m_mouse_pos = pos;
@@ -896,6 +1075,13 @@ void Shell::mouseMoveEvent(QMouseEvent *ev)
 
 void Shell::wheelEvent(QWheelEvent *ev)
 {
+    // Nvim is busy, do not pile up scrolls
+    if(m_neovimBusy)
+    {
+        m_mouse_wheel_delta_fraction = QPoint(0, 0);
+        return;
+    }
+
 #ifdef Q_OS_MAC
     // For some reason <ScrollWheel*> scrolls multiple lines at once. we have
     //  to account for it, to make sure that pixelDelta() is used correctly.
@@ -916,9 +1102,13 @@ void Shell::wheelEvent(QWheelEvent *ev)
     int horiz = cell_delta.x();
     int vert = cell_delta.y();
 #else
-    int horiz, vert;
-    horiz = ev->angleDelta().x();
-    vert = ev->angleDelta().y();
+    // High resolution wheels and touchpads send fractions of a step
+    const int scroll_step = QWheelEvent::DefaultDeltasPerStep;
+    QPoint total_delta = m_mouse_wheel_delta_fraction + ev->angleDelta();
+    int horiz = total_delta.x() / scroll_step;
+    int vert = total_delta.y() / scroll_step;
+    m_mouse_wheel_delta_fraction =
+        total_delta - QPoint(horiz * scroll_step, vert * scroll_step);
 #endif
 
     if(horiz == 0 && vert == 0)
@@ -928,25 +1118,112 @@ void Shell::wheelEvent(QWheelEvent *ev)
 
     QPoint pos(ev->x()/cellSize().width(),
                ev->y()/cellSize().height());
-    QString inp;
 
-    if(vert != 0)
+    if(m_wheelSteps != QPoint(0, 0)
+       && (pos != m_wheelPos || ev->modifiers() != m_wheelMods))
+    {
+        commitPointerInput();
+    }
+
+    // Sent as whole steps once per frame
+    m_wheelSteps += QPoint(horiz, vert);
+    m_wheelPos = pos;
+    m_wheelMods = ev->modifiers();
+    scheduleInput(INPUT_FRAME_MSEC);
+}
+
+/// Append @b inp to the input for Nvim, after the pointer input so far.
+/// Everything queued before the next event loop turn is sent at once.
+void Shell::queueInput(const QString &inp)
+{
+    commitPointerInput();
+    m_pendingInput += inp;
+    scheduleInput(0);
+}
+
+/// Send the pending input in @b msec at the latest
+void Shell::scheduleInput(int msec)
+{
+    if(!m_inputTimer.isActive() || m_inputTimer.remainingTime() > msec)
+    {
+        m_inputTimer.start(msec);
+    }
+}
+
+/// Move the latest mouse drag and the wheel steps to m_pendingInput
+void Shell::commitPointerInput(void)
+{
+    m_pendingInput += m_pendingMove;
+    m_pendingMove.clear();
+
+    QString mods = Input.modPrefix(m_wheelMods);
+    QString pos = QString("<%1,%2>").arg(m_wheelPos.x()).arg(m_wheelPos.y());
+
+    for(int i=0; i<qAbs(m_wheelSteps.y()); i++)
+    {
+        m_pendingInput += QString("<%1ScrollWheel%2>%3")
+                          .arg(mods)
+                          .arg(m_wheelSteps.y() > 0 ? "Up" : "Down")
+                          .arg(pos);
+    }
+
+    for(int i=0; i<qAbs(m_wheelSteps.x()); i++)
+    {
+        m_pendingInput += QString("<%1ScrollWheel%2>%3")
+                          .arg(mods)
+                          .arg(m_wheelSteps.x() > 0 ? "Left" : "Right")
+                          .arg(pos);
+    }
+
+    m_wheelSteps = QPoint(0, 0);
+}
+
+/// Send the pending input as one nvim_input call. While a call waits for
+/// its response new input is merged, and sent when it arrives.
+void Shell::sendInput(void)
+{
+    if(!m_nvimCon || !m_attached)
     {
-        inp += QString("<%1ScrollWheel%2><%3,%4>")
-               .arg(Input.modPrefix(ev->modifiers()))
-               .arg(vert > 0 ? "Up" : "Down")
-               .arg(pos.x()).arg(pos.y());
+        m_pendingInput.clear();
+        m_pendingMove.clear();
+        m_wheelSteps = QPoint(0, 0);
+        return;
     }
 
-    if(horiz != 0)
+    if(m_inputInFlight)
+    {
+        return;
+    }
+
+    commitPointerInput();
+
+    if(m_pendingInput.isEmpty())
     {
-        inp += QString("<%1ScrollWheel%2><%3,%4>")
-               .arg(Input.modPrefix(ev->modifiers()))
-               .arg(horiz > 0 ? "Left" : "Right")
-               .arg(pos.x()).arg(pos.y());
+        return;
     }
 
-    m_nvimCon->neovimObject()->nvim_input(inp.toLatin1());
+    MsgpackRequest *req = m_nvimCon->neovimObject()->nvim_input(
+        m_nvimCon->encode(m_pendingInput));
+    m_pendingInput.clear();
+    m_inputInFlight = true;
+
+    connect(req, &MsgpackRequest::finished,
+            this, &Shell::inputSent);
+    connect(req, &MsgpackRequest::error,
+            this, &Shell::inputSent);
+}
+
+/// The last nvim_input call is done, send what came in meanwhile
+void Shell::inputSent(void)
+{
+    m_inputInFlight = false;
+
+    if(!m_pendingInput.isEmpty()
+       || !m_pendingMove.isEmpty()
+       || m_wheelSteps != QPoint(0, 0))
+    {
+        scheduleInput(0);
+    }
 }
 
 void Shell::updateWindowId(void)
@@ -1084,13 +1361,13 @@ void Shell::closeEvent(QCloseEvent *ev)
 
 void Shell::focusInEvent(QFocusEvent *ev)
 {
-    m_nvimCon->neovimObject()->nvim_input("<FocusGained>");
+    queueInput("<FocusGained>");
     QWidget::focusInEvent(ev);
 }
 
 void Shell::focusOutEvent(QFocusEvent *ev)
 {
-    m_nvimCon->neovimObject()->nvim_input("<FocusLost>");
+    queueInput("<FocusLost>");
     QWidget::focusOutEvent(ev);
 }
 
@@ -1136,8 +1413,7 @@ void Shell::inputMethodEvent(QInputMethodEvent *ev)
 {
     if(!ev->commitString().isEmpty())
     {
-        QByteArray s = m_nvimCon->encode(ev->commitString());
-        m_nvimCon->neovimObject()->nvim_input(s);
+        queueInput(ev->commitString());
         tooltip("");
     }
     else
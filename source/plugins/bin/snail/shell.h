@@ -11,8 +11,11 @@
 #include <QTimer>
 #include <QUrl>
 #include <QList>
+#include <QHash>
 #include "plugins/bin/snail/shellwidget.h"
 #include "plugins/bin/snail/nvimconnector.h"
+#include "plugins/bin/snail/redrawdecoder.h"
+#include "plugins/bin/snail/shmgrid.h"
 
 namespace SnailNvimQt {
 
@@ -45,6 +48,7 @@ signals:
 public slots:
     void handleNeovimNotification(const QByteArray &name,
                                   const QVariantList &args);
+    void handleRedrawBatch(const SnailNvimQt::RedrawBatch &batch);
     void resizeNeovim(const QSize &);
     void resizeNeovim(int n_cols, int n_rows);
     bool setGuiFont(const QString &fdesc, bool force = false);
@@ -71,6 +75,7 @@ protected:
     QRect neovimCursorRect(void) const;
     QRect neovimCursorRect(QPoint at) const;
     void setNeovimCursor(quint64 col, quint64 row);
+    void markCursorDirty(QPoint pos);
 
     virtual void resizeEvent(QResizeEvent *ev) Q_DECL_OVERRIDE;
     virtual void keyPressEvent(QKeyEvent *ev) Q_DECL_OVERRIDE;
@@ -84,27 +89,44 @@ protected:
     virtual void dropEvent(QDropEvent *) Q_DECL_OVERRIDE;
 
     virtual void handleResize(uint64_t cols, uint64_t rows);
-    virtual void handlePut(const QVariantList &args);
-    virtual void handleHighlightSet(const QVariantMap &args);
+    virtual void handlePut(const QString &text);
+    virtual void handleHighlightSet(const RedrawAttrs &attrs);
+    virtual void handleHighlightDefine(qint64 id, const RedrawAttrs &attrs);
+    virtual void handleLine(int row, int col,
+                            const QVector<RedrawCell> &cells);
     virtual void handleRedraw(const QByteArray &name, const QVariantList &args);
-    virtual void handleScroll(const QVariantList &args);
+    virtual void handleScroll(qint64 count);
     virtual void handleModeChange(const QString &mode);
     virtual void handleSetTitle(const QVariantList &opargs);
-    virtual void handleSetScrollRegion(const QVariantList &opargs);
+    virtual void handleSetScrollRegion(qint64 top, qint64 bot,
+                                       qint64 left, qint64 right);
     virtual void handleBusy(bool);
+    virtual void handleGridShm(const QVariantList &opargs);
+    virtual void handleGridFlush(const QVariantList &opargs);
+    quint16 shmAttr(quint32 id);
+    void internHighlight(void);
+    QString decode(const QByteArray &text) const;
 
     void neovimMouseEvent(QMouseEvent *ev);
     virtual void mousePressEvent(QMouseEvent *ev) Q_DECL_OVERRIDE;
     virtual void mouseReleaseEvent(QMouseEvent *ev) Q_DECL_OVERRIDE;
     virtual void mouseMoveEvent(QMouseEvent *ev) Q_DECL_OVERRIDE;
 
+    void queueInput(const QString &inp);
+    void scheduleInput(int msec);
+    void commitPointerInput(void);
+
 private slots:
     void setAttached(bool attached=true);
+    void sendInput(void);
+    void inputSent(void);
 
 private:
     bool m_attached;
 
     NvimConnector *m_nvimCon;
+    /// Decoder of the redraw notifications of m_nvimCon
+    RedrawDecoder *m_redraw;
 
     QList<QUrl> m_deferredOpen;
 
@@ -122,6 +144,13 @@ private:
     QColor m_hg_foreground;
     QColor m_hg_background;
     QColor m_hg_special;
+    /// Index of the m_hg_* and m_font_* attributes in the attribute table
+    quint16 m_hg_attr;
+
+    /// Attributes of the ids from redraw:hl_define
+    QHash<qint64, RedrawAttrs> m_hl_defs;
+    /// Id of the attributes in m_hg_*, -1 after redraw:highlight_set
+    qint64 m_hl_id;
 
     QColor m_cursor_color;
 
@@ -142,6 +171,27 @@ private:
     // Accumulates remainder of steppy scroll
     QPoint m_mouse_wheel_delta_fraction;
 
+    /// Input for the next nvim_input call, in order
+    QString m_pendingInput;
+    /// Latest mouse drag, replaced by the following ones
+    QString m_pendingMove;
+    /// Whole wheel steps (left, up) at m_wheelPos with m_wheelMods
+    QPoint m_wheelSteps;
+    QPoint m_wheelPos;
+    Qt::KeyboardModifiers m_wheelMods;
+    /// Sends m_pendingInput at the next event loop turn, or frame
+    QTimer m_inputTimer;
+    /// An nvim_input call is waiting for its response
+    bool m_inputInFlight;
+
+    /// Grid Nvim publishes in shared memory, see redraw:grid_shm
+    ShmGrid m_shmGrid;
+    /// Index in the attribute table of the attributes of m_shmGrid, -1
+    /// if not looked up yet
+    QVector<int> m_shmAttrIds;
+    /// A row of m_shmGrid as cells of the shell
+    QVector<Cell> m_shmRow;
+
     // Properties
     bool m_neovimBusy;
 };
@@ -1,21 +1,18 @@
 /// @file plugins/bin/snail/shellcontents.cpp
 
+#include <algorithm>
 #include <QFile>
 #include <QDebug>
 #include "plugins/bin/snail/shellcontents.h"
 #include "plugins/bin/snail/konsole_wcwidth.h"
 
-Cell ShellContents::invalidCell = Cell::invalid();;
+Cell ShellContents::invalidCell = Cell::invalid();
 
 /// Build shell contents from file,
 /// each line in the file is a shell line.
 bool ShellContents::fromFile(const QString &path)
 {
-    if(_data != NULL)
-    {
-        delete[] _data;
-    }
-
+    freeData();
     _rows = 1;
     _columns = 1;
     allocData();
@@ -40,60 +37,110 @@ bool ShellContents::fromFile(const QString &path)
 }
 
 ShellContents::ShellContents(int rows, int columns)
-    :_data(0), _rows(rows), _columns(columns)
+    :_data(0), _lines(0), _rows(rows), _columns(columns)
 {
     allocData();
+    attrId(CellAttrs());
 }
 
 ShellContents::~ShellContents()
 {
-    if(_data != NULL)
-    {
-        delete[] _data;
-    }
+    freeData();
 }
 
 ShellContents::ShellContents(const ShellContents &other)
-    :_data(0), _rows(other._rows), _columns(other._columns)
+    :_data(0), _lines(0), _attrs(other._attrs), _attrIds(other._attrIds),
+     _rows(other._rows), _columns(other._columns)
 {
     if(other._data != NULL)
     {
         allocData();
-        memcpy(_data, other._data, _rows*_columns);
+
+        for(int i=0; i<_rows; i++)
+        {
+            memcpy(_lines[i], other._lines[i], _columns*sizeof(Cell));
+        }
     }
 }
 
+/// The index of @b attrs in the attribute table, adding them if needed.
+/// The table only grows: cells keep their indexes for as long as they
+/// live.
+quint16 ShellContents::attrId(const CellAttrs &attrs)
+{
+    QHash<CellAttrs, quint16>::const_iterator it = _attrIds.constFind(attrs);
+
+    if(it != _attrIds.constEnd())
+    {
+        return it.value();
+    }
+
+    if(_attrs.size() > 0xFFFF)
+    {
+        qWarning() << "Attribute table is full, using the defaults";
+        return 0;
+    }
+
+    quint16 id = (quint16)_attrs.size();
+    _attrs.append(attrs);
+    _attrIds.insert(attrs, id);
+    return id;
+}
+
+/// The attributes at index @b id of the attribute table
+const CellAttrs &ShellContents::attrs(quint16 id) const
+{
+    if(id >= _attrs.size())
+    {
+        return _attrs.at(0);
+    }
+
+    return _attrs.at(id);
+}
+
 /// Allocates new shell data storage.
 /// This leaks memory, make sure to free _data if needed.
 void ShellContents::allocData(void)
 {
     _data = new Cell[_rows*_columns];
+    _lines = new Cell*[_rows];
+
+    for(int i=0; i<_rows; i++)
+    {
+        _lines[i] = &_data[i*_columns];
+    }
+}
+
+void ShellContents::freeData(void)
+{
+    delete[] _data;
+    delete[] _lines;
+    _data = NULL;
+    _lines = NULL;
 }
 
 void ShellContents::clearAll(QColor bg)
 {
-    for(int i=0; i<_rows; i++)
+    CellAttrs attrs;
+    attrs.backgroundColor = bg;
+    Cell blank = Cell::bg(attrId(attrs));
+
+    for(int i=0; i<_rows*_columns; i++)
     {
-        for(int j=0; j<_columns; j++)
-        {
-            _data[i*_columns+j] = Cell::bg(bg);
-        }
+        _data[i] = blank;
     }
 }
 
 void ShellContents::clearRow(int r, int startCol)
 {
-    if(r < 0 || r >= _rows || startCol < 0 || startCol > _rows)
+    if(r < 0 || r >= _rows || startCol < 0 || startCol > _columns)
     {
         return;
     }
 
-    int start = r*_columns + startCol;
-    int end = start + _columns;
-
-    for(int i=start; i<end-startCol; i++)
+    for(int j=startCol; j<_columns; j++)
     {
-        _data[i] = Cell();
+        _lines[r][j] = Cell();
     }
 }
 
@@ -145,17 +192,24 @@ void ShellContents::clearRegion(int row0,
         return;
     }
 
+    CellAttrs attrs;
+    attrs.backgroundColor = bg;
+    Cell blank = Cell::bg(attrId(attrs));
+
     for(int i=row0; i<row1; i++)
     {
         for(int j=col0; j<col1; j++)
         {
-            _data[i*_columns + j] = Cell::bg(bg);
+            _lines[i][j] = blank;
         }
     }
 }
 
 /// Scroll the region by count lines. (row1, col1) is
 /// the first position outside the scrolled area.
+///
+/// Regions as wide as the shell rotate their row pointers, other regions
+/// move their cells row by row. Rows scrolled into view are cleared.
 void ShellContents::scrollRegion(int row0,
                                  int row1,
                                  int col0,
@@ -174,37 +228,48 @@ void ShellContents::scrollRegion(int row0,
         return;
     }
 
-    int start, stop, inc;
+    int height = row1 - row0;
+    int shift = qMin(qAbs(count), height);
 
-    if(count > 0)
-    {
-        start = row0;
-        stop = row1;
-        inc = +1;
-    }
-    else
+    if(col0 == 0 && col1 == _columns)
     {
-        start = row1-1;
-        stop = row0-1;
-        inc = -1;
+        if(count > 0)
+        {
+            std::rotate(_lines + row0, _lines + row0 + shift, _lines + row1);
+        }
+        else
+        {
+            std::rotate(_lines + row0, _lines + row1 - shift, _lines + row1);
+        }
     }
-
-    for(int i=start; i!=stop; i+=inc)
+    else if(shift < height)
     {
-        int dst = i-count;
+        int ncols = (col1 - col0)*sizeof(Cell);
 
-        if(dst >= row0 && dst < row1)
+        if(count > 0)
+        {
+            for(int i=row0; i<row1-shift; i++)
+            {
+                memcpy(&_lines[i][col0], &_lines[i+shift][col0], ncols);
+            }
+        }
+        else
         {
-            // Copy line
-            memcpy(&_data[dst*_columns + col0],
-                   &_data[i*_columns + col0],
-                   (col1-col0)*sizeof(Cell));
+            for(int i=row1-1; i>=row0+shift; i--)
+            {
+                memcpy(&_lines[i][col0], &_lines[i-shift][col0], ncols);
+            }
         }
+    }
+
+    // Clear the exposed rows
+    int clear0 = (count > 0) ? row1 - shift : row0;
 
-        // Clear src line
+    for(int i=clear0; i<clear0+shift; i++)
+    {
         for(int j=col0; j<col1; j++)
         {
-            new(&_data[i*_columns + j]) Cell();
+            _lines[i][j] = Cell();
         }
     }
 }
@@ -228,6 +293,7 @@ void ShellContents::resize(int newRows, int newColumns)
     }
 
     Cell *old = _data;
+    Cell **oldLines = _lines;
     int oldRows = _rows;
     int oldColumns = _columns;
     _rows = newRows;
@@ -239,17 +305,11 @@ void ShellContents::resize(int newRows, int newColumns)
 
     for(int i=0; i<copyRows; i++)
     {
-        memcpy(&_data[i*_columns],
-               &old[i*oldColumns],
-               copyColumns*sizeof(Cell));
+        memcpy(_lines[i], oldLines[i], copyColumns*sizeof(Cell));
     }
 
     delete [] old;
-}
-
-const Cell *ShellContents::data(void)
-{
-    return _data;
+    delete [] oldLines;
 }
 
 Cell &ShellContents::value(int row, int column)
@@ -259,7 +319,7 @@ Cell &ShellContents::value(int row, int column)
         return invalidCell;
     }
 
-    return _data[row*_columns + column];
+    return _lines[row][column];
 }
 
 const Cell &ShellContents::constValue(int row, int column) const
@@ -269,7 +329,7 @@ const Cell &ShellContents::constValue(int row, int column) const
         return invalidCell;
     }
 
-    return _data[row*_columns + column];
+    return _lines[row][column];
 }
 
 /// Writes content to the shell, returns the number of columns written
@@ -283,6 +343,18 @@ int ShellContents::put(const QString &str,
                        bool italic,
                        bool underline,
                        bool undercurl)
+{
+    return put(str, row, column,
+               attrId(CellAttrs(fg, bg, sp,
+                                bold, italic, underline, undercurl)));
+}
+
+/// Writes content to the shell using the attributes at index @b attrId,
+/// returns the number of columns written
+int ShellContents::put(const QString &str,
+                       int row,
+                       int column,
+                       quint16 attrId)
 {
     if(row < 0
        || row >= _rows
@@ -293,11 +365,21 @@ int ShellContents::put(const QString &str,
     }
 
     int pos = column;
+    int len = str.size();
 
-    foreach(const QChar chr, str)
+    for(int i=0; i<len; i++)
     {
+        uint chr = str.at(i).unicode();
+
+        if(QChar::isHighSurrogate(chr) && i+1 < len
+           && str.at(i+1).isLowSurrogate())
+        {
+            chr = QChar::surrogateToUcs4(chr, str.at(i+1).unicode());
+            i++;
+        }
+
         Cell &c = value(row, pos);
-        c = Cell(chr, fg, bg, sp, bold, italic, underline, undercurl);
+        c = Cell(chr, attrId);
 
         if(c.doubleWidth)
         {
@@ -7,6 +7,8 @@
 #ifndef PLUGIN_SNAIL_SHELLCONTENTS_H
 #define PLUGIN_SNAIL_SHELLCONTENTS_H
 
+#include <QVector>
+#include <QHash>
 #include "plugins/bin/snail/cell.h"
 
 class ShellContents
@@ -27,15 +29,18 @@ public:
 
     bool fromFile(const QString &path);
 
-    const Cell *data(void);
     Cell &value(int row, int column);
     const Cell &constValue(int row, int column) const;
 
+    quint16 attrId(const CellAttrs &attrs);
+    const CellAttrs &attrs(quint16 id) const;
+
     int put(const QString &,
             int row, int column,
             QColor fg=Qt::black, QColor bg=Qt::white, QColor sp=QColor(),
             bool bold=false, bool italic=false,
             bool underline=false, bool undercurl=false);
+    int put(const QString &, int row, int column, quint16 attrId);
 
     void clearAll(QColor bg=QColor());
     void clearRow(int r, int startCol=0);
@@ -48,12 +53,20 @@ public:
 
 private:
     void allocData(void);
+    void freeData(void);
     bool verifyRegion(int &row0, int &row1, int &col0, int &col1);
 
-    // row*columns
+    // row*columns, in no particular row order
     Cell *_data;
+    /// The rows, pointing into _data. Scrolling a region as wide as the
+    /// shell rotates these instead of moving cells.
+    Cell **_lines;
     static Cell invalidCell;
 
+    /// Attributes of the cells, the default attributes are at 0
+    QVector<CellAttrs> _attrs;
+    QHash<CellAttrs, quint16> _attrIds;
+
     int _rows;
     int _columns;
 
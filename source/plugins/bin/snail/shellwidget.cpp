@@ -2,19 +2,27 @@
 
 #include <QPainter>
 #include <QPaintEvent>
+#include <QFontMetricsF>
 #include <QDebug>
 #include "plugins/bin/snail/shellwidget.h"
 #include "plugins/bin/snail/helpers.h"
 
 ShellWidget::ShellWidget(QWidget *parent)
     :QWidget(parent), m_contents(0,0), m_bgColor(Qt::white),
-     m_fgColor(Qt::black), m_spColor(QColor()), m_lineSpace(0)
+     m_fgColor(Qt::black), m_spColor(QColor()), m_lineSpace(0),
+     m_textCache(4096), m_paintVariant(-1), m_updating(0)
 {
     setAttribute(Qt::WA_OpaquePaintEvent);
     setAttribute(Qt::WA_KeyCompression, false);
     setFocusPolicy(Qt::StrongFocus);
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
     setMouseTracking(true);
+
+    for(int i = 0; i < 4; i++)
+    {
+        m_runVariants[i] = false;
+    }
+
     setDefaultFont();
 }
 
@@ -86,6 +94,15 @@ bool ShellWidget::setShellFont(const QString &family,
 void ShellWidget::setFont(const QFont &f)
 {
     QWidget::setFont(f);
+
+    for(int i = 0; i < 4; i++)
+    {
+        m_fontVariants[i] = f;
+        m_fontVariants[i].setBold(i & 1);
+        m_fontVariants[i].setItalic(i & 2);
+    }
+
+    m_textCache.clear();
 }
 
 void ShellWidget::setLineSpace(unsigned int height)
@@ -110,6 +127,23 @@ void ShellWidget::setCellSize(void)
     m_cellSize = QSize(fm.width('W'),
                        qMax(fm.lineSpacing(), fm.height()) + m_lineSpace);
     setSizeIncrement(m_cellSize);
+
+    // A run is laid out with the advances of the font, its glyphs stay on
+    // the cell grid only when every run char is exactly one cell wide.
+    for(int i = 0; i < 4; i++)
+    {
+        QFontMetricsF vfm(m_fontVariants[i]);
+        m_runVariants[i] = true;
+
+        for(uint c = 0x20; c < 0x100; c++)
+        {
+            if(QChar(c).isPrint() && vfm.width(QChar(c)) != m_cellSize.width())
+            {
+                m_runVariants[i] = false;
+                break;
+            }
+        }
+    }
 }
 
 QSize ShellWidget::cellSize(void) const
@@ -117,129 +151,188 @@ QSize ShellWidget::cellSize(void) const
     return m_cellSize;
 }
 
-void ShellWidget::paintEvent(QPaintEvent *ev)
+/// Characters that can be joined in a run: their glyphs are one cell wide
+/// in a monospace font, see setCellSize(). Others may come from fallback
+/// fonts with other advances, each of them is drawn in its own cell.
+static inline bool isRunChar(uint c)
 {
-    QPainter p(this);
+    return c < 0x100;
+}
 
-    foreach(QRect rect, ev->region().rects())
+/// The laid out @b text in font @b variant, from the text cache
+const QStaticText &ShellWidget::staticText(const QString &text, int variant)
+{
+    QPair<QString, int> key(text, variant);
+    QStaticText *st = m_textCache.object(key);
+
+    if(!st)
     {
-        int start_row = rect.top() / m_cellSize.height();
-        int end_row = rect.bottom() / m_cellSize.height();
-        int start_col = rect.left() / m_cellSize.width();
-        int end_col = rect.right() / m_cellSize.width();
+        st = new QStaticText(text);
+        st->setTextFormat(Qt::PlainText);
+        st->setPerformanceHint(QStaticText::AggressiveCaching);
+        st->prepare(QTransform(), m_fontVariants[variant]);
+        m_textCache.insert(key, st);
+    }
+
+    return *st;
+}
+
+/// Paint @b ncols cells from @b row, @b col with @b attrs: the
+/// background, the @b text and the underline.
+void ShellWidget::paintRun(QPainter &p, int row, int col, int ncols,
+                           const QString &text, const CellAttrs &attrs)
+{
+    QRect r = absoluteShellRect(row, col, 1, ncols);
+    QColor fg = attrs.foregroundColor.isValid() ? attrs.foregroundColor
+                                                : m_fgColor;
+
+    p.fillRect(r, attrs.backgroundColor.isValid() ? attrs.backgroundColor
+                                                   : m_bgColor);
+
+    if(!text.isEmpty())
+    {
+        int variant = (attrs.bold ? 1 : 0) | (attrs.italic ? 2 : 0);
 
-        // Paint margins
-        if(end_col > m_contents.columns())
+        if(variant != m_paintVariant)
         {
-            end_col = m_contents.columns();
+            p.setFont(m_fontVariants[variant]);
+            m_paintVariant = variant;
         }
 
-        if(end_row > m_contents.rows())
+        p.setPen(fg);
+        // The baseline is m_ascent below the top of the text
+        p.drawStaticText(QPoint(r.left(), r.top() + m_lineSpace),
+                         staticText(text, variant));
+    }
+
+    // Draw "undercurl" at the bottom of the cells
+    if(attrs.underline || attrs.undercurl)
+    {
+        QPen pen = QPen();
+
+        if(attrs.undercurl)
+        {
+            if(attrs.specialColor.isValid())
+            {
+                pen.setColor(attrs.specialColor);
+            }
+            else if(m_spColor.isValid())
+            {
+                pen.setColor(m_spColor);
+            }
+            else
+            {
+                pen.setColor(fg);
+            }
+
+            pen.setStyle(Qt::DashDotDotLine);
+        }
+        else
         {
-            end_col = m_contents.columns();
+            pen.setColor(fg);
         }
 
-        // end_col/row is inclusive
-        for(int i=start_row; i<=end_row && i < m_contents.rows(); i++)
+        // TODO: draw a proper undercurl
+        p.setPen(pen);
+        QPoint start = r.bottomLeft();
+        QPoint end = r.bottomRight();
+        start.ry()--;
+        end.ry()--;
+        p.drawLine(start, end);
+    }
+}
+
+/// Paint the cells of @b row from @b start_col to @b end_col (inclusive).
+/// Adjacent cells with the same attributes are painted as one run: one
+/// fill for the background and one laid out text, if the font variant
+/// keeps the glyphs on the cell grid. The attributes are looked up once
+/// per run.
+void ShellWidget::paintRow(QPainter &p, int row, int start_col, int end_col)
+{
+    int j = start_col;
+
+    // The second cell of a wide char is painted with the first
+    if(j > 0 && m_contents.constValue(row, j-1).doubleWidth)
+    {
+        j--;
+    }
+
+    while(j <= end_col)
+    {
+        const Cell &cell = m_contents.constValue(row, j);
+        const CellAttrs &attrs = m_contents.attrs(cell.attr);
+        int variant = (attrs.bold ? 1 : 0) | (attrs.italic ? 2 : 0);
+        QString text = cell.text();
+        int end = j + 1;
+
+        if(cell.doubleWidth)
+        {
+            end = j + 2;
+        }
+        else if(isRunChar(cell.c) && m_runVariants[variant])
         {
-            for(int j=start_col; j<=end_col && j < m_contents.columns(); j++)
+            while(end <= end_col)
             {
-                const Cell &cell = m_contents.constValue(i,j);
-                int chars = cell.doubleWidth ? 2 : 1;
-                QRect r = absoluteShellRect(i, j, 1, chars);
+                const Cell &next = m_contents.constValue(row, end);
 
-                if(j <= 0 || !contents().constValue(i, j-1).doubleWidth)
+                if(next.doubleWidth || !isRunChar(next.c)
+                   || next.attr != cell.attr)
                 {
-                    // Only paint bg/fg if this is
-                    // not the second cell of a wide char
-                    if(cell.backgroundColor.isValid())
-                    {
-                        p.fillRect(r, cell.backgroundColor);
-                    }
-                    else
-                    {
-                        p.fillRect(r, m_bgColor);
-                    }
-
-                    if(cell.c == ' ')
-                    {
-                        continue;
-                    }
-
-                    if(cell.foregroundColor.isValid())
-                    {
-                        p.setPen(cell.foregroundColor);
-                    }
-                    else
-                    {
-                        p.setPen(m_fgColor);
-                    }
-
-                    if(cell.bold || cell.italic)
-                    {
-                        QFont f = p.font();
-                        f.setBold(cell.bold);
-                        f.setItalic(cell.italic);
-                        p.setFont(f);
-                    }
-                    else
-                    {
-                        p.setFont(font());
-                    }
-
-                    // Draw chars at the baseline
-                    QPoint pos(r.left(), r.top()+m_ascent+m_lineSpace);
-                    p.drawText(pos, QString(cell.c));
+                    break;
                 }
 
-                // Draw "undercurl" at the bottom of the cell
-                if(cell.underline || cell.undercurl)
-                {
-                    QPen pen = QPen();
-
-                    if(cell.undercurl)
-                    {
-                        if(cell.specialColor.isValid())
-                        {
-                            pen.setColor(cell.specialColor);
-                        }
-                        else if(m_spColor.isValid())
-                        {
-                            pen.setColor(m_spColor);
-                        }
-                        else if(cell.foregroundColor.isValid())
-                        {
-                            pen.setColor(cell.foregroundColor);
-                        }
-                        else
-                        {
-                            pen.setColor(m_fgColor);
-                        }
-
-                        pen.setStyle(Qt::DashDotDotLine);
-                    }
-                    else if(cell.underline)
-                    {
-                        if(cell.foregroundColor.isValid())
-                        {
-                            pen.setColor(cell.foregroundColor);
-                        }
-                        else
-                        {
-                            pen.setColor(m_fgColor);
-                        }
-                    }
-
-                    // TODO: draw a proper undercurl
-                    p.setPen(pen);
-                    QPoint start = r.bottomLeft();
-                    QPoint end = r.bottomRight();
-                    start.ry()--;
-                    end.ry()--;
-                    p.drawLine(start, end);
-                }
+                text += QChar((ushort)next.c);
+                end++;
             }
         }
+
+        // Trailing spaces only need the background
+        int len = text.size();
+
+        while(len > 0 && text.at(len - 1) == ' ')
+        {
+            len--;
+        }
+
+        text.truncate(len);
+        paintRun(p, row, j, end - j, text, attrs);
+        j = end;
+    }
+}
+
+/// The rectangles of the paint region are merged into one span of
+/// columns per row, each row is painted once.
+void ShellWidget::paintEvent(QPaintEvent *ev)
+{
+    QPainter p(this);
+    m_paintVariant = -1;
+
+    int nrows = m_contents.rows();
+    int ncols = m_contents.columns();
+    QVector<int> from(nrows, ncols);
+    QVector<int> to(nrows, -1);
+
+    foreach(QRect rect, ev->region().rects())
+    {
+        int start_row = rect.top() / m_cellSize.height();
+        int end_row = qMin(rect.bottom() / m_cellSize.height(), nrows-1);
+        int start_col = rect.left() / m_cellSize.width();
+        int end_col = qMin(rect.right() / m_cellSize.width(), ncols-1);
+
+        // end_col/row is inclusive
+        for(int i=start_row; i<=end_row; i++)
+        {
+            from[i] = qMin(from[i], start_col);
+            to[i] = qMax(to[i], end_col);
+        }
+    }
+
+    for(int i=0; i<nrows; i++)
+    {
+        if(from[i] <= to[i])
+        {
+            paintRow(p, i, from[i], to[i]);
+        }
     }
 
     QRect shellArea =
@@ -324,10 +417,10 @@ const ShellContents &ShellWidget::contents(void) const
     return m_contents;
 }
 
-/// Put text in position, returns the amount of colums used
-int ShellWidget::put(const QString &text, int row, int column,
-                     QColor fg, QColor bg, QColor sp, bool bold, bool italic,
-                     bool underline, bool undercurl)
+/// The index of the attributes in the attribute table of the contents,
+/// invalid colors are replaced by the defaults as in put()
+quint16 ShellWidget::attrId(QColor fg, QColor bg, QColor sp, bool bold,
+                            bool italic, bool underline, bool undercurl)
 {
     if(!fg.isValid())
     {
@@ -344,56 +437,213 @@ int ShellWidget::put(const QString &text, int row, int column,
         sp = m_spColor;
     }
 
-    int cols_changed = m_contents.put(text, row, column, fg, bg, sp,
-                                      bold, italic, underline, undercurl);
+    return m_contents.attrId(CellAttrs(fg, bg, sp, bold, italic,
+                                       underline, undercurl));
+}
+
+/// Put text in position, returns the amount of colums used
+int ShellWidget::put(const QString &text, int row, int column,
+                     QColor fg, QColor bg, QColor sp, bool bold, bool italic,
+                     bool underline, bool undercurl)
+{
+    return put(text, row, column, attrId(fg, bg, sp, bold, italic,
+                                         underline, undercurl));
+}
+
+/// Put text in position using the attributes at index @b attrId,
+/// returns the amount of colums used
+int ShellWidget::put(const QString &text, int row, int column,
+                     quint16 attrId)
+{
+    int cols_changed = m_contents.put(text, row, column, attrId);
+    markDirty(row, column, column + cols_changed);
+
+    return cols_changed;
+}
+
+/// Replace @b count cells of @b row from @b col on, only the ones that
+/// differ are repainted
+void ShellWidget::setCells(int row, int col, const Cell *cells, int count)
+{
+    if(row < 0 || row >= m_contents.rows() || col < 0)
+    {
+        return;
+    }
+
+    count = qMin(count, m_contents.columns() - col);
 
-    if(cols_changed > 0)
+    if(count <= 0)
     {
-        QRect rect = absoluteShellRect(row, column, 1, cols_changed);
-        update(rect);
+        return;
     }
 
-    return cols_changed;
+    Cell *line = &m_contents.value(row, col);
+    int from = count;
+    int to = 0;
+
+    for(int i=0; i<count; i++)
+    {
+        if(!(line[i] == cells[i]))
+        {
+            line[i] = cells[i];
+            from = qMin(from, i);
+            to = i + 1;
+        }
+    }
+
+    markDirty(row, col + from, col + to);
 }
 
 void ShellWidget::clearRow(int row)
 {
     m_contents.clearRow(row);
-    QRect rect = absoluteShellRect(row, 0, 1, m_contents.columns());
-    update(rect);
+    markDirty(row, 0, m_contents.columns());
 }
 
 void ShellWidget::clearShell(QColor bg)
 {
     m_contents.clearAll(bg);
-    update();
+    markAllDirty();
 }
 
 /// Clear region (row0, col0) to - but not including (row1, col1)
 void ShellWidget::clearRegion(int row0, int col0, int row1, int col1)
 {
     m_contents.clearRegion(row0, col0, row1, col1);
-    // FIXME: check offset error
-    update(absoluteShellRect(row0, col0, row1-row0, col1-col0));
+
+    for(int i=row0; i<row1; i++)
+    {
+        markDirty(i, col0, col1);
+    }
+}
+
+/// Start a batch of changes: until the matching endUpdates() the changed
+/// cells are recorded instead of scheduled for repaint one by one.
+void ShellWidget::beginUpdates(void)
+{
+    m_updating++;
+}
+
+/// End a batch of changes, a single update() covers the changed cells
+void ShellWidget::endUpdates(void)
+{
+    if(m_updating > 0 && --m_updating == 0)
+    {
+        flushDirty();
+    }
+}
+
+/// Repaint the cells [col0, col1) of @b row, at the end of the batch
+/// if there is one
+void ShellWidget::markDirty(int row, int col0, int col1)
+{
+    col0 = qMax(col0, 0);
+    col1 = qMin(col1, m_contents.columns());
+
+    if(row < 0 || row >= m_contents.rows() || col0 >= col1)
+    {
+        return;
+    }
+
+    if(m_updating == 0)
+    {
+        update(absoluteShellRect(row, col0, 1, col1-col0));
+        return;
+    }
+
+    if(m_dirtyRows.size() != m_contents.rows())
+    {
+        m_dirtyRows.fill(false, m_contents.rows());
+        m_dirtyFrom.resize(m_contents.rows());
+        m_dirtyTo.resize(m_contents.rows());
+    }
+
+    if(m_dirtyRows.testBit(row))
+    {
+        m_dirtyFrom[row] = qMin(m_dirtyFrom[row], col0);
+        m_dirtyTo[row] = qMax(m_dirtyTo[row], col1);
+    }
+    else
+    {
+        m_dirtyRows.setBit(row);
+        m_dirtyFrom[row] = col0;
+        m_dirtyTo[row] = col1;
+    }
+}
+
+void ShellWidget::markAllDirty(void)
+{
+    if(m_updating == 0)
+    {
+        update();
+        return;
+    }
+
+    for(int i=0; i<m_contents.rows(); i++)
+    {
+        markDirty(i, 0, m_contents.columns());
+    }
+}
+
+/// Schedule the repaint of the recorded changes as one region, rows with
+/// the same span of columns are joined into one rectangle.
+void ShellWidget::flushDirty(void)
+{
+    QRegion region;
+    int nrows = m_dirtyRows.size();
+    int i = 0;
+
+    while(i < nrows)
+    {
+        if(!m_dirtyRows.testBit(i))
+        {
+            i++;
+            continue;
+        }
+
+        int j = i + 1;
+
+        while(j < nrows && m_dirtyRows.testBit(j)
+              && m_dirtyFrom[j] == m_dirtyFrom[i]
+              && m_dirtyTo[j] == m_dirtyTo[i])
+        {
+            j++;
+        }
+
+        region += absoluteShellRect(i, m_dirtyFrom[i],
+                                    j - i, m_dirtyTo[i] - m_dirtyFrom[i]);
+        i = j;
+    }
+
+    if(!region.isEmpty())
+    {
+        m_dirtyRows.fill(false);
+        update(region);
+    }
 }
 
-/// Scroll count rows (positive numbers move content up)
+/// Scroll count rows (positive numbers move content up). The widget is
+/// opaque, Qt moves the painted pixels and repaints the exposed rows only.
 void ShellWidget::scrollShell(int rows)
 {
     if(rows != 0)
     {
+        // Qt moves its pending repaints with the pixels, not ours
+        flushDirty();
         m_contents.scroll(rows);
         // Qt's delta uses positive numbers to move down
         scroll(0, -rows*m_cellSize.height());
     }
 }
 
-/// Scroll an area, count rows (positive numbers move content up)
+/// Scroll an area, count rows (positive numbers move content up), see
+/// scrollShell()
 void ShellWidget::scrollShellRegion(int row0, int row1,
                                     int col0, int col1, int rows)
 {
     if(rows != 0)
     {
+        flushDirty();
         m_contents.scrollRegion(row0, row1, col0, col1, rows);
         // Qt's delta uses positive numbers to move down
         QRect r = absoluteShellRect(row0, col0, row1-row0, col1-col0);
@@ -4,6 +4,11 @@
 #define PLUGIN_SNAIL_SHELLWIDGET_H
 
 #include <QWidget>
+#include <QCache>
+#include <QPair>
+#include <QStaticText>
+#include <QVector>
+#include <QBitArray>
 #include "plugins/bin/snail/shellcontents.h"
 
 class ShellWidget: public QWidget
@@ -32,6 +37,8 @@ public:
     int columns(void) const;
     QSize cellSize(void) const;
     const ShellContents &contents(void) const;
+    quint16 attrId(QColor fg, QColor bg, QColor sp,
+                   bool bold, bool italic, bool underline, bool undercurl);
     QSize sizeHint(void) const Q_DECL_OVERRIDE;
 signals:
     void shellFontChanged(void);
@@ -47,6 +54,7 @@ public slots:
             QColor fg=QColor(), QColor bg=QColor(), QColor sp=QColor(),
             bool bold=false, bool italic=false,
             bool underline=false, bool undercurl=false);
+    int put(const QString &, int row, int column, quint16 attrId);
 
     void clearRow(int row);
     void clearShell(QColor bg);
@@ -61,8 +69,19 @@ protected:
     void setCellSize(void);
     QRect absoluteShellRect(int row0, int col0, int rowcount, int colcount);
 
+    void beginUpdates(void);
+    void endUpdates(void);
+    void markDirty(int row, int col0, int col1);
+    void setCells(int row, int col, const Cell *cells, int count);
+
 private:
     void setFont(const QFont &);
+    const QStaticText &staticText(const QString &text, int variant);
+    void paintRun(QPainter &p, int row, int col, int ncols,
+                  const QString &text, const CellAttrs &attrs);
+    void paintRow(QPainter &p, int row, int start_col, int end_col);
+    void markAllDirty(void);
+    void flushDirty(void);
 
     ShellContents m_contents;
     QSize m_cellSize;
@@ -73,6 +92,22 @@ private:
     QColor m_spColor;
 
     unsigned int m_lineSpace;
+
+    /// The shell font, bold (1), italic (2) and both (3)
+    QFont m_fontVariants[4];
+    /// Font variants whose run chars are one cell wide, see paintRow()
+    bool m_runVariants[4];
+    /// Laid out text of runs, by text and font variant
+    QCache<QPair<QString, int>, QStaticText> m_textCache;
+    /// Font variant the painter is using, -1 for none yet
+    int m_paintVariant;
+
+    /// Nesting of beginUpdates(), changes are only recorded while > 0
+    int m_updating;
+    /// Rows with changes, and their span of changed columns [from, to)
+    QBitArray m_dirtyRows;
+    QVector<int> m_dirtyFrom;
+    QVector<int> m_dirtyTo;
 };
 
 #endif // PLUGIN_SNAIL_SHELLWIDGET_H
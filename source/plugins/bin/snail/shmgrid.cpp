@@ -0,0 +1,142 @@
+/// @file plugins/bin/snail/shmgrid.cpp
+
+#include <QtGlobal>
+#include <QDebug>
+#include "plugins/bin/snail/shmgrid.h"
+
+#ifdef Q_OS_UNIX
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+namespace SnailNvimQt {
+
+ShmGrid::ShmGrid(void)
+    :m_hdr(NULL), m_size(0), m_rows(0), m_cols(0)
+{
+    /* do nothing */
+}
+
+ShmGrid::~ShmGrid()
+{
+    close();
+}
+
+/// True where Nvim can publish its grid in shared memory
+bool ShmGrid::isSupported(void)
+{
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// Map the shared memory object @b name of a @b rows by @b cols grid,
+/// dropping the one mapped before. Returns false if it can't be opened or
+/// doesn't match.
+bool ShmGrid::open(const QByteArray &name, int rows, int cols)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    if(rows <= 0 || cols <= 0)
+    {
+        return false;
+    }
+
+    int fd = shm_open(name.constData(), O_RDWR, 0);
+
+    if(fd < 0)
+    {
+        qWarning() << "Unable to open the shared memory grid" << name;
+        return false;
+    }
+
+    size_t size = SHMGRID_SIZE(rows, cols);
+    struct stat st;
+    void *addr = MAP_FAILED;
+
+    if(fstat(fd, &st) == 0 && (size_t)st.st_size >= size)
+    {
+        // The UI writes "ack"
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    ::close(fd);
+
+    if(addr == MAP_FAILED)
+    {
+        qWarning() << "Unable to map the shared memory grid" << name;
+        return false;
+    }
+
+    shmgrid_header_st *hdr = (shmgrid_header_st *)addr;
+
+    if(hdr->magic != SHMGRID_MAGIC
+       || hdr->version != SHMGRID_VERSION
+       || hdr->rows != (quint32)rows
+       || hdr->cols != (quint32)cols
+       || hdr->attrs_max != SHMGRID_ATTRS_MAX)
+    {
+        qWarning() << "Unexpected shared memory grid" << name;
+        munmap(addr, size);
+        return false;
+    }
+
+    m_hdr = hdr;
+    m_size = size;
+    m_rows = rows;
+    m_cols = cols;
+    return true;
+#else
+    Q_UNUSED(name);
+    Q_UNUSED(rows);
+    Q_UNUSED(cols);
+    return false;
+#endif
+}
+
+void ShmGrid::close(void)
+{
+#ifdef Q_OS_UNIX
+    if(m_hdr)
+    {
+        munmap(m_hdr, m_size);
+    }
+#endif
+
+    m_hdr = NULL;
+    m_size = 0;
+    m_rows = 0;
+    m_cols = 0;
+}
+
+/// The cells of @b row in frame @b seq
+const shmgrid_cell_st *ShmGrid::row(quint32 seq, int row) const
+{
+    return SHMGRID_CELLS(m_hdr, seq % 2) + (size_t)row * (size_t)m_cols;
+}
+
+/// The attributes at index @b id of the attribute table, NULL if Nvim
+/// didn't write them
+const shmgrid_attr_st *ShmGrid::attr(quint32 id) const
+{
+    if(id >= __atomic_load_n(&m_hdr->attrs_size, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    return SHMGRID_ATTRS(m_hdr) + id;
+}
+
+/// Done reading frame @b seq, Nvim can write the buffer of the frame
+/// before it
+void ShmGrid::ack(quint32 seq)
+{
+    __atomic_store_n(&m_hdr->ack, seq, __ATOMIC_RELEASE);
+}
+
+} // namespace::SnailNvimQt
@@ -0,0 +1,55 @@
+/// @file plugins/bin/snail/shmgrid.h
+///
+/// The grid a local Nvim publishes in shared memory with the "ext_shmgrid"
+/// UI option, see nvim/shmgrid_defs.h. The cells are read in place from
+/// the mapping, only "redraw:grid_flush" says which rows to read.
+
+#ifndef PLUGIN_SNAIL_SHMGRID_H
+#define PLUGIN_SNAIL_SHMGRID_H
+
+#include <QByteArray>
+#include "nvim/shmgrid_defs.h"
+
+namespace SnailNvimQt {
+
+class ShmGrid
+{
+public:
+    ShmGrid(void);
+    ~ShmGrid();
+
+    static bool isSupported(void);
+
+    bool open(const QByteArray &name, int rows, int cols);
+    void close(void);
+
+    inline bool isOpen(void) const
+    {
+        return m_hdr != NULL;
+    }
+    inline int rows(void) const
+    {
+        return m_rows;
+    }
+    inline int columns(void) const
+    {
+        return m_cols;
+    }
+
+    const shmgrid_cell_st *row(quint32 seq, int row) const;
+    const shmgrid_attr_st *attr(quint32 id) const;
+    void ack(quint32 seq);
+
+private:
+    shmgrid_header_st *m_hdr;
+    size_t m_size;
+    int m_rows;
+    int m_cols;
+
+    ShmGrid(const ShmGrid &);
+    ShmGrid &operator=(const ShmGrid &);
+};
+
+} // namespace::SnailNvimQt
+
+#endif // PLUGIN_SNAIL_SHMGRID_H
@@ -0,0 +1,70 @@
+/// @file plugins/bin/snail/spscqueue.h
+///
+/// A bounded queue between one producer and one consumer thread, without
+/// locks. Each side only writes its own index.
+
+#ifndef PLUGIN_SNAIL_SPSCQUEUE_H
+#define PLUGIN_SNAIL_SPSCQUEUE_H
+
+#include <QAtomicInt>
+
+/// Holds up to N-1 items of type T
+template <class T, int N>
+class SpscQueue
+{
+public:
+    SpscQueue(void)
+        :m_head(0), m_tail(0)
+    { /* do nothing */ }
+
+    /// Producer: append @b val, returns false if the queue is full
+    bool push(const T &val)
+    {
+        int tail = m_tail.load();
+        int next = (tail + 1) % N;
+
+        if(next == m_head.loadAcquire())
+        {
+            return false;
+        }
+
+        m_items[tail] = val;
+        m_tail.storeRelease(next);
+        return true;
+    }
+
+    /// Consumer: move the oldest item to @b out, returns false if the
+    /// queue is empty
+    bool pop(T &out)
+    {
+        int head = m_head.load();
+
+        if(head == m_tail.loadAcquire())
+        {
+            return false;
+        }
+
+        out = m_items[head];
+        // Drop what the slot holds before the producer reuses it
+        m_items[head] = T();
+        m_head.storeRelease((head + 1) % N);
+        return true;
+    }
+
+    bool isEmpty(void) const
+    {
+        return m_head.loadAcquire() == m_tail.loadAcquire();
+    }
+
+private:
+    T m_items[N];
+    /// Next item to pop, written by the consumer
+    QAtomicInt m_head;
+    /// Next slot to push, written by the producer
+    QAtomicInt m_tail;
+
+    SpscQueue(const SpscQueue &);
+    SpscQueue &operator=(const SpscQueue &);
+};
+
+#endif // PLUGIN_SNAIL_SPSCQUEUE_H